@@ -0,0 +1,144 @@
+// Generates JavaScript source of a given size, so that benchmarks can be
+// run at any scale without checking large fixtures into the repository. The
+// output only depends on the seed, so results from different runs can be
+// compared.
+
+const IDENTIFIERS = [
+  'value', 'result', 'items', 'index', 'count', 'options', 'callback', 'node',
+  'parent', 'child', 'buffer', 'offset', 'length', 'state', 'config', 'error'
+];
+
+const KINDS = {
+  // A mix of the constructs that appear in typical application code.
+  typical: generateStatement,
+
+  // Long, flat sequences of simple statements.
+  flat: random => `${pick(random, IDENTIFIERS)}${random.int(1000)} = ${generateExpression(random, 1)};`,
+
+  // Deeply nested blocks and expressions.
+  nested: random => generateNestedStatement(random, 0)
+};
+
+function generateCorpus({kind = 'typical', size = 100 * 1024, seed = 1} = {}) {
+  const generateItem = KINDS[kind];
+  if (!generateItem) throw new Error(`Unknown corpus kind ${kind}`);
+
+  const random = new Random(seed);
+  const chunks = [];
+  let length = 0;
+  while (length < size) {
+    const chunk = generateItem(random, 0) + '\n';
+    chunks.push(chunk);
+    length += chunk.length;
+  }
+  return chunks.join('');
+}
+
+function generateStatement(random, depth) {
+  const indent = '  '.repeat(depth);
+  const name = pick(random, IDENTIFIERS);
+  const choice = depth > 2 ? random.int(4) : random.int(8);
+  switch (choice) {
+    case 0:
+      return `${indent}const ${name}${random.int(100)} = ${generateExpression(random, 2)};`;
+    case 1:
+      return `${indent}${name}.${pick(random, IDENTIFIERS)}(${generateArguments(random)});`;
+    case 2:
+      return `${indent}if (${generateExpression(random, 1)}) {\n${generateBlock(random, depth + 1)}${indent}}`;
+    case 3:
+      return `${indent}return ${generateExpression(random, 2)};`;
+    case 4:
+      return (
+        `${indent}function ${name}${random.int(1000)}(${generateParameters(random)}) {\n` +
+        `${generateBlock(random, depth + 1)}${indent}}`
+      );
+    case 5:
+      return (
+        `${indent}class ${capitalize(name)}${random.int(1000)} {\n` +
+        `${indent}  constructor(${generateParameters(random)}) {\n${generateBlock(random, depth + 2)}${indent}  }\n` +
+        `${indent}  ${pick(random, IDENTIFIERS)}() {\n${generateBlock(random, depth + 2)}${indent}  }\n` +
+        `${indent}}`
+      );
+    case 6:
+      return (
+        `${indent}for (let i = 0; i < ${name}.length; i++) {\n` +
+        `${generateBlock(random, depth + 1)}${indent}}`
+      );
+    default:
+      return `${indent}const ${name} = {\n${generateProperties(random, depth + 1)}${indent}};`;
+  }
+}
+
+function generateNestedStatement(random, depth) {
+  const indent = '  '.repeat(depth);
+  if (depth >= 12 + random.int(8)) return `${indent}${pick(random, IDENTIFIERS)}(${generateExpression(random, 3)});`;
+  return `${indent}if (${generateExpression(random, 1)}) {\n${generateNestedStatement(random, depth + 1)}\n${indent}}`;
+}
+
+function generateBlock(random, depth) {
+  let result = '';
+  for (let i = 0, n = 1 + random.int(4); i < n; i++) {
+    result += generateStatement(random, depth) + '\n';
+  }
+  return result;
+}
+
+function generateProperties(random, depth) {
+  const indent = '  '.repeat(depth);
+  let result = '';
+  for (let i = 0, n = 1 + random.int(5); i < n; i++) {
+    result += `${indent}${pick(random, IDENTIFIERS)}${i}: ${generateExpression(random, 1)},\n`;
+  }
+  return result;
+}
+
+function generateExpression(random, depth) {
+  const choice = depth > 0 ? random.int(9) : random.int(4);
+  switch (choice) {
+    case 0: return pick(random, IDENTIFIERS);
+    case 1: return String(random.int(10000));
+    case 2: return `'${pick(random, IDENTIFIERS)} ${pick(random, IDENTIFIERS)}'`;
+    case 3: return random.int(2) ? 'true' : 'null';
+    case 4: return `${generateExpression(random, depth - 1)} ${pick(random, ['+', '-', '*', '&&', '||', '===', '<'])} ${generateExpression(random, depth - 1)}`;
+    case 5: return `${pick(random, IDENTIFIERS)}.${pick(random, IDENTIFIERS)}(${generateArguments(random, depth - 1)})`;
+    case 6: return `[${generateArguments(random, depth - 1)}]`;
+    case 7: return `(${generateParameters(random)}) => ${generateExpression(random, depth - 1)}`;
+    default: return `\`${pick(random, IDENTIFIERS)} \${${generateExpression(random, depth - 1)}}\``;
+  }
+}
+
+function generateArguments(random, depth = 1) {
+  const result = [];
+  for (let i = 0, n = random.int(4); i < n; i++) result.push(generateExpression(random, depth));
+  return result.join(', ');
+}
+
+function generateParameters(random) {
+  const result = [];
+  for (let i = 0, n = random.int(4); i < n; i++) result.push(IDENTIFIERS[(i * 5 + random.int(3)) % IDENTIFIERS.length]);
+  return result.join(', ');
+}
+
+function pick(random, array) {
+  return array[random.int(array.length)];
+}
+
+function capitalize(string) {
+  return string[0].toUpperCase() + string.slice(1);
+}
+
+// A small deterministic PRNG (mulberry32).
+class Random {
+  constructor(seed) {
+    this.state = seed >>> 0;
+  }
+
+  int(limit) {
+    let t = (this.state = (this.state + 0x6d2b79f5) >>> 0);
+    t = Math.imul(t ^ (t >>> 15), t | 1);
+    t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+    return (((t ^ (t >>> 14)) >>> 0) % limit);
+  }
+}
+
+module.exports = {generateCorpus, Random, CORPUS_KINDS: Object.keys(KINDS)};
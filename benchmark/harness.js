@@ -0,0 +1,39 @@
+// Runs a function repeatedly until both a minimum time and a minimum number
+// of iterations have elapsed, after some warmup iterations, and summarizes
+// the times of the individual iterations in milliseconds.
+function measure(fn, {warmup = 2, minTime = 1000, minIterations = 5, maxIterations = Infinity} = {}) {
+  for (let i = 0; i < warmup; i++) fn();
+
+  const times = [];
+  let totalTime = 0;
+  while ((totalTime < minTime || times.length < minIterations) && times.length < maxIterations) {
+    const start = process.hrtime.bigint();
+    fn();
+    const time = Number(process.hrtime.bigint() - start) / 1e6;
+    times.push(time);
+    totalTime += time;
+  }
+  return summarize(times);
+}
+
+function summarize(times) {
+  const sorted = times.slice().sort((a, b) => a - b);
+  const mean = sorted.reduce((sum, time) => sum + time, 0) / sorted.length;
+  const variance = sorted.reduce((sum, time) => sum + (time - mean) ** 2, 0) / sorted.length;
+  return {
+    iterations: sorted.length,
+    mean,
+    min: sorted[0],
+    max: sorted[sorted.length - 1],
+    p50: percentile(sorted, 0.5),
+    p95: percentile(sorted, 0.95),
+    p99: percentile(sorted, 0.99),
+    stddev: Math.sqrt(variance)
+  };
+}
+
+function percentile(sorted, fraction) {
+  return sorted[Math.min(sorted.length - 1, Math.floor(fraction * sorted.length))];
+}
+
+module.exports = {measure, summarize, percentile};
@@ -0,0 +1,154 @@
+// Measures the latency of each keystroke in an editing session, from editing
+// the old tree to re-running the highlighting query over the changed ranges,
+// the way that an editor updates its syntax highlighting.
+
+const fs = require('fs');
+const path = require('path');
+const Parser = require('..');
+const JavaScript = require('tree-sitter-javascript');
+const {TextBuffer} = require('superstring');
+const {generateCorpus, Random} = require('./corpus');
+const {summarize} = require('./harness');
+const {HIGHLIGHT_QUERY} = require('./throughput');
+
+const STAGES = ['edit', 'parse', 'changedRanges', 'query', 'total'];
+const TYPED_LINES = [
+  'const value = items.map(item => item.value);',
+  'if (options.callback) options.callback(error, result);',
+  'return `${node.type} at ${index}`;',
+  'function update(state) { state.count++; }'
+];
+
+// Sessions consist of edits that replace the text between two indices. They
+// are either generated by typing lines of code at random places in the
+// document, with occasional typos that are deleted again, or read from a
+// JSON file. Recorded sessions are objects with the path of the edited file,
+// relative to the session, and an array of `{startIndex, oldEndIndex, text}`
+// edits.
+function generateSession(source, {keystrokes = 500, seed = 1} = {}) {
+  const random = new Random(seed);
+  const edits = [];
+  let length = source.length;
+  while (edits.length < keystrokes) {
+    let index = source.indexOf('\n', random.int(source.length));
+    if (index === -1) index = source.length;
+    index = Math.min(index, length);
+    const line = '\n' + TYPED_LINES[random.int(TYPED_LINES.length)];
+    for (let i = 0; i < line.length && edits.length < keystrokes; i++) {
+      if (random.int(20) === 0 && edits.length + 1 < keystrokes) {
+        edits.push({startIndex: index, oldEndIndex: index, text: 'x'});
+        edits.push({startIndex: index, oldEndIndex: index + 1, text: ''});
+      }
+      edits.push({startIndex: index, oldEndIndex: index, text: line[i]});
+      index++;
+      length++;
+    }
+  }
+  return edits.slice(0, keystrokes);
+}
+
+async function run({sizes, kinds, session: sessionPath, keystrokes, cachedNodes}) {
+  const parser = new Parser().setLanguage(JavaScript);
+  const query = new Parser.Query(JavaScript, HIGHLIGHT_QUERY);
+  const results = [];
+
+  const sessions = [];
+  if (sessionPath) {
+    const {file, edits} = JSON.parse(fs.readFileSync(sessionPath, 'utf8'));
+    const source = fs.readFileSync(path.resolve(path.dirname(sessionPath), file), 'utf8');
+    sessions.push({source, edits, corpus: {kind: path.basename(file), size: source.length}});
+  } else {
+    for (const kind of kinds) {
+      for (const size of sizes) {
+        const source = generateCorpus({kind, size});
+        const edits = generateSession(source, {keystrokes});
+        sessions.push({source, edits, corpus: {kind, size: source.length}});
+      }
+    }
+  }
+
+  for (const {source, edits, corpus} of sessions) {
+    for (const input of ['string', 'textBuffer']) {
+      const times = await replaySession(parser, query, source, edits, input, cachedNodes);
+      for (const stage of STAGES) {
+        results.push({
+          suite: 'keystrokes',
+          benchmark: stage,
+          input,
+          corpus,
+          keystrokes: edits.length,
+          stats: summarize(times[stage])
+        });
+      }
+    }
+  }
+
+  return results;
+}
+
+async function replaySession(parser, query, source, edits, input, cachedNodeCount) {
+  const times = {};
+  for (const stage of STAGES) times[stage] = [];
+
+  const buffer = input === 'textBuffer' ? new TextBuffer(source) : null;
+  const parse = oldTree => buffer
+    ? parser.parseTextBuffer(buffer, oldTree, {syncTimeoutMicros: Infinity})
+    : parser.parse(source, oldTree);
+
+  let tree = await parse();
+  let retainedNodes = retainNodes(tree, cachedNodeCount);
+
+  for (const {startIndex, oldEndIndex, text} of edits) {
+    const startPosition = pointForIndex(source, startIndex);
+    const oldEndPosition = pointForIndex(source, oldEndIndex);
+    const newEndIndex = startIndex + text.length;
+    source = source.slice(0, startIndex) + text + source.slice(oldEndIndex);
+    const newEndPosition = pointForIndex(source, newEndIndex);
+    if (buffer) buffer.setTextInRange({start: startPosition, end: oldEndPosition}, text);
+
+    const start = process.hrtime.bigint();
+    tree.edit({startIndex, oldEndIndex, newEndIndex, startPosition, oldEndPosition, newEndPosition});
+    const editEnd = process.hrtime.bigint();
+    const newTree = await parse(tree);
+    const parseEnd = process.hrtime.bigint();
+    const changedRanges = tree.getChangedRanges(newTree);
+    const changedRangesEnd = process.hrtime.bigint();
+
+    // The edited line is always re-highlighted, along with any ranges whose
+    // syntax changed.
+    query.captures(newTree.rootNode, {row: startPosition.row, column: 0}, {row: newEndPosition.row + 1, column: 0});
+    for (const range of changedRanges) {
+      query.captures(newTree.rootNode, range.startPosition, range.endPosition);
+    }
+    const end = process.hrtime.bigint();
+
+    times.edit.push(Number(editEnd - start) / 1e6);
+    times.parse.push(Number(parseEnd - editEnd) / 1e6);
+    times.changedRanges.push(Number(changedRangesEnd - parseEnd) / 1e6);
+    times.query.push(Number(end - changedRangesEnd) / 1e6);
+    times.total.push(Number(end - start) / 1e6);
+
+    tree = newTree;
+    retainedNodes = retainNodes(tree, cachedNodeCount);
+  }
+
+  return times;
+}
+
+// Editors hold on to many of a tree's nodes, each of which needs to be
+// updated when the tree is edited.
+function retainNodes(tree, count) {
+  return count > 0 ? tree.rootNode.descendantsOfType('identifier').slice(0, count) : [];
+}
+
+function pointForIndex(source, index) {
+  let row = 0;
+  let lineStart = 0;
+  for (let i = source.indexOf('\n'); i !== -1 && i < index; i = source.indexOf('\n', i + 1)) {
+    row++;
+    lineStart = i + 1;
+  }
+  return {row, column: index - lineStart};
+}
+
+module.exports = {name: 'keystrokes', run, generateSession};
@@ -0,0 +1,159 @@
+// Measures the memory used by trees and their cached nodes, whether that
+// memory is reclaimed once the trees are unreachable, and the GC pauses
+// caused by repeatedly creating and dropping trees.
+
+const v8 = require('v8');
+const vm = require('vm');
+const {PerformanceObserver} = require('perf_hooks');
+const Parser = require('..');
+const JavaScript = require('tree-sitter-javascript');
+const {generateCorpus} = require('./corpus');
+const {summarize} = require('./harness');
+
+// Trees are only freed when their JS objects are garbage collected, so the
+// number of trees that are created at once is scaled to the corpus size to
+// keep the total memory in a reasonable range.
+const TOTAL_SOURCE_SIZE = 16 * 1024 * 1024;
+const MIN_TREE_COUNT = 2;
+const MAX_TREE_COUNT = 100;
+const CHURN_ITERATIONS = 3;
+
+async function run({sizes, kinds}) {
+  const gc = exposeGC();
+  const parser = new Parser().setLanguage(JavaScript);
+  const results = [];
+
+  for (const kind of kinds) {
+    for (const size of sizes) {
+      const source = generateCorpus({kind, size});
+      const corpus = {kind, size: source.length};
+      const treeCount = Math.min(MAX_TREE_COUNT, Math.max(MIN_TREE_COUNT, Math.round(TOTAL_SOURCE_SIZE / source.length)));
+
+      await collectGarbage(gc);
+      const baseline = snapshot();
+
+      // Create trees and cache all of their nodes, keeping them reachable.
+      let trees = createTrees(parser, source, treeCount);
+      await collectGarbage(gc);
+      const retained = snapshot();
+      results.push(result('retained', corpus, difference(retained, baseline), {
+        treeCount,
+        nodeCount: trees.nodes.length
+      }));
+
+      // Drop the trees and nodes, and check that all of them are freed.
+      trees = null;
+      await collectGarbage(gc);
+      const afterReclaiming = snapshot();
+      const reclaimed = difference(afterReclaiming, retained);
+      const created = retained.counters.treesCreated - baseline.counters.treesCreated;
+      const cached = retained.counters.nodesCached - baseline.counters.nodesCached;
+      const leakedTrees = created - reclaimed.counters.treesDeleted;
+      const leakedNodes = cached - reclaimed.counters.nodesFinalized;
+      results.push(result('reclaimed', corpus, reclaimed, {
+        leakedTrees,
+        leakedNodes
+      }, leakedTrees > 0 || leakedNodes > 0));
+
+      // Create, traverse and drop trees without forcing GC, and record the
+      // pauses of the collections that happen along the way.
+      const pauses = await recordGCPauses(() => {
+        for (let i = 0; i < CHURN_ITERATIONS * treeCount; i++) {
+          visitChildren(parser.parse(source).rootNode, []);
+        }
+      });
+      results.push(Object.assign(result('churn', corpus, difference(snapshot(), afterReclaiming), {
+        gcCount: pauses.length,
+        gcTime: pauses.reduce((sum, pause) => sum + pause, 0)
+      }), {stats: pauses.length > 0 ? summarize(pauses) : undefined}));
+    }
+  }
+
+  return results;
+}
+
+// Trees are created outside of the async `run` function, whose suspended
+// frames could otherwise keep the last one reachable.
+function createTrees(parser, source, count) {
+  const trees = [];
+  const nodes = [];
+  for (let i = 0; i < count; i++) {
+    const tree = parser.parse(source);
+    trees.push(tree);
+    visitChildren(tree.rootNode, nodes);
+  }
+  return {trees, nodes};
+}
+
+function result(benchmark, corpus, memory, values, failed = false) {
+  return {
+    suite: 'memory',
+    benchmark,
+    input: 'string',
+    corpus,
+    values: Object.assign({
+      rss: memory.rss,
+      heapUsed: memory.heapUsed,
+      external: memory.external,
+      treesCreated: memory.counters.treesCreated,
+      treesDeleted: memory.counters.treesDeleted,
+      nodesCached: memory.counters.nodesCached,
+      nodesFinalized: memory.counters.nodesFinalized
+    }, values),
+    failed
+  };
+}
+
+function snapshot() {
+  const {rss, heapUsed, external} = process.memoryUsage();
+  const {treesCreated, treesDeleted, nodesCached, nodesFinalized} = Parser.metrics();
+  return {rss, heapUsed, external, counters: {treesCreated, treesDeleted, nodesCached, nodesFinalized}};
+}
+
+function difference(after, before) {
+  const result = {counters: {}};
+  for (const key of ['rss', 'heapUsed', 'external']) result[key] = after[key] - before[key];
+  for (const key in after.counters) result.counters[key] = after.counters[key] - before.counters[key];
+  return result;
+}
+
+function visitChildren(node, nodes) {
+  const {children} = node;
+  for (let i = 0; i < children.length; i++) {
+    nodes.push(children[i]);
+    visitChildren(children[i], nodes);
+  }
+}
+
+// Node only exposes `gc` when it's started with `--expose-gc`, but the flag
+// can also be set at runtime, and takes effect in new contexts.
+function exposeGC() {
+  if (typeof global.gc === 'function') return global.gc;
+  v8.setFlagsFromString('--expose-gc');
+  return vm.runInNewContext('gc');
+}
+
+// Weak callbacks run after a collection finishes, and may free objects that
+// are only collected by a later one, so collect several times.
+async function collectGarbage(gc) {
+  for (let i = 0; i < 4; i++) {
+    gc();
+    await new Promise(resolve => setImmediate(resolve));
+  }
+}
+
+async function recordGCPauses(fn) {
+  const pauses = [];
+  const observer = new PerformanceObserver(list => {
+    for (const entry of list.getEntries()) pauses.push(entry.duration);
+  });
+  observer.observe({entryTypes: ['gc']});
+  fn();
+
+  // GC entries are delivered asynchronously.
+  await new Promise(resolve => setTimeout(resolve, 10));
+  observer.disconnect();
+  return pauses;
+}
+
+module.exports = {name: 'memory', run};
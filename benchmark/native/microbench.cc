@@ -0,0 +1,345 @@
+// Microbenchmarks of the parts of the binding that don't depend on V8, with
+// hardware counters. Build them with:
+//
+//   node-gyp rebuild -- -Dbuild_microbench=true
+//   build/Release/microbench [--filter <name>] [--size <bytes>] [--min-time <ms>]
+//                            [--grammar <library> [--symbol <name>]] [--json]
+//
+// The parts of the binding that call into V8 can't be linked into a
+// standalone executable, so they are measured by the JS benchmarks instead.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <tree_sitter/api.h>
+#include "./perf_counters.h"
+#include "../../src/interval_tree.h"
+#include "../../src/language_registry.h"
+#include "../../src/position_index.h"
+#include "../../src/text_buffer_input.h"
+
+namespace node_tree_sitter {
+namespace benchmark {
+
+using std::string;
+using std::vector;
+using std::pair;
+
+struct Options {
+  string filter;
+  uint32_t size = 1024 * 1024;
+  double min_time = 500;
+  string grammar_path;
+  string grammar_symbol;
+  bool json = false;
+};
+
+// Each benchmark runs a batch of operations and returns how many it ran.
+struct Benchmark {
+  string name;
+  std::function<uint64_t()> run;
+};
+
+// Results of computations that would otherwise be optimized away.
+static volatile uint32_t sink;
+
+struct Result {
+  string name;
+  uint64_t operation_count;
+  double time;
+  uint64_t counter_values[PerfCounters::EventCount];
+};
+
+class Random {
+ public:
+  explicit Random(uint32_t seed) : state_(seed) {}
+
+  uint32_t Next(uint32_t limit) {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 17;
+    state_ ^= state_ << 5;
+    return state_ % limit;
+  }
+
+ private:
+  uint32_t state_;
+};
+
+// Mostly-ASCII source code, with some multi-byte characters in comments and
+// strings, like real code.
+static vector<char16_t> generate_text(uint32_t size) {
+  static const char16_t *lines[] = {
+    u"function update(state, action) {\n",
+    u"  const items = state.items.map(item => item.value * 2);\n",
+    u"  // Résumé of the café's menü\n",
+    u"  if (action.type === 'add') return {...state, count: state.count + 1};\n",
+    u"  const arrow = '→', emoji = '😀';\n",
+    u"}\n",
+  };
+
+  vector<char16_t> result;
+  result.reserve(size);
+  for (size_t i = 0; result.size() < size; i++) {
+    for (const char16_t *c = lines[i % (sizeof(lines) / sizeof(lines[0]))]; *c; c++) {
+      result.push_back(*c);
+    }
+  }
+  result.resize(size);
+  return result;
+}
+
+// Text buffers store their text in chunks, so a snapshot consists of many
+// slices.
+static vector<pair<const char16_t *, uint32_t>> split_into_slices(const vector<char16_t> &text,
+                                                                  uint32_t slice_length) {
+  vector<pair<const char16_t *, uint32_t>> result;
+  for (uint32_t i = 0; i < text.size(); i += slice_length) {
+    uint32_t length = std::min<uint32_t>(slice_length, text.size() - i);
+    result.push_back({text.data() + i, length});
+  }
+  return result;
+}
+
+static Result measure(const Benchmark &benchmark, const Options &options) {
+  PerfCounters counters;
+  Result result = {benchmark.name, 0, 0, {}};
+
+  benchmark.run();
+  while (result.time < options.min_time) {
+    auto start = std::chrono::steady_clock::now();
+    counters.Start();
+    result.operation_count += benchmark.run();
+    counters.Stop();
+    result.time += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    for (int i = 0; i < PerfCounters::EventCount; i++) {
+      result.counter_values[i] += counters.Value(static_cast<PerfCounters::Event>(i));
+    }
+  }
+
+  for (int i = 0; i < PerfCounters::EventCount; i++) {
+    if (!counters.IsAvailable(static_cast<PerfCounters::Event>(i))) result.counter_values[i] = UINT64_MAX;
+  }
+  return result;
+}
+
+static void print_result(const Result &result, bool json, bool first) {
+  double operation_count = result.operation_count;
+  double ns_per_operation = result.time * 1e6 / operation_count;
+  const uint64_t *values = result.counter_values;
+
+  if (json) {
+    printf("%s\n  {\"benchmark\": \"%s\", \"operations\": %llu, \"nsPerOperation\": %.3f",
+           first ? "" : ",", result.name.c_str(), (unsigned long long)result.operation_count, ns_per_operation);
+    for (int i = 0; i < PerfCounters::EventCount; i++) {
+      if (values[i] == UINT64_MAX) continue;
+      printf(", \"%sPerOperation\": %.3f", PerfCounters::Name(static_cast<PerfCounters::Event>(i)),
+             values[i] / operation_count);
+    }
+    printf("}");
+    return;
+  }
+
+  printf("%-36s %12.1f ns/op", result.name.c_str(), ns_per_operation);
+  if (values[PerfCounters::Cycles] != UINT64_MAX) {
+    printf(" %12.1f cycles/op", values[PerfCounters::Cycles] / operation_count);
+  }
+  if (values[PerfCounters::Cycles] != UINT64_MAX && values[PerfCounters::Instructions] != UINT64_MAX) {
+    printf(" %6.2f IPC", static_cast<double>(values[PerfCounters::Instructions]) / values[PerfCounters::Cycles]);
+  }
+  if (values[PerfCounters::CacheMisses] != UINT64_MAX) {
+    printf(" %10.2f cache-misses/op", values[PerfCounters::CacheMisses] / operation_count);
+  }
+  if (values[PerfCounters::BranchMisses] != UINT64_MAX) {
+    printf(" %10.2f branch-misses/op", values[PerfCounters::BranchMisses] / operation_count);
+  }
+  printf("\n");
+}
+
+static bool parse_options(int argc, char **argv, Options *options) {
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--filter" && has_value) {
+      options->filter = argv[++i];
+    } else if (arg == "--size" && has_value) {
+      options->size = strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--min-time" && has_value) {
+      options->min_time = strtod(argv[++i], nullptr);
+    } else if (arg == "--grammar" && has_value) {
+      options->grammar_path = argv[++i];
+    } else if (arg == "--symbol" && has_value) {
+      options->grammar_symbol = argv[++i];
+    } else if (arg == "--json") {
+      options->json = true;
+    } else {
+      return false;
+    }
+  }
+  return options->size > 0;
+}
+
+static int run(int argc, char **argv) {
+  Options options;
+  if (!parse_options(argc, argv, &options)) {
+    fprintf(stderr,
+      "Usage: microbench [--filter <name>] [--size <bytes>] [--min-time <ms>]\n"
+      "                  [--grammar <library> [--symbol <name>]] [--json]\n");
+    return 1;
+  }
+
+  const uint32_t lookup_count = 100000;
+  const uint32_t interval_count = 10000;
+  vector<char16_t> text = generate_text(options.size);
+  const uint16_t *text_units = reinterpret_cast<const uint16_t *>(text.data());
+  auto slices = split_into_slices(text, 4096);
+
+  PositionIndex utf8_index(PositionEncodingUTF8);
+  PositionIndex utf32_index(PositionEncodingUTF32);
+  utf8_index.Append(text_units, text.size());
+  utf32_index.Append(text_units, text.size());
+
+  IntervalTree intervals;
+  Random interval_random(4);
+  for (uint32_t i = 0; i < interval_count; i++) {
+    uint32_t start = interval_random.Next(options.size);
+    intervals.Insert(start, start + interval_random.Next(100), i);
+  }
+
+  vector<Benchmark> benchmarks;
+
+  benchmarks.push_back({"TextBufferInput.read/sequential", [&]() {
+    TextBufferInput input(&slices);
+    TSInput ts_input = input.input();
+    uint32_t byte = 0, length = 0, read_count = 0;
+    do {
+      ts_input.read(ts_input.payload, byte, {0, 0}, &length);
+      byte += length;
+      read_count++;
+    } while (length > 0);
+    return read_count;
+  }});
+
+  // The lexer reads from arbitrary offsets when it restarts after reusing a
+  // subtree, which makes the input seek.
+  benchmarks.push_back({"TextBufferInput.read/seek", [&]() {
+    TextBufferInput input(&slices);
+    TSInput ts_input = input.input();
+    Random random(1);
+    uint32_t length;
+    for (uint32_t i = 0; i < lookup_count; i++) {
+      ts_input.read(ts_input.payload, 2 * random.Next(text.size()), {0, 0}, &length);
+    }
+    return lookup_count;
+  }});
+
+  for (PositionEncoding encoding : {PositionEncodingUTF8, PositionEncodingUTF32}) {
+    string suffix = encoding == PositionEncodingUTF8 ? "/utf8" : "/utf32";
+
+    benchmarks.push_back({"PositionIndex.Append" + suffix, [&, encoding]() {
+      PositionIndex index(encoding);
+      index.Append(text_units, text.size());
+      return 1;
+    }});
+
+    const PositionIndex *index = encoding == PositionEncodingUTF8 ? &utf8_index : &utf32_index;
+    benchmarks.push_back({"PositionIndex.FromUTF16" + suffix, [&, index]() {
+      Random random(2);
+      uint32_t sum = 0;
+      for (uint32_t i = 0; i < lookup_count; i++) sum += index->FromUTF16(random.Next(text.size()));
+      sink = sum;
+      return lookup_count;
+    }});
+
+    benchmarks.push_back({"PositionIndex.Edit" + suffix, [&, encoding]() {
+      PositionIndex index(encoding);
+      index.Append(text_units, text.size());
+      Random random(3);
+      const uint16_t inserted[] = {'x', 0xe9};
+      for (uint32_t i = 0; i < 1000; i++) {
+        uint32_t position = random.Next(index.length());
+        index.Edit(position, position, inserted, 2);
+      }
+      return 1000;
+    }});
+  }
+
+  benchmarks.push_back({"IntervalTree.Insert", [&]() {
+    IntervalTree tree;
+    Random random(5);
+    for (uint32_t i = 0; i < interval_count; i++) {
+      uint32_t start = random.Next(options.size);
+      tree.Insert(start, start + random.Next(100), i);
+    }
+    return interval_count;
+  }});
+
+  // Each insertion is undone by a deletion, so the intervals stay the same
+  // from one batch to the next.
+  benchmarks.push_back({"IntervalTree.Edit", [&]() {
+    Random random(6);
+    for (uint32_t i = 0; i < 1000; i++) {
+      uint32_t position = random.Next(options.size);
+      intervals.Edit(position, position, position + 1);
+      intervals.Edit(position, position + 1, position);
+    }
+    return 2000;
+  }});
+
+  benchmarks.push_back({"IntervalTree.FindOverlapping", [&]() {
+    Random random(7);
+    vector<IntervalTree::Entry> entries;
+    for (uint32_t i = 0; i < lookup_count / 10; i++) {
+      uint32_t start = random.Next(options.size);
+      entries.clear();
+      intervals.FindOverlapping(start, start + 1000, &entries);
+    }
+    return lookup_count / 10;
+  }});
+
+  if (!options.grammar_path.empty()) {
+    string symbol = options.grammar_symbol;
+    if (symbol.empty()) {
+      fprintf(stderr, "The --symbol option is required with --grammar\n");
+      return 1;
+    }
+    string error;
+    const TSLanguage *language = language_registry::Load(options.grammar_path, symbol, &error);
+    if (!language) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+
+    benchmarks.push_back({"ts_parser_parse/TextBufferInput", [&, language]() {
+      TSParser *parser = ts_parser_new();
+      ts_parser_set_language(parser, language);
+      TextBufferInput input(&slices);
+      ts_tree_delete(ts_parser_parse(parser, nullptr, input.input()));
+      ts_parser_delete(parser);
+      return 1;
+    }});
+  }
+
+  if (options.json) printf("[");
+  bool first = true;
+  for (const Benchmark &benchmark : benchmarks) {
+    if (!options.filter.empty() && benchmark.name.find(options.filter) == string::npos) continue;
+    print_result(measure(benchmark, options), options.json, first);
+    fflush(stdout);
+    first = false;
+  }
+  if (options.json) printf("\n]\n");
+  return 0;
+}
+
+}  // namespace benchmark
+}  // namespace node_tree_sitter
+
+int main(int argc, char **argv) {
+  return node_tree_sitter::benchmark::run(argc, argv);
+}
@@ -0,0 +1,121 @@
+#ifndef NODE_TREE_SITTER_BENCHMARK_PERF_COUNTERS_H_
+#define NODE_TREE_SITTER_BENCHMARK_PERF_COUNTERS_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace node_tree_sitter {
+namespace benchmark {
+
+// Hardware counters of the calling thread, read with perf_event_open. Each
+// counter is opened separately, so that the others still work when one isn't
+// supported. Counters that can't be opened, e.g. because of the system's
+// perf_event_paranoid setting, or on other platforms, are unavailable.
+class PerfCounters {
+ public:
+  enum Event {
+    Cycles,
+    Instructions,
+    CacheMisses,
+    BranchMisses,
+    EventCount,
+  };
+
+  static const char *Name(Event event) {
+    switch (event) {
+      case Cycles: return "cycles";
+      case Instructions: return "instructions";
+      case CacheMisses: return "cacheMisses";
+      case BranchMisses: return "branchMisses";
+      default: return "";
+    }
+  }
+
+  PerfCounters() {
+    for (int i = 0; i < EventCount; i++) {
+      fds_[i] = -1;
+      values_[i] = 0;
+    }
+
+#ifdef __linux__
+    static const uint64_t configs[EventCount] = {
+      PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_BRANCH_MISSES,
+    };
+
+    for (int i = 0; i < EventCount; i++) {
+      struct perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = configs[i];
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      fds_[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+  }
+
+  ~PerfCounters() {
+#ifdef __linux__
+    for (int i = 0; i < EventCount; i++) {
+      if (fds_[i] != -1) close(fds_[i]);
+    }
+#endif
+  }
+
+  bool IsAvailable(Event event) const { return fds_[event] != -1; }
+
+  void Start() {
+#ifdef __linux__
+    for (int i = 0; i < EventCount; i++) {
+      if (fds_[i] == -1) continue;
+      ioctl(fds_[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(fds_[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  // When there are more counters than the hardware can count at once, the
+  // kernel multiplexes them, so the counts are scaled up to the whole time
+  // that the counters were enabled.
+  void Stop() {
+#ifdef __linux__
+    for (int i = 0; i < EventCount; i++) {
+      if (fds_[i] == -1) continue;
+      ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+      uint64_t data[3];
+      if (read(fds_[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+        values_[i] = 0;
+      } else {
+        values_[i] = static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+      }
+    }
+#endif
+  }
+
+  uint64_t Value(Event event) const { return values_[event]; }
+
+ private:
+  PerfCounters(const PerfCounters &);
+  PerfCounters &operator=(const PerfCounters &);
+
+  int fds_[EventCount];
+  uint64_t values_[EventCount];
+};
+
+}  // namespace benchmark
+}  // namespace node_tree_sitter
+
+#endif  // NODE_TREE_SITTER_BENCHMARK_PERF_COUNTERS_H_
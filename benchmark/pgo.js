@@ -0,0 +1,163 @@
+#!/usr/bin/env node
+
+// Builds the binding with link-time and profile-guided optimization. The
+// binding is first built with instrumentation, then trained by running the
+// throughput and keystroke benchmarks, and then rebuilt using the recorded
+// profile.
+//
+// With `--compare`, the default build and an LTO-only build are benchmarked
+// first, and the speedups of the LTO and LTO+PGO builds over the default
+// build are printed at the end.
+
+const fs = require('fs');
+const path = require('path');
+const {execFileSync} = require('child_process');
+
+const ROOT = path.join(__dirname, '..');
+const PROFILE_DIR = path.join(ROOT, 'pgo');
+
+// The training runs cover both small and large files, and both typical and
+// deeply nested code, so that the profile isn't skewed towards one of them.
+const TRAINING_ARGS = [
+  'throughput', 'keystrokes',
+  '--size', '10k', '--size', '1m',
+  '--kind', 'typical', '--kind', 'nested',
+  '--keystrokes', '200'
+];
+
+// The comparison uses a different corpus kind from the training runs, so
+// that the profile isn't measured on exactly the code that it was trained on.
+const COMPARISON_ARGS = [
+  'throughput', 'keystrokes',
+  '--size', '100k', '--size', '1m',
+  '--kind', 'typical', '--kind', 'flat'
+];
+
+function main(args) {
+  const compare = args.includes('--compare');
+  removeDirectory(PROFILE_DIR);
+  fs.mkdirSync(PROFILE_DIR);
+  checkLinkerPlugin();
+
+  const reports = [];
+  if (compare) {
+    console.error('Building the default binding...');
+    nodeGyp('rebuild');
+    reports.push(['default', benchmark('default')]);
+
+    console.error('Building the LTO binding...');
+    nodeGyp('rebuild', '--', '-Dlto=true');
+    reports.push(['lto', benchmark('lto')]);
+  }
+
+  console.error('Building the instrumented binding...');
+  nodeGyp('rebuild', '--', '-Dlto=true', '-Dpgo=generate', `-Dpgo_dir=${PROFILE_DIR}`);
+
+  console.error('Training...');
+  const output = path.join(PROFILE_DIR, 'training.json');
+  run(process.execPath, path.join(__dirname, 'run.js'), ...TRAINING_ARGS, '--output', output);
+  fs.unlinkSync(output);
+  mergeClangProfiles();
+
+  console.error('Building the optimized binding...');
+  nodeGyp('rebuild', '--', '-Dlto=true', '-Dpgo=use', `-Dpgo_dir=${PROFILE_DIR}`);
+
+  if (compare) {
+    reports.push(['lto+pgo', benchmark('lto-pgo')]);
+    printComparison(reports);
+  }
+}
+
+// GCC only optimizes across the tree_sitter archive and the binding when the
+// linker plugin is available. Otherwise, the fat LTO objects would silently
+// be linked as regular code.
+function checkLinkerPlugin() {
+  if (process.platform !== 'linux') return;
+  const compiler = process.env.CC || 'cc';
+  if (/clang/.test(output(compiler, '--version'))) return;
+  const plugin = output(compiler, '-print-file-name=liblto_plugin.so').trim();
+  if (!path.isAbsolute(plugin) || !fs.existsSync(plugin)) {
+    throw new Error(`${compiler} has no LTO linker plugin, so LTO wouldn't cross the tree_sitter library`);
+  }
+}
+
+// Clang writes raw profiles, which have to be merged before they're used.
+// GCC writes profiles that are used directly.
+function mergeClangProfiles() {
+  const rawProfiles = fs.readdirSync(PROFILE_DIR)
+    .filter(name => name.endsWith('.profraw'))
+    .map(name => path.join(PROFILE_DIR, name));
+  if (rawProfiles.length === 0) return;
+
+  const outputArgs = ['merge', '-o', path.join(PROFILE_DIR, 'default.profdata'), ...rawProfiles];
+  if (process.platform === 'darwin') {
+    run('xcrun', 'llvm-profdata', ...outputArgs);
+  } else {
+    run(process.env.LLVM_PROFDATA || 'llvm-profdata', ...outputArgs);
+  }
+}
+
+function benchmark(name) {
+  const output = path.join(PROFILE_DIR, `results-${name}.json`);
+  run(process.execPath, path.join(__dirname, 'run.js'), ...COMPARISON_ARGS, '--output', output);
+  return JSON.parse(fs.readFileSync(output, 'utf8'));
+}
+
+// Speedups are relative to the first report, in throughput when there is
+// one, and in mean time otherwise.
+function printComparison(reports) {
+  const [, baseline] = reports[0];
+  const names = reports.slice(1).map(([name]) => name);
+  console.log(`${'benchmark'.padEnd(56)} ${names.map(name => name.padStart(10)).join(' ')}`);
+  for (const result of baseline.results) {
+    if (!result.stats) continue;
+    const key = resultKey(result);
+    const changes = reports.slice(1).map(([, report]) => {
+      const other = report.results.find(other => resultKey(other) === key);
+      if (!other || !other.stats) return ''.padStart(10);
+      const change = result.throughput === undefined
+        ? result.stats.mean / other.stats.mean - 1
+        : other.throughput / result.throughput - 1;
+      return `${change >= 0 ? '+' : ''}${(change * 100).toFixed(1)}%`.padStart(10);
+    });
+    console.log(`${key.padEnd(56)} ${changes.join(' ')}`);
+  }
+}
+
+function resultKey(result) {
+  return [result.suite, result.benchmark, result.input, result.corpus.kind, result.corpus.size].join(' ');
+}
+
+// `fs.rmSync` needs Node 14.14, and the prebuilt binaries target Node 10.
+function removeDirectory(directory) {
+  if (!fs.existsSync(directory)) return;
+  for (const entry of fs.readdirSync(directory, {withFileTypes: true})) {
+    const entryPath = path.join(directory, entry.name);
+    if (entry.isDirectory()) {
+      removeDirectory(entryPath);
+    } else {
+      fs.unlinkSync(entryPath);
+    }
+  }
+  fs.rmdirSync(directory);
+}
+
+// npm sets the path of its own node-gyp when running scripts.
+function nodeGyp(...args) {
+  const script = process.env.npm_config_node_gyp;
+  if (script) {
+    run(process.execPath, script, ...args);
+  } else {
+    run('node-gyp', ...args);
+  }
+}
+
+function run(command, ...args) {
+  execFileSync(command, args, {cwd: ROOT, stdio: 'inherit'});
+}
+
+function output(command, ...args) {
+  return execFileSync(command, args, {cwd: ROOT, encoding: 'utf8'});
+}
+
+main(process.argv.slice(2));
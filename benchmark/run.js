@@ -0,0 +1,168 @@
+#!/usr/bin/env node
+
+const fs = require('fs');
+const os = require('os');
+const {CORPUS_KINDS} = require('./corpus');
+
+const SUITES = {
+  throughput: () => require('./throughput'),
+  keystrokes: () => require('./keystrokes'),
+  memory: () => require('./memory')
+};
+
+const USAGE = `Usage: node benchmark/run.js [options] [suite...]
+
+Suites: ${Object.keys(SUITES).join(', ')} (default: all)
+
+Options:
+  --size <size>         Corpus size, e.g. 100k or 1m. Can be repeated. (default: 10k, 100k, 1m)
+  --kind <kind>         Corpus kind: ${CORPUS_KINDS.join(', ')}. Can be repeated. (default: typical)
+  --quick               Run fewer iterations, for checking that the benchmarks work.
+  --keystrokes <n>      Number of keystrokes in generated editing sessions. (default: 500)
+  --session <file>      Replay a recorded editing session instead of generated ones.
+  --cached-nodes <n>    Number of nodes that stay referenced while editing. (default: 10000)
+  --output <file>       Write the results to a JSON file.
+  --baseline <file>     Compare the results with ones written by an earlier run.`;
+
+async function main(args) {
+  const options = parseArgs(args);
+  if (!options) {
+    console.error(USAGE);
+    process.exitCode = 1;
+    return;
+  }
+
+  const results = [];
+  for (const name of options.suites) {
+    const suite = SUITES[name]();
+    console.error(`Running ${name}...`);
+    for (const result of await suite.run(options)) {
+      console.error(formatResult(result));
+      if (result.failed) process.exitCode = 1;
+      results.push(result);
+    }
+  }
+
+  const report = {
+    date: new Date().toISOString(),
+    node: process.version,
+    platform: process.platform,
+    arch: process.arch,
+    cpu: os.cpus()[0] ? os.cpus()[0].model : 'unknown',
+    results
+  };
+
+  const json = JSON.stringify(report, null, 2);
+  if (options.output) {
+    fs.writeFileSync(options.output, json + '\n');
+  } else {
+    console.log(json);
+  }
+
+  if (options.baseline) {
+    compare(JSON.parse(fs.readFileSync(options.baseline, 'utf8')), report);
+  }
+}
+
+function parseArgs(args) {
+  const options = {suites: [], sizes: [], kinds: [], measureOptions: {}, keystrokes: 500, cachedNodes: 10000};
+  for (let i = 0; i < args.length; i++) {
+    const arg = args[i];
+    switch (arg) {
+      case '--size': {
+        const size = parseSize(args[++i]);
+        if (!size) return null;
+        options.sizes.push(size);
+        break;
+      }
+      case '--kind':
+        if (!CORPUS_KINDS.includes(args[i + 1])) return null;
+        options.kinds.push(args[++i]);
+        break;
+      case '--quick':
+        options.measureOptions = {warmup: 1, minTime: 0, minIterations: 1};
+        options.keystrokes = 20;
+        break;
+      case '--keystrokes':
+      case '--cached-nodes': {
+        const count = Number(args[++i]);
+        if (!Number.isInteger(count) || count < 0) return null;
+        options[arg === '--keystrokes' ? 'keystrokes' : 'cachedNodes'] = count;
+        break;
+      }
+      case '--session':
+        options.session = args[++i];
+        break;
+      case '--output':
+        options.output = args[++i];
+        break;
+      case '--baseline':
+        options.baseline = args[++i];
+        break;
+      default:
+        if (!SUITES[arg]) return null;
+        options.suites.push(arg);
+    }
+  }
+
+  if (options.suites.length === 0) options.suites = Object.keys(SUITES);
+  if (options.sizes.length === 0) options.sizes = [10 * 1024, 100 * 1024, 1024 * 1024];
+  if (options.kinds.length === 0) options.kinds = ['typical'];
+  return options;
+}
+
+function parseSize(arg) {
+  const match = /^(\d+)([km]?)$/i.exec(arg || '');
+  if (!match) return null;
+  const multiplier = {'': 1, k: 1024, m: 1024 * 1024}[match[2].toLowerCase()];
+  return Number(match[1]) * multiplier;
+}
+
+function resultKey(result) {
+  return [result.suite, result.benchmark, result.input, result.corpus.kind, result.corpus.size].join(' ');
+}
+
+function formatResult(result) {
+  const parts = [];
+  if (result.throughput !== undefined) {
+    parts.push(`${formatNumber(result.throughput)} ${result.unit}`);
+  }
+  if (result.stats) {
+    const {mean, p50, p99, max} = result.stats;
+    parts.push(`mean/p50/p99/max ${[mean, p50, p99, max].map(time => time.toFixed(3)).join('/')} ms`);
+  }
+  if (result.values) {
+    for (const key in result.values) parts.push(`${key} ${formatNumber(result.values[key])}`);
+  }
+  if (result.failed) parts.push('FAILED');
+  return `  ${resultKey(result).padEnd(56)} ${parts.join(', ')}`;
+}
+
+function formatNumber(number) {
+  if (Math.abs(number) >= 1e6) return (number / 1e6).toFixed(2) + 'M';
+  if (Math.abs(number) >= 1e3) return (number / 1e3).toFixed(2) + 'k';
+  return Number.isInteger(number) ? String(number) : number.toFixed(2);
+}
+
+// Results are matched by their suite, benchmark, input type and corpus. The
+// change is in throughput when there is one, and in mean time otherwise, so
+// that a positive change is always an improvement. Results without either
+// aren't compared.
+function compare(baseline, report) {
+  const baselineResults = new Map(baseline.results.map(result => [resultKey(result), result]));
+  console.error(`\nCompared with ${baseline.date} (${baseline.node}):`);
+  for (const result of report.results) {
+    const previous = baselineResults.get(resultKey(result));
+    if (!previous || !result.stats || !previous.stats) continue;
+    const change = result.throughput === undefined
+      ? previous.stats.mean / result.stats.mean - 1
+      : result.throughput / previous.throughput - 1;
+    const sign = change >= 0 ? '+' : '';
+    console.error(`  ${resultKey(result).padEnd(56)} ${sign}${(change * 100).toFixed(1)}%`);
+  }
+}
+
+main(process.argv.slice(2)).catch(error => {
+  console.error(error);
+  process.exitCode = 1;
+});
@@ -0,0 +1,137 @@
+// Measures how quickly whole documents are parsed, traversed and queried.
+
+const Parser = require('..');
+const JavaScript = require('tree-sitter-javascript');
+const {TextBuffer} = require('superstring');
+const {generateCorpus} = require('./corpus');
+const {measure} = require('./harness');
+
+const CALLBACK_CHUNK_SIZE = 1024;
+
+// Range queries cover a viewport of the same size in every corpus, so their
+// cost shouldn't grow with the size of the file.
+const VIEWPORT_SIZE = 4 * 1024;
+const VIEWPORT_TYPES = ['function_declaration', 'class_declaration', 'call_expression'];
+
+// Roughly the captures of a syntax highlighting query.
+const HIGHLIGHT_QUERY = `
+  (identifier) @variable
+  (property_identifier) @property
+  (function_declaration name: (identifier) @function)
+  (call_expression function: (member_expression property: (property_identifier) @function.method))
+  (string) @string
+  (template_string) @string
+  (number) @number
+  ["const" "let" "function" "class" "return" "if" "for"] @keyword
+`;
+
+const INPUT_TYPES = {
+  string: (parser, source) => () => parser.parse(source),
+  callback: (parser, source) => () => parser.parse(index => source.slice(index, index + CALLBACK_CHUNK_SIZE)),
+  textBuffer: (parser, source) => {
+    const buffer = new TextBuffer(source);
+    return () => parser.parseTextBufferSync(buffer);
+  }
+};
+
+function run({sizes, kinds, measureOptions}) {
+  const parser = new Parser().setLanguage(JavaScript);
+  const query = new Parser.Query(JavaScript, HIGHLIGHT_QUERY);
+  const results = [];
+
+  for (const kind of kinds) {
+    for (const size of sizes) {
+      const source = generateCorpus({kind, size});
+      const megabytes = Buffer.byteLength(source) / (1024 * 1024);
+      const corpus = {kind, size: source.length};
+
+      for (const inputType in INPUT_TYPES) {
+        const stats = measure(INPUT_TYPES[inputType](parser, source), measureOptions);
+        results.push(result('parse', corpus, inputType, stats, megabytes, 'MB/s'));
+      }
+
+      const tree = parser.parse(source);
+      const nodeCount = countNodes(tree);
+
+      results.push(result(
+        'traverse.cursor', corpus, 'string',
+        measure(() => countNodes(tree), measureOptions), nodeCount, 'nodes/s'
+      ));
+
+      results.push(result(
+        'traverse.children', corpus, 'string',
+        measure(() => visitChildren(tree.rootNode), measureOptions), nodeCount, 'nodes/s'
+      ));
+
+      const captureCount = query.captures(tree.rootNode).length;
+      results.push(result(
+        'query.captures', corpus, 'string',
+        measure(() => query.captures(tree.rootNode), measureOptions), captureCount, 'captures/s'
+      ));
+
+      const viewportStart = Math.max(0, Math.floor((source.length - VIEWPORT_SIZE) / 2));
+      const viewportEnd = viewportStart + VIEWPORT_SIZE;
+      const rangeIndex = tree.buildRangeIndex(VIEWPORT_TYPES);
+      const viewportNodeCount = rangeIndex.overlapping(viewportStart, viewportEnd).length;
+      results.push(result(
+        'rangeIndex.overlapping', corpus, 'string',
+        measure(() => rangeIndex.overlapping(viewportStart, viewportEnd), measureOptions),
+        viewportNodeCount, 'nodes/s'
+      ));
+
+      const viewportStartPosition = tree.rootNode.descendantForIndex(viewportStart).startPosition;
+      const viewportEndPosition = tree.rootNode.descendantForIndex(viewportEnd).endPosition;
+      results.push(result(
+        'descendantsOfType.viewport', corpus, 'string',
+        measure(
+          () => tree.rootNode.descendantsOfType(VIEWPORT_TYPES, viewportStartPosition, viewportEndPosition),
+          measureOptions
+        ),
+        viewportNodeCount, 'nodes/s'
+      ));
+    }
+  }
+
+  return results;
+}
+
+function result(benchmark, corpus, input, stats, workPerIteration, unit) {
+  return {
+    suite: 'throughput',
+    benchmark,
+    input,
+    corpus,
+    throughput: workPerIteration / (stats.mean / 1000),
+    unit,
+    stats
+  };
+}
+
+function countNodes(tree) {
+  const cursor = tree.walk();
+  let count = 1;
+  for (;;) {
+    if (cursor.gotoFirstChild() || cursor.gotoNextSibling()) {
+      count++;
+      continue;
+    }
+    let done = true;
+    while (cursor.gotoParent()) {
+      if (cursor.gotoNextSibling()) {
+        count++;
+        done = false;
+        break;
+      }
+    }
+    if (done) return count;
+  }
+}
+
+// Walks the tree through `SyntaxNode.children`, which marshals each node's
+// children to JS.
+function visitChildren(node) {
+  const {children} = node;
+  for (let i = 0; i < children.length; i++) visitChildren(children[i]);
+}
+
+module.exports = {name: 'throughput', run, HIGHLIGHT_QUERY};
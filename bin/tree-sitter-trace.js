@@ -0,0 +1,123 @@
+#!/usr/bin/env node
+
+const fs = require('fs');
+const path = require('path');
+const Parser = require('..');
+const {Language, ParseTrace} = Parser;
+
+const USAGE = `Usage:
+  tree-sitter-trace record <grammar> <source-file> <trace-file>
+  tree-sitter-trace analyze <trace-file> [--source <source-file>] [--encoding <encoding>] [--limit <n>] [--json]
+
+The grammar is either the name or path of a grammar's Node module, or a
+shared library containing a compiled grammar.`;
+
+function main(args) {
+  const [command, ...rest] = args;
+  switch (command) {
+    case 'record': return record(rest);
+    case 'analyze': return analyze(rest);
+    default: return usage();
+  }
+}
+
+function usage() {
+  console.error(USAGE);
+  process.exitCode = 1;
+}
+
+function loadGrammar(grammar) {
+  if (/\.(so|dylib|dll)$/.test(grammar)) return Language.load(path.resolve(grammar));
+  try {
+    return require(path.resolve(grammar));
+  } catch (_) {
+    return require(grammar);
+  }
+}
+
+function record(args) {
+  if (args.length !== 3) return usage();
+  const [grammar, sourcePath, tracePath] = args;
+  const source = fs.readFileSync(sourcePath, 'utf8');
+
+  const parser = new Parser();
+  parser.setLanguage(loadGrammar(grammar));
+  parser.startTrace();
+  const start = process.hrtime.bigint();
+  parser.parse(source);
+  const elapsed = process.hrtime.bigint() - start;
+  const trace = parser.stopTrace();
+
+  fs.writeFileSync(tracePath, trace.toBuffer());
+  console.log(
+    `Recorded ${trace.entries.length} actions in ${formatTime(Number(elapsed))}` +
+    (trace.droppedCount ? ` (${trace.droppedCount} dropped)` : '')
+  );
+}
+
+function analyze(args) {
+  let tracePath, sourcePath, positionEncoding, limit = 20, json = false;
+  for (let i = 0; i < args.length; i++) {
+    if (args[i] === '--source') sourcePath = args[++i];
+    else if (args[i] === '--encoding') positionEncoding = args[++i];
+    else if (args[i] === '--limit') limit = parseInt(args[++i], 10);
+    else if (args[i] === '--json') json = true;
+    else if (!tracePath) tracePath = args[i];
+    else return usage();
+  }
+  if (!tracePath || !(limit > 0)) return usage();
+
+  const trace = ParseTrace.fromBuffer(fs.readFileSync(tracePath));
+  const source = sourcePath ? fs.readFileSync(sourcePath, 'utf8') : undefined;
+  const summary = trace.analyze({source, positionEncoding, limit});
+
+  if (json) {
+    console.log(JSON.stringify(summary, null, 2));
+    return;
+  }
+
+  console.log(`${summary.recordCount} actions, ${formatTime(summary.totalTime)}, at most ${summary.maxVersionCount} stack versions`);
+  if (summary.droppedCount) console.log(`${summary.droppedCount} actions were dropped from the start of the trace`);
+
+  printTable('Time by action', ['action', 'count', 'time'], summary.messages.slice(0, limit).map(m =>
+    [m.message, m.count, formatTime(m.time)]
+  ));
+  printTable('Time by parse state', ['state', 'processed', 'splits', 'time'], summary.states.map(s =>
+    [s.state, s.processCount, s.splitCount, formatTime(s.time)]
+  ));
+  printTable('States with the most splits', ['state', 'splits', 'processed'], summary.splitStates.map(s =>
+    [s.state, s.splitCount, s.processCount]
+  ));
+  printTable('Positions lexed more than once', ['position', 'lexes'], summary.relexedPositions.map(p =>
+    [formatPosition(p.startPosition, p.startIndex), p.count]
+  ));
+  printTable('Error recovery', ['start', 'end', 'actions', 'time'], summary.errorRecoveryRegions.map(r =>
+    [formatPosition(r.startPosition, r.startIndex), formatPosition(r.endPosition, r.endIndex), r.actionCount, formatTime(r.time)]
+  ));
+}
+
+function printTable(title, columns, rows) {
+  console.log(`\n${title}:`);
+  if (rows.length === 0) {
+    console.log('  (none)');
+    return;
+  }
+  const cells = [columns, ...rows.map(row => row.map(String))];
+  const widths = columns.map((_, i) => Math.max(...cells.map(row => row[i].length)));
+  for (const row of cells) {
+    console.log('  ' + row.map((cell, i) => cell.padEnd(widths[i])).join('  ').trimEnd());
+  }
+}
+
+function formatPosition({row, column}, index) {
+  return `${row + 1}:${column + 1}` + (index === undefined ? '' : ` (${index})`);
+}
+
+function formatTime(nanoseconds) {
+  if (nanoseconds >= 1e9) return `${(nanoseconds / 1e9).toFixed(2)}s`;
+  if (nanoseconds >= 1e6) return `${(nanoseconds / 1e6).toFixed(2)}ms`;
+  if (nanoseconds >= 1e3) return `${(nanoseconds / 1e3).toFixed(1)}µs`;
+  return `${nanoseconds}ns`;
+}
+
+main(process.argv.slice(2));
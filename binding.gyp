@@ -1,4 +1,46 @@
 {
+  "variables": {
+    "build_microbench%": "false",
+    "lto%": "false",
+    "pgo%": "",
+    "pgo_dir%": "<(module_root_dir)/pgo",
+  },
+  # The optimized build profile, which is enabled with `-Dlto=true`, and
+  # `-Dpgo=generate` or `-Dpgo=use`. See benchmark/pgo.js.
+  'target_defaults': {
+    'conditions': [
+      ['lto == "true"', {
+        'cflags': ['-flto'],
+        'ldflags': ['-flto'],
+        'xcode_settings': {
+          'LLVM_LTO': 'YES',
+        },
+        'conditions': [
+          # The tree_sitter library also contains regular code, so that it
+          # can be archived without the linker plugin. Without the plugin,
+          # that code is linked instead, and LTO doesn't cross the library,
+          # so benchmark/pgo.js checks for it.
+          ['OS == "linux"', {
+            'cflags': ['-ffat-lto-objects'],
+          }],
+        ],
+      }],
+      ['pgo == "generate"', {
+        'cflags': ['-fprofile-generate=<(pgo_dir)'],
+        'ldflags': ['-fprofile-generate=<(pgo_dir)'],
+        'xcode_settings': {
+          'OTHER_CFLAGS': ['-fprofile-generate=<(pgo_dir)'],
+          'OTHER_LDFLAGS': ['-fprofile-generate=<(pgo_dir)'],
+        },
+      }],
+      ['pgo == "use"', {
+        'cflags': ['-fprofile-use=<(pgo_dir)', '-fprofile-correction', '-Wno-missing-profile'],
+        'xcode_settings': {
+          'OTHER_CFLAGS': ['-fprofile-use=<(pgo_dir)/default.profdata', '-Wno-profile-instr-unprofiled'],
+        },
+      }],
+    ],
+  },
   "targets": [
     {
       "target_name": "tree_sitter_runtime_binding",
@@ -6,11 +48,22 @@
       "sources": [
         "src/binding.cc",
         "src/conversions.cc",
+        "src/interval_tree.cc",
         "src/language.cc",
+        "src/language_registry.cc",
         "src/logger.cc",
+        "src/marker_layer.cc",
+        "src/metrics.cc",
         "src/node.cc",
+        "src/parse_stats.cc",
         "src/parser.cc",
+        "src/position_index.cc",
         "src/query.cc",
+        "src/range_index.cc",
+        "src/rewrite.cc",
+        "src/slow_log.cc",
+        "src/text_search.cc",
+        "src/trace_events.cc",
         "src/tree.cc",
         "src/tree_cursor.cc",
         "src/util.cc",
@@ -25,6 +78,9 @@
           'xcode_settings': {
             'MACOSX_DEPLOYMENT_TARGET': '10.9',
           },
+        }],
+        ['OS == "linux"', {
+          'libraries': ['-ldl'],
         }]
       ],
       "cflags": [
@@ -49,4 +105,35 @@
       ]
     }
   ],
+  'conditions': [
+    ['build_microbench == "true"', {
+      'targets': [
+        {
+          "target_name": "microbench",
+          "type": "executable",
+          "dependencies": ["tree_sitter"],
+          "sources": [
+            "benchmark/native/microbench.cc",
+            "src/interval_tree.cc",
+            "src/language_registry.cc",
+            "src/position_index.cc",
+          ],
+          "include_dirs": [
+            "vendor/tree-sitter/lib/include",
+          ],
+          'conditions': [
+            ['OS == "linux"', {
+              'libraries': ['-ldl'],
+            }]
+          ],
+          "cflags": [
+            "-std=c++0x",
+          ],
+          'xcode_settings': {
+            'CLANG_CXX_LANGUAGE_STANDARD': 'c++11',
+          },
+        },
+      ],
+    }],
+  ],
 }
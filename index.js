@@ -9,14 +9,16 @@ try {
   }
 }
 
+const path = require('path');
 const util = require('util')
-const {Query, Parser, NodeMethods, Tree, TreeCursor} = binding;
+const {ParseTrace, decodeLogRecords} = require('./trace');
+const {MarkerLayer, Query, Parser, NodeMethods, RangeIndex, Tree, TreeCursor} = binding;
 
 /*
  * Tree
  */
 
-const {rootNode, edit} = Tree.prototype;
+const {rootNode, edit, _chunk, _tokens, _search} = Tree.prototype;
 
 Object.defineProperty(Tree.prototype, 'rootNode', {
   get() {
@@ -32,7 +34,8 @@ Tree.prototype.edit = function(arg) {
     arg.newEndPosition.row, arg.newEndPosition.column,
     arg.startIndex,
     arg.oldEndIndex,
-    arg.newEndIndex
+    arg.newEndIndex,
+    arg.newText
   );
 };
 
@@ -40,6 +43,105 @@ Tree.prototype.walk = function() {
   return this.rootNode.walk()
 };
 
+Tree.prototype.buildRangeIndex = function(types) {
+  if (typeof types === 'string') types = [types]
+  const index = new RangeIndex(this, types);
+  index.tree = this;
+  return index;
+};
+
+Tree.prototype.chunk = function({maxBytes, preferTypes = []} = {}) {
+  if (typeof preferTypes === 'string') preferTypes = [preferTypes]
+  return _chunk.call(this, maxBytes, preferTypes);
+};
+
+Tree.prototype.tokens = function({range, includeAnonymous = true, includeExtras = true, includeText = false} = {}) {
+  return _tokens.call(
+    this,
+    range && range.startIndex,
+    range && range.endIndex,
+    includeAnonymous,
+    includeExtras,
+    includeText ? retainedSource(this, 'Token text') : undefined
+  );
+};
+
+Tree.prototype.search = function(pattern, {inTypes, notInTypes = [], caseInsensitive = false} = {}) {
+  if (typeof inTypes === 'string') inTypes = [inTypes]
+  if (typeof notInTypes === 'string') notInTypes = [notInTypes]
+  return _search.call(this, pattern, inTypes, notInTypes, caseInsensitive, retainedSource(this, 'Searching'));
+};
+
+// The text that the tree was parsed from, for trees parsed from a string or
+// a TextBuffer.
+function retainedSource(tree, feature) {
+  if (typeof tree.input === 'string') return tree.input;
+  if (tree.input && typeof tree.input.getText === 'function') return tree.input.getText();
+  throw new TypeError(`${feature} is only available for trees parsed from a string or a TextBuffer`);
+}
+
+Tree.prototype.addMarkerLayer = function() {
+  const layer = new MarkerLayer(this);
+  layer.tree = this;
+  return layer;
+};
+
+/*
+ * MarkerLayer
+ */
+
+const {_findOverlapping, _findContaining, _setTree, _size: _markerLayerSize} = MarkerLayer.prototype;
+
+Object.defineProperty(MarkerLayer.prototype, 'size', {
+  get() {
+    return _markerLayerSize.call(this);
+  }
+});
+
+MarkerLayer.prototype.findOverlapping = function(startIndex, endIndex = startIndex) {
+  return _findOverlapping.call(this, startIndex, endIndex);
+};
+
+MarkerLayer.prototype.findContaining = function(startIndex, endIndex = startIndex) {
+  return _findContaining.call(this, startIndex, endIndex);
+};
+
+MarkerLayer.prototype.setTree = function(newTree) {
+  _setTree.call(this, newTree);
+  this.tree = newTree;
+  return this;
+};
+
+/*
+ * RangeIndex
+ */
+
+const {_overlapping, _containing, _within, _update, _size} = RangeIndex.prototype;
+
+Object.defineProperty(RangeIndex.prototype, 'size', {
+  get() {
+    return _size.call(this);
+  }
+});
+
+RangeIndex.prototype.overlapping = function(startIndex, endIndex = startIndex) {
+  return unmarshalNodes(_overlapping.call(this, startIndex, endIndex), this.tree);
+};
+
+RangeIndex.prototype.containing = function(startIndex, endIndex = startIndex) {
+  return unmarshalNodes(_containing.call(this, startIndex, endIndex), this.tree);
+};
+
+RangeIndex.prototype.within = function(startIndex, endIndex) {
+  return unmarshalNodes(_within.call(this, startIndex, endIndex), this.tree);
+};
+
+RangeIndex.prototype.update = function(newTree) {
+  _update.call(this, newTree);
+  this.tree = newTree;
+  return this;
+};
+
 /*
  * Node
  */
@@ -194,6 +296,35 @@ class SyntaxNode {
     return unmarshalNode(NodeMethods.namedChild(this.tree, index), this.tree);
   }
 
+  fieldsAll() {
+    marshalNode(this);
+    const result = {};
+    const fieldsAndNodes = NodeMethods.fieldsAll(this.tree);
+    if (!fieldsAndNodes) return result;
+    const [fieldIds, nodes] = fieldsAndNodes;
+    unmarshalNodes(nodes, this.tree);
+    const {nodeFieldNamesById} = this.tree.language;
+    for (let i = 0, {length} = nodes; i < length; i++) {
+      const fieldName = nodeFieldNamesById[fieldIds[i]];
+      if (result[fieldName]) {
+        result[fieldName].push(nodes[i]);
+      } else {
+        result[fieldName] = [nodes[i]];
+      }
+    }
+    return result;
+  }
+
+  childrenSlice(start, count) {
+    marshalNode(this);
+    return unmarshalNodes(NodeMethods.childrenSlice(this.tree, start, count), this.tree);
+  }
+
+  namedChildrenSlice(start, count) {
+    marshalNode(this);
+    return unmarshalNodes(NodeMethods.namedChildrenSlice(this.tree, start, count), this.tree);
+  }
+
   firstChildForIndex(index) {
     marshalNode(this);
     return unmarshalNode(NodeMethods.firstChildForIndex(this.tree, index), this.tree);
@@ -248,15 +379,75 @@ class SyntaxNode {
   }
 }
 
+/*
+ * Language
+ */
+
+const loadedLanguages = new Map();
+
+const Language = {
+  SYMBOL_VISIBLE: 1,
+  SYMBOL_NAMED: 2,
+
+  getMetadata(language) {
+    if (!language.metadata) {
+      if (!language.nodeSubclasses) initializeLanguageNodeClasses(language);
+      const metadata = binding.getLanguageMetadata(language);
+      metadata.nodeTypeNamesById = language.nodeTypeNamesById;
+      metadata.nodeFieldNamesById = language.nodeFieldNamesById;
+      metadata.isSubtype = (supertypeId, typeId) => {
+        const index = metadata.supertypeSymbols.indexOf(supertypeId);
+        if (index === -1) return false;
+        const word = metadata.subtypeSets[index * metadata.wordsPerSymbolSet + (typeId >>> 5)];
+        return (word & (1 << (typeId & 31))) !== 0;
+      };
+      language.metadata = Object.freeze(metadata);
+    }
+    return language.metadata;
+  },
+
+  load(libraryPath, symbolName, {nodeTypeInfo} = {}) {
+    libraryPath = path.resolve(libraryPath);
+    if (symbolName == null) symbolName = languageFunctionNameForPath(libraryPath);
+
+    const key = libraryPath + '\0' + symbolName;
+    let language = loadedLanguages.get(key);
+    if (!language) {
+      language = binding.loadLanguage(libraryPath, symbolName);
+      language.name = symbolName.replace(/^tree_sitter_/, '');
+      loadedLanguages.set(key, language);
+    }
+    if (nodeTypeInfo && !language.nodeTypeInfo) {
+      language.nodeTypeInfo = nodeTypeInfo;
+
+      // The node classes may have been initialized without the node types,
+      // so the supertypes have to be registered now.
+      if (language.nodeSubclasses) {
+        registerLanguageSupertypes(language);
+        delete language.metadata;
+      }
+    }
+    return language;
+  }
+};
+
+function languageFunctionNameForPath(libraryPath) {
+  const name = path.basename(libraryPath)
+    .replace(/\.(so|dylib|dll|node)$/, '')
+    .replace(/^lib/, '')
+    .replace(/^tree[-_]sitter[-_]/, '');
+  return 'tree_sitter_' + name.replace(/-/g, '_');
+}
+
 /*
  * Parser
  */
 
-const {parse, parseTextBuffer, parseTextBufferSync, setLanguage} = Parser.prototype;
+const {parse, parseTextBuffer, parseTextBufferSync, setLanguage, _setLogBuffer: setLogBuffer, _drainLog: drainLog} = Parser.prototype;
 const languageSymbol = Symbol('parser.language');
 
 Parser.prototype.setLanguage = function(language) {
-  setLanguage.call(this, language);
+  setLanguage.call(this, language, typeof language.name === 'string' ? language.name : undefined);
   this[languageSymbol] = language;
   if (!language.nodeSubclasses) {
     initializeLanguageNodeClasses(language)
@@ -264,11 +455,106 @@ Parser.prototype.setLanguage = function(language) {
   return this;
 };
 
+const DEFAULT_DETECTION_PREFIX_BYTES = 16 * 1024;
+
+Parser.detectLanguage = function(input, candidates, {prefixBytes = DEFAULT_DETECTION_PREFIX_BYTES} = {}) {
+  const text = detectionPrefix(input, prefixBytes);
+  const trials = candidates.map((language, index) => new Promise(resolve => {
+    if (!language.nodeSubclasses) initializeLanguageNodeClasses(language);
+    Parser._trialParse((tree, errorCount, errorCost) => {
+      if (tree) {
+        tree.input = text;
+        tree.getText = getTextFromString;
+        tree.language = language;
+        tree.positionEncoding = 'utf16';
+      }
+      resolve({language, tree, errorCount, errorCost, index});
+    }, language, text);
+  }));
+
+  return Promise.all(trials).then(results => {
+    let best = null;
+    for (const result of results) {
+      if (!result.tree) continue;
+      if (
+        !best ||
+        result.errorCount < best.errorCount ||
+        (result.errorCount === best.errorCount && result.errorCost < best.errorCost)
+      ) best = result;
+    }
+    if (!best) return null;
+    const {language, tree, errorCount, errorCost} = best;
+    return {language, tree, errorCount, errorCost};
+  });
+};
+
+// Only a prefix of the input is parsed, ending at a line break when there
+// is one, so that candidates aren't penalized for an unterminated construct.
+function detectionPrefix(input, prefixBytes) {
+  if (Buffer.byteLength(input, 'utf8') <= prefixBytes) return input;
+  let prefix = Buffer.from(input.slice(0, prefixBytes), 'utf8').subarray(0, prefixBytes).toString('utf8');
+  if (prefix.endsWith('\uFFFD')) prefix = prefix.slice(0, -1);
+  const lastNewline = prefix.lastIndexOf('\n');
+  return lastNewline > 0 ? prefix.slice(0, lastNewline + 1) : prefix;
+}
+
+const DEFAULT_LOG_BUFFER_CAPACITY = 1024 * 1024;
+const DEFAULT_TRACE_CAPACITY = 64 * 1024 * 1024;
+const logStringsSymbol = Symbol('parser.logStrings');
+
+Parser.prototype.setLogBuffer = function(options) {
+  let capacity = 0;
+  if (options) {
+    capacity = options.capacity === undefined ? DEFAULT_LOG_BUFFER_CAPACITY : options.capacity;
+  }
+  setLogBuffer.call(this, capacity, false);
+  this[logStringsSymbol] = [];
+  return this;
+};
+
+Parser.prototype.drainLog = function() {
+  const result = drainLogRecords(this);
+  if (!result) return null;
+  return {
+    entries: decodeLogRecords(result.records, this[logStringsSymbol]),
+    droppedCount: result.droppedCount
+  };
+};
+
+// Tracing logs to a buffer with timestamps, which is large by default so
+// that a whole parse can be recorded.
+Parser.prototype.startTrace = function({capacity = DEFAULT_TRACE_CAPACITY} = {}) {
+  setLogBuffer.call(this, capacity, true);
+  this[logStringsSymbol] = [];
+  return this;
+};
+
+Parser.prototype.stopTrace = function() {
+  const result = drainLogRecords(this);
+  if (!result) return null;
+  const trace = new ParseTrace(result.records, this[logStringsSymbol], result.droppedCount);
+  this.setLogBuffer(false);
+  return trace;
+};
+
+function drainLogRecords(parser) {
+  const result = drainLog.call(parser);
+  if (!result) return null;
+  const [records, newStrings, droppedCount] = result;
+  parser[logStringsSymbol].push(...newStrings);
+  return {records, droppedCount};
+}
+
+function attachParseStats(parser, tree) {
+  const parseStats = parser.getParseStats();
+  if (parseStats) tree.parseStats = parseStats;
+}
+
 Parser.prototype.getLanguage = function(language) {
   return this[languageSymbol] || null;
 };
 
-Parser.prototype.parse = function(input, oldTree, {bufferSize, includedRanges}={}) {
+Parser.prototype.parse = function(input, oldTree, {bufferSize, includedRanges, positionEncoding}={}) {
   let getText, treeInput = input
   if (typeof input === 'string') {
     const inputString = input;
@@ -277,29 +563,35 @@ Parser.prototype.parse = function(input, oldTree, {bufferSize, includedRanges}={
   } else {
     getText = getTextFromFunction
   }
+  positionEncoding = normalizePositionEncoding(positionEncoding, oldTree);
   const tree = parse.call(
     this,
     input,
     oldTree,
     bufferSize,
-    includedRanges
+    includedRanges,
+    POSITION_ENCODINGS[positionEncoding],
+    typeof treeInput === 'string' ? treeInput : undefined
   );
   if (tree) {
     tree.input = treeInput
-    tree.getText = getText
+    tree.getText = positionEncoding === 'utf16' ? getText : getTextInUTF16Range(getText)
     tree.language = this.getLanguage()
+    tree.positionEncoding = positionEncoding
+    attachParseStats(this, tree)
   }
   return tree
 };
 
 Parser.prototype.parseTextBuffer = function(
   buffer, oldTree,
-  {syncTimeoutMicros, includedRanges} = {}
+  {syncTimeoutMicros, includedRanges, positionEncoding} = {}
 ) {
   let tree
   let resolveTreePromise
   const treePromise = new Promise(resolve => { resolveTreePromise = resolve })
   const snapshot = buffer.getSnapshot();
+  positionEncoding = normalizePositionEncoding(positionEncoding, oldTree);
   parseTextBuffer.call(
     this,
     result => {
@@ -307,15 +599,20 @@ Parser.prototype.parseTextBuffer = function(
       snapshot.destroy();
       if (tree) {
         tree.input = buffer
-        tree.getText = getTextFromTextBuffer
+        tree.getText = positionEncoding === 'utf16'
+          ? getTextFromTextBuffer
+          : getTextInUTF16Range(getTextFromTextBuffer)
         tree.language = this.getLanguage()
+        tree.positionEncoding = positionEncoding
+        attachParseStats(this, tree)
       }
       resolveTreePromise(tree);
     },
     snapshot,
     oldTree,
     includedRanges,
-    syncTimeoutMicros
+    syncTimeoutMicros,
+    POSITION_ENCODINGS[positionEncoding]
   );
 
   // If the parse finished synchronously within the time specified by the
@@ -324,13 +621,24 @@ Parser.prototype.parseTextBuffer = function(
   return tree || treePromise
 };
 
-Parser.prototype.parseTextBufferSync = function(buffer, oldTree, {includedRanges}={}) {
+Parser.prototype.parseTextBufferSync = function(buffer, oldTree, {includedRanges, positionEncoding}={}) {
   const snapshot = buffer.getSnapshot();
-  const tree = parseTextBufferSync.call(this, snapshot, oldTree, includedRanges);
+  positionEncoding = normalizePositionEncoding(positionEncoding, oldTree);
+  const tree = parseTextBufferSync.call(
+    this,
+    snapshot,
+    oldTree,
+    includedRanges,
+    POSITION_ENCODINGS[positionEncoding]
+  );
   if (tree) {
     tree.input = buffer;
-    tree.getText = getTextFromTextBuffer;
+    tree.getText = positionEncoding === 'utf16'
+      ? getTextFromTextBuffer
+      : getTextInUTF16Range(getTextFromTextBuffer);
     tree.language = this.getLanguage()
+    tree.positionEncoding = positionEncoding
+    attachParseStats(this, tree)
   }
   snapshot.destroy();
   return tree;
@@ -376,7 +684,7 @@ TreeCursor.prototype.reset = function(node) {
  * Query
  */
 
-const {_matches, _captures} = Query.prototype;
+const {_matches, _captures, _rewrite} = Query.prototype;
 
 const PREDICATE_STEP_TYPE = {
   DONE: 0,
@@ -384,6 +692,12 @@ const PREDICATE_STEP_TYPE = {
   STRING: 2,
 }
 
+const REWRITE_PREDICATE_KIND = {
+  EQ_STRING: 0,
+  EQ_CAPTURE: 1,
+  MATCH: 2,
+}
+
 const ZERO_POINT = { row: 0, column: 0 };
 
 Query.prototype._init = function() {
@@ -399,6 +713,11 @@ Query.prototype._init = function() {
   const refutedProperties = new Array(patternCount);
   const predicates = new Array(patternCount);
 
+  // The text predicates are also evaluated natively by `rewrite`, which
+  // takes them as a flat list of [patternIndex, kind, isPositive, captureName,
+  // value] entries.
+  const rewritePredicates = [];
+
   const FIRST  = 0
   const SECOND = 2
   const THIRD  = 4
@@ -432,6 +751,7 @@ Query.prototype._init = function() {
           if (steps[THIRD] === PREDICATE_STEP_TYPE.CAPTURE) {
             const captureName1 = steps[SECOND + 1];
             const captureName2 = steps[THIRD  + 1];
+            rewritePredicates.push(i, REWRITE_PREDICATE_KIND.EQ_CAPTURE, isPositive, captureName1, captureName2);
             predicates[i].push(function(captures) {
               let node1, node2
               for (const c of captures) {
@@ -443,6 +763,7 @@ Query.prototype._init = function() {
           } else {
             const captureName = steps[SECOND + 1];
             const stringValue = steps[THIRD  + 1];
+            rewritePredicates.push(i, REWRITE_PREDICATE_KIND.EQ_STRING, isPositive, captureName, stringValue);
             predicates[i].push(function(captures) {
               for (const c of captures) {
                 if (c.name === captureName) {
@@ -466,6 +787,7 @@ Query.prototype._init = function() {
           );
           const captureName = steps[SECOND + 1];
           const regex = new RegExp(steps[THIRD + 1]);
+          rewritePredicates.push(i, REWRITE_PREDICATE_KIND.MATCH, true, captureName, text => regex.test(text));
           predicates[i].push(function(captures) {
             for (const c of captures) {
               if (c.name === captureName) return regex.test(c.node.text);
@@ -508,6 +830,7 @@ Query.prototype._init = function() {
   this.setProperties = Object.freeze(setProperties);
   this.assertedProperties = Object.freeze(assertedProperties);
   this.refutedProperties = Object.freeze(refutedProperties);
+  this._rewritePredicates = rewritePredicates;
 }
 
 Query.prototype.matches = function(rootNode, startPosition = ZERO_POINT, endPosition = ZERO_POINT) {
@@ -521,6 +844,7 @@ Query.prototype.matches = function(rootNode, startPosition = ZERO_POINT, endPosi
 
   let i = 0
   let nodeIndex = 0;
+  let droppedCount = 0;
   while (i < returnedMatches.length) {
     const patternIndex = returnedMatches[i++];
     const captures = [];
@@ -542,9 +866,12 @@ Query.prototype.matches = function(rootNode, startPosition = ZERO_POINT, endPosi
       if (assertedProperties) result.assertedProperties = assertedProperties;
       if (refutedProperties) result.refutedProperties = refutedProperties;
       results.push(result);
+    } else {
+      droppedCount++;
     }
   }
 
+  if (droppedCount > 0) binding.addDroppedQueryMatches(droppedCount);
   return results;
 }
 
@@ -559,6 +886,7 @@ Query.prototype.captures = function(rootNode, startPosition = ZERO_POINT, endPos
 
   let i = 0
   let nodeIndex = 0;
+  let droppedCount = 0;
   while (i < returnedMatches.length) {
     const patternIndex = returnedMatches[i++];
     const captureIndex = returnedMatches[i++];
@@ -581,12 +909,153 @@ Query.prototype.captures = function(rootNode, startPosition = ZERO_POINT, endPos
       if (assertedProperties) result.assertedProperties = assertedProperties;
       if (refutedProperties) result.refutedProperties = refutedProperties;
       results.push(result);
+    } else {
+      droppedCount++;
     }
   }
 
+  if (droppedCount > 0) binding.addDroppedQueryMatches(droppedCount);
   return results;
 }
 
+// Each edit has nine fields: the index, row and column of its start, old end
+// and new end.
+const REWRITE_EDIT_FIELD_COUNT = 9;
+
+Query.prototype.rewrite = function(tree, templates, {parser} = {}) {
+  const [text, editData, editTexts] = _rewrite.call(
+    this,
+    tree,
+    templates,
+    retainedSource(tree, 'Rewriting'),
+    this._rewritePredicates
+  );
+
+  // The edits are listed from the last one to the first, so that they can be
+  // applied to the tree in order without adjusting their positions.
+  const edits = [];
+  for (let i = editTexts.length - 1; i >= 0; i--) {
+    const j = i * REWRITE_EDIT_FIELD_COUNT;
+    edits.push({
+      startIndex: editData[j],
+      oldEndIndex: editData[j + 3],
+      newEndIndex: editData[j + 6],
+      startPosition: {row: editData[j + 1], column: editData[j + 2]},
+      oldEndPosition: {row: editData[j + 4], column: editData[j + 5]},
+      newEndPosition: {row: editData[j + 7], column: editData[j + 8]},
+      newText: editTexts[i]
+    });
+  }
+
+  const result = {text, edits};
+  if (parser) {
+    for (const edit of edits) tree.edit(edit);
+    result.tree = parser.parse(text, tree);
+  }
+  return result;
+}
+
+/*
+ * Metrics
+ */
+
+function metrics({format} = {}) {
+  const [counters, methodCalls] = binding.getMetrics();
+
+  if (format === 'prometheus') {
+    const lines = [];
+    for (const [name, type, help, value] of counters) {
+      const metricName = `tree_sitter_${name}${type === 'counter' ? '_total' : ''}`;
+      lines.push(`# HELP ${metricName} ${help}`, `# TYPE ${metricName} ${type}`, `${metricName} ${value}`);
+    }
+    lines.push(
+      '# HELP tree_sitter_native_calls_total Calls to native methods.',
+      '# TYPE tree_sitter_native_calls_total counter'
+    );
+    for (const [method, count] of methodCalls) {
+      lines.push(`tree_sitter_native_calls_total{method="${method}"} ${count}`);
+    }
+    return lines.join('\n') + '\n';
+  } else if (format !== undefined) {
+    throw new TypeError(`Unknown metrics format ${format}`);
+  }
+
+  const result = {};
+  for (const [name, , , value] of counters) {
+    result[name.replace(/_(\w)/g, (_, letter) => letter.toUpperCase())] = value;
+  }
+  result.nativeCalls = {};
+  for (const [method, count] of methodCalls) {
+    result.nativeCalls[method] = count;
+  }
+  return result;
+}
+
+Parser.metrics = metrics;
+
+/*
+ * Tracing
+ */
+
+const TRACE_CATEGORIES = {
+  parse: 1 << 0,
+  incremental_parse: 1 << 1,
+  query: 1 << 2,
+  marshal: 1 << 3
+};
+const DEFAULT_TRACE_CATEGORIES = ['parse', 'incremental_parse', 'query'];
+const DEFAULT_TRACE_EVENT_CAPACITY = 100000;
+
+function startTracing({categories = DEFAULT_TRACE_CATEGORIES, capacity = DEFAULT_TRACE_EVENT_CAPACITY} = {}) {
+  let categoryMask = 0;
+  for (const category of categories) {
+    const bit = TRACE_CATEGORIES[category.replace(/^tree-sitter\./, '')];
+    if (bit === undefined) throw new TypeError(`Unknown tracing category ${category}`);
+    categoryMask |= bit;
+  }
+  binding.startTracing(categoryMask, capacity);
+}
+
+// The result can be written to a file as JSON and opened in Perfetto or
+// chrome://tracing, or its events can be appended to the `traceEvents` of a
+// trace that Node wrote.
+function stopTracing() {
+  const [traceEvents, droppedCount] = binding.stopTracing();
+  return {traceEvents, droppedCount};
+}
+
+Parser.startTracing = startTracing;
+Parser.stopTracing = stopTracing;
+
+/*
+ * Slow log
+ */
+
+const DEFAULT_SLOW_LOG_CAPACITY = 100;
+
+// Thresholds are in milliseconds. A threshold of `null` disables logging for
+// that kind of operation.
+function setSlowLog(options) {
+  if (options === false) {
+    binding.setSlowLog(-1, -1, 0);
+    return;
+  }
+  const {parseThreshold = 100, queryThreshold = 100, capacity = DEFAULT_SLOW_LOG_CAPACITY} = options || {};
+  binding.setSlowLog(
+    parseThreshold == null ? -1 : parseThreshold,
+    queryThreshold == null ? -1 : queryThreshold,
+    capacity
+  );
+}
+
+function drainSlowLog() {
+  const [entries, droppedCount] = binding.drainSlowLog();
+  return {entries, droppedCount};
+}
+
+Parser.setSlowLog = setSlowLog;
+Parser.drainSlowLog = drainSlowLog;
+
 /*
  * Other functions
  */
@@ -610,6 +1079,33 @@ function getTextFromTextBuffer ({startPosition, endPosition}) {
   return this.input.getTextInRange({start: startPosition, end: endPosition});
 }
 
+// The input is always read as UTF-16, so when a tree reports positions in
+// another encoding, its text is retrieved using the node's UTF-16 range.
+function getTextInUTF16Range (getText) {
+  return function (node) {
+    if (node instanceof TreeCursor) node = node.currentNode;
+    marshalNode(node);
+    return getText.call(this, NodeMethods.utf16Range(this));
+  }
+}
+
+const POSITION_ENCODINGS = {
+  utf8: 8,
+  utf16: 16,
+  utf32: 32,
+};
+
+function normalizePositionEncoding (positionEncoding, oldTree) {
+  if (positionEncoding == null) {
+    return (oldTree && oldTree.positionEncoding) || 'utf16';
+  }
+  const result = String(positionEncoding).toLowerCase().replace('-', '');
+  if (!POSITION_ENCODINGS.hasOwnProperty(result)) {
+    throw new TypeError(`Unknown position encoding '${positionEncoding}'`);
+  }
+  return result;
+}
+
 const {pointTransferArray} = binding;
 
 const NODE_FIELD_COUNT = 6;
@@ -632,7 +1128,7 @@ function unmarshalNode(value, tree, offset = 0, cache = null) {
   const nodeTypeId = value;
   const NodeClass = nodeTypeId === ERROR_TYPE_ID
     ? SyntaxNode
-    : tree.language.nodeSubclasses[nodeTypeId];
+    : getNodeSubclass(tree.language, nodeTypeId);
 
   const {nodeTransferArray} = binding;
   const id = getID(nodeTransferArray, offset)
@@ -690,56 +1186,86 @@ function pointToString(point) {
 }
 
 function initializeLanguageNodeClasses(language) {
-  const nodeTypeNamesById = binding.getNodeTypeNamesById(language);
-  const nodeFieldNamesById = binding.getNodeFieldNamesById(language);
-  const nodeTypeInfo = language.nodeTypeInfo || [];
-
-  const nodeSubclasses = [];
-  for (let id = 0, n = nodeTypeNamesById.length; id < n; id++) {
-    nodeSubclasses[id] = SyntaxNode;
-
-    const typeName = nodeTypeNamesById[id];
-    if (!typeName) continue;
-
-    const typeInfo = nodeTypeInfo.find(info => info.named && info.type === typeName);
-    if (!typeInfo) continue;
-
-    const fieldNames = [];
-    let classBody = '\n';
-    if (typeInfo.fields) {
-      for (const fieldName in typeInfo.fields) {
-        const fieldId = nodeFieldNamesById.indexOf(fieldName);
-        if (fieldId === -1) continue;
-        if (typeInfo.fields[fieldName].multiple) {
-          const getterName = camelCase(fieldName) + 'Nodes';
-          fieldNames.push(getterName);
-          classBody += `
-            get ${getterName}() {
-              marshalNode(this);
-              return unmarshalNodes(NodeMethods.childNodesForFieldId(this.tree, ${fieldId}), this.tree);
-            }
-          `.replace(/\s+/g, ' ') + '\n';
-        } else {
-          const getterName = camelCase(fieldName, false) + 'Node';
-          fieldNames.push(getterName);
-          classBody += `
-            get ${getterName}() {
-              marshalNode(this);
-              return unmarshalNode(NodeMethods.childNodeForFieldId(this.tree, ${fieldId}), this.tree);
-            }
-          `.replace(/\s+/g, ' ') + '\n';
-        }
+  const [nodeTypeNames, nodeFieldNames] = binding.getLanguageTables(language);
+  language.nodeTypeNamesById = nodeTypeNames.split('\0').map(name => name || null);
+  language.nodeFieldNamesById = nodeFieldNames.split('\0').map(name => name || null);
+
+  // Subclasses are generated the first time that a node of each type is
+  // unmarshalled, because most grammars have far more node types than any
+  // one document uses.
+  language.nodeSubclasses = new Array(language.nodeTypeNamesById.length);
+  registerLanguageSupertypes(language);
+}
+
+// Register the grammar's supertypes natively, so that type filters like
+// `descendantsOfType` can match a supertype's subtypes.
+function registerLanguageSupertypes(language) {
+  const supertypes = [];
+  for (const info of language.nodeTypeInfo || []) {
+    if (info.subtypes) {
+      const declaration = [info.type];
+      for (const subtype of info.subtypes) declaration.push(subtype.type, subtype.named);
+      supertypes.push(declaration);
+    }
+  }
+  if (supertypes.length > 0) binding.setLanguageSupertypes(language, supertypes);
+}
+
+function getNodeSubclass(language, id) {
+  return language.nodeSubclasses[id] || (
+    language.nodeSubclasses[id] = createNodeSubclass(language, id)
+  );
+}
+
+function createNodeSubclass(language, id) {
+  const typeName = language.nodeTypeNamesById[id];
+  if (!typeName) return SyntaxNode;
+
+  if (!language.nodeTypeInfoByName) {
+    language.nodeTypeInfoByName = new Map();
+    for (const info of language.nodeTypeInfo || []) {
+      if (info.named && !language.nodeTypeInfoByName.has(info.type)) {
+        language.nodeTypeInfoByName.set(info.type, info);
       }
     }
+  }
 
-    const className = camelCase(typeName, true) + 'Node';
-    const nodeSubclass = eval(`class ${className} extends SyntaxNode {${classBody}}; ${className}`);
-    nodeSubclass.prototype.type = typeName;
-    nodeSubclass.prototype.fields = Object.freeze(fieldNames.sort())
-    nodeSubclasses[id] = nodeSubclass;
+  const typeInfo = language.nodeTypeInfoByName.get(typeName);
+  if (!typeInfo) return SyntaxNode;
+
+  const fieldNames = [];
+  let classBody = '\n';
+  if (typeInfo.fields) {
+    for (const fieldName in typeInfo.fields) {
+      const fieldId = language.nodeFieldNamesById.indexOf(fieldName);
+      if (fieldId === -1) continue;
+      if (typeInfo.fields[fieldName].multiple) {
+        const getterName = camelCase(fieldName) + 'Nodes';
+        fieldNames.push(getterName);
+        classBody += `
+          get ${getterName}() {
+            marshalNode(this);
+            return unmarshalNodes(NodeMethods.childNodesForFieldId(this.tree, ${fieldId}), this.tree);
+          }
+        `.replace(/\s+/g, ' ') + '\n';
+      } else {
+        const getterName = camelCase(fieldName, false) + 'Node';
+        fieldNames.push(getterName);
+        classBody += `
+          get ${getterName}() {
+            marshalNode(this);
+            return unmarshalNode(NodeMethods.childNodeForFieldId(this.tree, ${fieldId}), this.tree);
+          }
+        `.replace(/\s+/g, ' ') + '\n';
+      }
+    }
   }
 
-  language.nodeSubclasses = nodeSubclasses
+  const className = camelCase(typeName, true) + 'Node';
+  const nodeSubclass = eval(`class ${className} extends SyntaxNode {${classBody}}; ${className}`);
+  nodeSubclass.prototype.type = typeName;
+  nodeSubclass.prototype.fields = Object.freeze(fieldNames.sort())
+  return nodeSubclass;
 }
 
 function camelCase(name, upperCase) {
@@ -749,7 +1275,11 @@ function camelCase(name, upperCase) {
 }
 
 module.exports = Parser;
+module.exports.Language = Language;
+module.exports.MarkerLayer = MarkerLayer;
+module.exports.ParseTrace = ParseTrace;
 module.exports.Query = Query;
+module.exports.RangeIndex = RangeIndex;
 module.exports.Tree = Tree;
 module.exports.SyntaxNode = SyntaxNode;
 module.exports.TreeCursor = TreeCursor;
@@ -1,9 +1,14 @@
 #include <node.h>
 #include <v8.h>
 #include "./language.h"
+#include "./marker_layer.h"
+#include "./metrics.h"
 #include "./node.h"
 #include "./parser.h"
 #include "./query.h"
+#include "./range_index.h"
+#include "./slow_log.h"
+#include "./trace_events.h"
 #include "./tree.h"
 #include "./tree_cursor.h"
 #include "./conversions.h"
@@ -16,8 +21,13 @@ void InitAll(Local<Object> exports) {
   InitConversions(exports);
   node_methods::Init(exports);
   language_methods::Init(exports);
+  MarkerLayer::Init(exports);
+  metrics::Init(exports);
   Parser::Init(exports);
   Query::Init(exports);
+  RangeIndex::Init(exports);
+  slow_log::Init(exports);
+  trace_events::Init(exports);
   Tree::Init(exports);
   TreeCursor::Init(exports);
 }
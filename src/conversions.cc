@@ -32,21 +32,37 @@ void InitConversions(Local<Object> exports) {
   Nan::Set(exports, Nan::New("pointTransferArray").ToLocalChecked(), Uint32Array::New(js_point_transfer_buffer, 0, 2));
 }
 
-void TransferPoint(const TSPoint &point) {
+// Columns are converted using the byte offset of the point, so that the
+// position index doesn't need to be consulted for the start of the row.
+static inline uint32_t column_to_js(const TSPoint &point, uint32_t byte, const PositionIndex *index) {
+  uint32_t column = point.column / BYTES_PER_CHARACTER;
+  if (!index) return column;
+  uint32_t offset = byte / BYTES_PER_CHARACTER;
+  return index->FromUTF16(offset) - index->FromUTF16(offset - column);
+}
+
+void TransferPoint(const TSPoint &point, uint32_t byte, const PositionIndex *index) {
   point_transfer_buffer[0] = point.row;
-  point_transfer_buffer[1] = point.column / 2;
+  point_transfer_buffer[1] = column_to_js(point, byte, index);
+}
+
+static Local<Object> PointToJS(const TSPoint &point, uint32_t byte, const PositionIndex *index) {
+  Local<Object> result = Nan::New<Object>();
+  Nan::Set(result, Nan::New(row_key), Nan::New<Number>(point.row));
+  Nan::Set(result, Nan::New(column_key), Nan::New<Number>(column_to_js(point, byte, index)));
+  return result;
 }
 
-Local<Object> RangeToJS(const TSRange &range) {
+Local<Object> RangeToJS(const TSRange &range, const PositionIndex *index) {
   Local<Object> result = Nan::New<Object>();
-  Nan::Set(result, Nan::New(start_position_key), PointToJS(range.start_point));
-  Nan::Set(result, Nan::New(start_index_key), ByteCountToJS(range.start_byte));
-  Nan::Set(result, Nan::New(end_position_key), PointToJS(range.end_point));
-  Nan::Set(result, Nan::New(end_index_key), ByteCountToJS(range.end_byte));
+  Nan::Set(result, Nan::New(start_position_key), PointToJS(range.start_point, range.start_byte, index));
+  Nan::Set(result, Nan::New(start_index_key), ByteCountToJS(range.start_byte, index));
+  Nan::Set(result, Nan::New(end_position_key), PointToJS(range.end_point, range.end_byte, index));
+  Nan::Set(result, Nan::New(end_index_key), ByteCountToJS(range.end_byte, index));
   return result;
 }
 
-Nan::Maybe<TSRange> RangeFromJS(const Local<Value> &arg) {
+Nan::Maybe<TSRange> RangeFromJS(const Local<Value> &arg, const PositionIndex *index) {
   if (!arg->IsObject()) {
     Nan::ThrowTypeError("Range must be a {startPosition, endPosition, startIndex, endIndex} object");
     return Nan::Nothing<TSRange>();
@@ -62,7 +78,7 @@ Nan::Maybe<TSRange> RangeFromJS(const Local<Value> &arg) {
       Nan::ThrowTypeError("Range must be a {startPosition, endPosition, startIndex, endIndex} object"); \
       return Nan::Nothing<TSRange>(); \
     } \
-    auto field = Convert(value.ToLocalChecked()); \
+    auto field = Convert(value.ToLocalChecked(), index); \
     if (field.IsJust()) { \
       result.field = field.FromJust(); \
     } else { \
@@ -87,7 +103,7 @@ Local<Object> PointToJS(const TSPoint &point) {
   return result;
 }
 
-Nan::Maybe<TSPoint> PointFromJS(const Local<Value> &arg) {
+Nan::Maybe<TSPoint> PointFromJS(const Local<Value> &arg, const PositionIndex *index) {
   Local<Object> js_point;
   if (!arg->IsObject() || !Nan::To<Object>(arg).ToLocal(&js_point)) {
     Nan::ThrowTypeError("Point must be a {row, column} object");
@@ -116,31 +132,64 @@ Nan::Maybe<TSPoint> PointFromJS(const Local<Value> &arg) {
     return Nan::Nothing<TSPoint>();
   }
 
-  uint32_t column;
   if (!std::isfinite(Nan::To<double>(js_column).FromMaybe(0))) {
-    column = UINT32_MAX;
-  } else if (js_column->IsNumber()) {
-    column = Nan::To<uint32_t>(js_column).FromMaybe(0) * BYTES_PER_CHARACTER;
-  } else {
+    return Nan::Just<TSPoint>({row, UINT32_MAX});
+  } else if (!js_column->IsNumber()) {
     Nan::ThrowTypeError("Point.column must be a number");
     return Nan::Nothing<TSPoint>();
   }
 
-  return Nan::Just<TSPoint>({row, column});
+  uint32_t column = Nan::To<uint32_t>(js_column).FromMaybe(0);
+  return Nan::Just<TSPoint>(PointFromRowAndColumn(row, column, index));
+}
+
+TSPoint PointFromRowAndColumn(uint32_t row, uint32_t column, const PositionIndex *index) {
+  if (!index || row == UINT32_MAX) return {row, column * BYTES_PER_CHARACTER};
+  uint32_t line_start = index->LineStart(row);
+  uint32_t offset = index->ToUTF16(index->FromUTF16(line_start) + column);
+  return {row, (offset - line_start) * BYTES_PER_CHARACTER};
 }
 
-Local<Number> ByteCountToJS(uint32_t byte_count) {
-  return Nan::New<Number>(byte_count / BYTES_PER_CHARACTER);
+uint32_t ByteCountToIndex(uint32_t byte_count, const PositionIndex *index) {
+  uint32_t offset = byte_count / BYTES_PER_CHARACTER;
+  if (index) offset = index->FromUTF16(offset);
+  return offset;
 }
 
-Nan::Maybe<uint32_t> ByteCountFromJS(const v8::Local<v8::Value> &arg) {
+uint32_t IndexToByteCount(uint32_t offset, const PositionIndex *index) {
+  if (index) offset = index->ToUTF16(offset);
+  return offset * BYTES_PER_CHARACTER;
+}
+
+Local<Number> ByteCountToJS(uint32_t byte_count, const PositionIndex *index) {
+  return Nan::New<Number>(ByteCountToIndex(byte_count, index));
+}
+
+Nan::Maybe<uint32_t> ByteCountFromJS(const v8::Local<v8::Value> &arg, const PositionIndex *index) {
   auto result = Nan::To<uint32_t>(arg);
   if (!arg->IsNumber()) {
     Nan::ThrowTypeError("Character index must be a number");
     return Nan::Nothing<uint32_t>();
   }
 
-  return Nan::Just<uint32_t>(result.FromJust() * BYTES_PER_CHARACTER);
+  return Nan::Just<uint32_t>(IndexToByteCount(result.FromJust(), index));
+}
+
+std::vector<uint16_t> UTF16FromJS(const Local<String> &js_string) {
+  std::vector<uint16_t> result(js_string->Length());
+  js_string->Write(
+
+    // Nan doesn't wrap this functionality
+    #if NODE_MAJOR_VERSION >= 12
+      Isolate::GetCurrent(),
+    #endif
+
+    result.data(),
+    0,
+    result.size(),
+    String::NO_NULL_TERMINATION
+  );
+  return result;
 }
 
 }  // namespace node_tree_sitter
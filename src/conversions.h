@@ -3,18 +3,24 @@
 
 #include <nan.h>
 #include <v8.h>
+#include <vector>
 #include <tree_sitter/api.h>
+#include "./position_index.h"
 
 namespace node_tree_sitter {
 
 void InitConversions(v8::Local<v8::Object> exports);
-v8::Local<v8::Object> RangeToJS(const TSRange &);
+v8::Local<v8::Object> RangeToJS(const TSRange &, const PositionIndex * = nullptr);
 v8::Local<v8::Object> PointToJS(const TSPoint &);
-void TransferPoint(const TSPoint &);
-v8::Local<v8::Number> ByteCountToJS(uint32_t);
-Nan::Maybe<TSPoint> PointFromJS(const v8::Local<v8::Value> &);
-Nan::Maybe<uint32_t> ByteCountFromJS(const v8::Local<v8::Value> &);
-Nan::Maybe<TSRange> RangeFromJS(const v8::Local<v8::Value> &);
+void TransferPoint(const TSPoint &, uint32_t byte = 0, const PositionIndex * = nullptr);
+v8::Local<v8::Number> ByteCountToJS(uint32_t, const PositionIndex * = nullptr);
+Nan::Maybe<TSPoint> PointFromJS(const v8::Local<v8::Value> &, const PositionIndex * = nullptr);
+Nan::Maybe<uint32_t> ByteCountFromJS(const v8::Local<v8::Value> &, const PositionIndex * = nullptr);
+Nan::Maybe<TSRange> RangeFromJS(const v8::Local<v8::Value> &, const PositionIndex * = nullptr);
+uint32_t ByteCountToIndex(uint32_t, const PositionIndex * = nullptr);
+uint32_t IndexToByteCount(uint32_t, const PositionIndex * = nullptr);
+TSPoint PointFromRowAndColumn(uint32_t, uint32_t, const PositionIndex * = nullptr);
+std::vector<uint16_t> UTF16FromJS(const v8::Local<v8::String> &);
 
 extern Nan::Persistent<v8::String> row_key;
 extern Nan::Persistent<v8::String> column_key;
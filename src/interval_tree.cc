@@ -0,0 +1,287 @@
+#include "./interval_tree.h"
+#include <algorithm>
+
+namespace node_tree_sitter {
+
+using std::vector;
+
+// Each node's own `start`, `end` and `max_end` are correct relative to its
+// ancestors, while `shift` still has to be applied to both of its subtrees.
+struct IntervalTree::Node {
+  uint32_t start;
+  uint32_t end;
+  uint32_t value;
+  uint32_t max_end;
+  uint32_t priority;
+  int64_t shift;
+  Node *left;
+  Node *right;
+  Node *parent;
+};
+
+typedef IntervalTree::Node Node;
+typedef IntervalTree::Entry Entry;
+
+static inline bool overlaps(uint64_t start, uint64_t end, uint64_t query_start, uint64_t query_end) {
+  if (start == end || query_start == query_end) {
+    return start <= query_end && end >= query_start;
+  }
+  return start < query_end && end > query_start;
+}
+
+static inline void apply_shift(Node *node, int64_t shift) {
+  if (!node) return;
+  node->start += shift;
+  node->end += shift;
+  node->max_end += shift;
+  node->shift += shift;
+}
+
+static inline void push_down(Node *node) {
+  if (node->shift) {
+    apply_shift(node->left, node->shift);
+    apply_shift(node->right, node->shift);
+    node->shift = 0;
+  }
+}
+
+static inline void update(Node *node) {
+  node->max_end = node->end;
+  if (node->left) {
+    node->left->parent = node;
+    if (node->left->max_end > node->max_end) node->max_end = node->left->max_end;
+  }
+  if (node->right) {
+    node->right->parent = node;
+    if (node->right->max_end > node->max_end) node->max_end = node->right->max_end;
+  }
+}
+
+// Split the tree into the nodes that start before `key` and the rest.
+static void split(Node *node, uint64_t key, Node **left, Node **right) {
+  if (!node) {
+    *left = *right = nullptr;
+    return;
+  }
+  push_down(node);
+  if (node->start < key) {
+    split(node->right, key, &node->right, right);
+    *left = node;
+  } else {
+    split(node->left, key, left, &node->left);
+    *right = node;
+  }
+  update(node);
+}
+
+static Node *merge(Node *left, Node *right) {
+  if (!left) return right;
+  if (!right) return left;
+  if (left->priority > right->priority) {
+    push_down(left);
+    left->right = merge(left->right, right);
+    update(left);
+    return left;
+  } else {
+    push_down(right);
+    right->left = merge(left, right->left);
+    update(right);
+    return right;
+  }
+}
+
+static inline Node *detach(Node *node) {
+  if (node) node->parent = nullptr;
+  return node;
+}
+
+static void delete_nodes(Node *node) {
+  if (!node) return;
+  delete_nodes(node->left);
+  delete_nodes(node->right);
+  delete node;
+}
+
+// Nodes that start at or before the edit keep their start, but their end may
+// lie inside or after the edited range. Only visit subtrees whose maximum end
+// says that they contain such a node.
+static void edit_ends(Node *node, uint32_t start, uint32_t old_end, uint32_t new_end) {
+  if (!node) return;
+  if (node->max_end < start || (node->max_end == start && start != old_end)) return;
+  push_down(node);
+  edit_ends(node->left, start, old_end, new_end);
+  edit_ends(node->right, start, old_end, new_end);
+  if (node->end >= old_end) {
+    node->end = node->end - old_end + new_end;
+  } else if (node->end > start) {
+    node->end = new_end;
+  }
+  update(node);
+}
+
+// Nodes that start inside the edited range are moved to its new end.
+static void edit_starts(Node *node, uint32_t old_end, uint32_t new_end) {
+  if (!node) return;
+  push_down(node);
+  edit_starts(node->left, old_end, new_end);
+  edit_starts(node->right, old_end, new_end);
+  node->start = new_end;
+  if (node->end >= old_end) {
+    node->end = node->end - old_end + new_end;
+  } else {
+    node->end = new_end;
+  }
+  update(node);
+}
+
+static inline Entry entry_for_node(const Node *node, int64_t shift) {
+  return Entry{
+    static_cast<uint32_t>(node->start + shift),
+    static_cast<uint32_t>(node->end + shift),
+    node->value
+  };
+}
+
+static void find_overlapping(const Node *node, int64_t shift, uint32_t start, uint32_t end,
+                             vector<const Node *> *nodes, vector<Entry> *entries) {
+  if (!node || node->max_end + shift < start) return;
+  find_overlapping(node->left, shift + node->shift, start, end, nodes, entries);
+  if (node->start + shift > end) return;
+  if (overlaps(node->start + shift, node->end + shift, start, end)) {
+    if (nodes) nodes->push_back(node);
+    if (entries) entries->push_back(entry_for_node(node, shift));
+  }
+  find_overlapping(node->right, shift + node->shift, start, end, nodes, entries);
+}
+
+static void find_containing(const Node *node, int64_t shift, uint32_t start, uint32_t end,
+                            vector<Entry> *entries) {
+  if (!node || node->max_end + shift < end) return;
+  find_containing(node->left, shift + node->shift, start, end, entries);
+  if (node->start + shift > start) return;
+  if (node->end + shift >= end) entries->push_back(entry_for_node(node, shift));
+  find_containing(node->right, shift + node->shift, start, end, entries);
+}
+
+static void find_contained_in(const Node *node, int64_t shift, uint32_t start, uint32_t end,
+                              vector<Entry> *entries) {
+  if (!node) return;
+  int64_t node_start = node->start + shift;
+  if (node_start >= start) {
+    find_contained_in(node->left, shift + node->shift, start, end, entries);
+  }
+  if (node_start > end) return;
+  if (node_start >= start && node->end + shift <= end) {
+    entries->push_back(entry_for_node(node, shift));
+  }
+  find_contained_in(node->right, shift + node->shift, start, end, entries);
+}
+
+static void get_all(const Node *node, int64_t shift, vector<Entry> *entries) {
+  if (!node) return;
+  get_all(node->left, shift + node->shift, entries);
+  entries->push_back(entry_for_node(node, shift));
+  get_all(node->right, shift + node->shift, entries);
+}
+
+IntervalTree::IntervalTree() : root_(nullptr), size_(0), seed_(0x9E3779B9) {}
+
+IntervalTree::~IntervalTree() {
+  delete_nodes(root_);
+}
+
+Node *IntervalTree::Insert(uint32_t start, uint32_t end, uint32_t value) {
+  if (end < start) end = start;
+
+  seed_ ^= seed_ << 13;
+  seed_ ^= seed_ >> 17;
+  seed_ ^= seed_ << 5;
+
+  Node *node = new Node{start, end, value, end, seed_, 0, nullptr, nullptr, nullptr};
+  Node *left, *right;
+  split(root_, static_cast<uint64_t>(start) + 1, &left, &right);
+  root_ = detach(merge(merge(detach(left), node), detach(right)));
+  size_++;
+  return node;
+}
+
+void IntervalTree::Remove(Node *node) {
+  vector<Node *> ancestors;
+  for (Node *ancestor = node->parent; ancestor; ancestor = ancestor->parent) {
+    ancestors.push_back(ancestor);
+  }
+  for (size_t i = ancestors.size(); i > 0; i--) push_down(ancestors[i - 1]);
+  push_down(node);
+
+  Node *parent = node->parent;
+  Node *child = merge(detach(node->left), detach(node->right));
+  if (child) child->parent = parent;
+  if (!parent) {
+    root_ = child;
+  } else if (parent->left == node) {
+    parent->left = child;
+  } else {
+    parent->right = child;
+  }
+  for (Node *ancestor = parent; ancestor; ancestor = ancestor->parent) update(ancestor);
+
+  delete node;
+  size_--;
+}
+
+Entry IntervalTree::Get(const Node *node) const {
+  int64_t shift = 0;
+  for (const Node *ancestor = node->parent; ancestor; ancestor = ancestor->parent) {
+    shift += ancestor->shift;
+  }
+  return entry_for_node(node, shift);
+}
+
+void IntervalTree::Clear() {
+  delete_nodes(root_);
+  root_ = nullptr;
+  size_ = 0;
+}
+
+// Positions after the edited range are shifted, and positions inside it are
+// moved to the end of the new text, matching `ts_node_edit`.
+void IntervalTree::Edit(uint32_t start, uint32_t old_end, uint32_t new_end) {
+  if (!root_) return;
+  if (old_end < start) old_end = start;
+  if (new_end < start) new_end = start;
+
+  Node *left, *middle, *right;
+  split(root_, old_end, &left, &right);
+  split(detach(left), static_cast<uint64_t>(start) + 1, &left, &middle);
+
+  edit_ends(detach(left), start, old_end, new_end);
+  edit_starts(detach(middle), old_end, new_end);
+  apply_shift(detach(right), static_cast<int64_t>(new_end) - static_cast<int64_t>(old_end));
+
+  root_ = detach(merge(merge(left, middle), right));
+}
+
+void IntervalTree::RemoveOverlapping(uint32_t start, uint32_t end, vector<Entry> *removed) {
+  vector<const Node *> nodes;
+  find_overlapping(root_, 0, start, end, &nodes, removed);
+  for (const Node *node : nodes) Remove(const_cast<Node *>(node));
+}
+
+void IntervalTree::FindOverlapping(uint32_t start, uint32_t end, vector<Entry> *entries) const {
+  find_overlapping(root_, 0, start, end, nullptr, entries);
+}
+
+void IntervalTree::FindContaining(uint32_t start, uint32_t end, vector<Entry> *entries) const {
+  find_containing(root_, 0, start, end, entries);
+}
+
+void IntervalTree::FindContainedIn(uint32_t start, uint32_t end, vector<Entry> *entries) const {
+  find_contained_in(root_, 0, start, end, entries);
+}
+
+void IntervalTree::GetAll(vector<Entry> *entries) const {
+  entries->reserve(entries->size() + size_);
+  get_all(root_, 0, entries);
+}
+
+}  // namespace node_tree_sitter
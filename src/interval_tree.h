@@ -0,0 +1,51 @@
+#ifndef NODE_TREE_SITTER_INTERVAL_TREE_H_
+#define NODE_TREE_SITTER_INTERVAL_TREE_H_
+
+#include <stdint.h>
+#include <vector>
+
+namespace node_tree_sitter {
+
+// A treap of intervals ordered by their start, where each node also stores
+// the largest end in its subtree. Edits shift whole subtrees lazily, so an
+// edit only touches the intervals that overlap the edited range plus
+// O(log n) others.
+class IntervalTree {
+ public:
+  struct Node;
+
+  struct Entry {
+    uint32_t start;
+    uint32_t end;
+    uint32_t value;
+  };
+
+  IntervalTree();
+  ~IntervalTree();
+
+  uint32_t size() const { return size_; }
+
+  Node *Insert(uint32_t start, uint32_t end, uint32_t value);
+  void Remove(Node *);
+  Entry Get(const Node *) const;
+  void Clear();
+  void Edit(uint32_t start, uint32_t old_end, uint32_t new_end);
+  void RemoveOverlapping(uint32_t start, uint32_t end, std::vector<Entry> *removed = nullptr);
+
+  void FindOverlapping(uint32_t start, uint32_t end, std::vector<Entry> *) const;
+  void FindContaining(uint32_t start, uint32_t end, std::vector<Entry> *) const;
+  void FindContainedIn(uint32_t start, uint32_t end, std::vector<Entry> *) const;
+  void GetAll(std::vector<Entry> *) const;
+
+ private:
+  IntervalTree(const IntervalTree &);
+  IntervalTree &operator=(const IntervalTree &);
+
+  Node *root_;
+  uint32_t size_;
+  uint32_t seed_;
+};
+
+}  // namespace node_tree_sitter
+
+#endif  // NODE_TREE_SITTER_INTERVAL_TREE_H_
@@ -1,9 +1,12 @@
 #include "./language.h"
 #include <nan.h>
 #include <tree_sitter/api.h>
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <v8.h>
+#include "./language_registry.h"
+#include "./util.h"
 
 namespace node_tree_sitter {
 namespace language_methods {
@@ -38,53 +41,138 @@ const TSLanguage *UnwrapLanguage(const v8::Local<v8::Value> &value) {
   return nullptr;
 }
 
-static void GetNodeTypeNamesById(const Nan::FunctionCallbackInfo<Value> &info) {
+// Return the names of all of the language's symbols and fields, each packed
+// into a single string separated by NUL characters. Symbols that aren't
+// visible as nodes have empty names.
+static void GetLanguageTables(const Nan::FunctionCallbackInfo<Value> &info) {
   const TSLanguage *language = UnwrapLanguage(info[0]);
   if (!language) return;
 
-  auto result = Nan::New<Array>();
-  uint32_t length = ts_language_symbol_count(language);
-  for (uint32_t i = 0; i < length; i++) {
-    const char *name = ts_language_symbol_name(language, i);
-    TSSymbolType type = ts_language_symbol_type(language, i);
-    if (type == TSSymbolTypeRegular) {
-      Nan::Set(result, i, Nan::New(name).ToLocalChecked());
-    } else {
-      Nan::Set(result, i, Nan::Null());
-    }
-  }
+  const language_registry::LanguageMetadata &metadata = language_registry::GetMetadata(language);
 
+  Local<Array> result = Nan::New<Array>(2);
+  Nan::Set(result, 0, Nan::New<String>(metadata.node_type_names.data(), metadata.node_type_names.size()).ToLocalChecked());
+  Nan::Set(result, 1, Nan::New<String>(metadata.node_field_names.data(), metadata.node_field_names.size()).ToLocalChecked());
   info.GetReturnValue().Set(result);
 }
 
-static void GetNodeFieldNamesById(const Nan::FunctionCallbackInfo<Value> &info) {
+static void GetLanguageMetadata(const Nan::FunctionCallbackInfo<Value> &info) {
   const TSLanguage *language = UnwrapLanguage(info[0]);
   if (!language) return;
 
-  auto result = Nan::New<Array>();
-  uint32_t length = ts_language_field_count(language);
-  for (uint32_t i = 0; i < length + 1; i++) {
-    const char *name = ts_language_field_name_for_id(language, i);
-    if (name) {
-      Nan::Set(result, i, Nan::New(name).ToLocalChecked());
-    } else {
-      Nan::Set(result, i, Nan::Null());
+  const language_registry::LanguageMetadata &metadata = language_registry::GetMetadata(language);
+  const language_registry::SupertypeInfo *supertypes = language_registry::GetSupertypes(language);
+
+  Local<Object> result = Nan::New<Object>();
+  Nan::Set(
+    result,
+    Nan::New("symbolFlags").ToLocalChecked(),
+    typed_array_from_vector<uint8_t, Uint8Array>(metadata.symbol_flags)
+  );
+  Nan::Set(
+    result,
+    Nan::New("supertypeSymbols").ToLocalChecked(),
+    typed_array_from_vector<TSSymbol, Uint16Array>(supertypes ? supertypes->supertypes : vector<TSSymbol>())
+  );
+  Nan::Set(
+    result,
+    Nan::New("subtypeSets").ToLocalChecked(),
+    typed_array_from_vector<uint32_t, Uint32Array>(supertypes ? supertypes->subtype_sets : vector<uint32_t>())
+  );
+  Nan::Set(
+    result,
+    Nan::New("wordsPerSymbolSet").ToLocalChecked(),
+    Nan::New<Number>((ts_language_symbol_count(language) + 31) / 32)
+  );
+  info.GetReturnValue().Set(result);
+}
+
+// Supertypes are declared in the grammar's node-types.json. Each element of
+// the argument is an array of a supertype's name, followed by the name and
+// named flag of each of its subtypes.
+static void SetLanguageSupertypes(const Nan::FunctionCallbackInfo<Value> &info) {
+  const TSLanguage *language = UnwrapLanguage(info[0]);
+  if (!language) return;
+
+  if (!info[1]->IsArray()) {
+    Nan::ThrowTypeError("Second argument must be an array of supertypes");
+    return;
+  }
+
+  vector<language_registry::SupertypeDeclaration> declarations;
+  Local<Array> js_declarations = Local<Array>::Cast(info[1]);
+  for (uint32_t i = 0, n = js_declarations->Length(); i < n; i++) {
+    Local<Value> js_declaration_value = Nan::Get(js_declarations, i).ToLocalChecked();
+    if (!js_declaration_value->IsArray()) {
+      Nan::ThrowTypeError("Second argument must be an array of supertypes");
+      return;
     }
+
+    Local<Array> js_declaration = Local<Array>::Cast(js_declaration_value);
+    language_registry::SupertypeDeclaration declaration;
+    declaration.name = *Nan::Utf8String(Nan::Get(js_declaration, 0).ToLocalChecked());
+    for (uint32_t j = 1, m = js_declaration->Length(); j + 1 < m; j += 2) {
+      declaration.subtypes.push_back({
+        *Nan::Utf8String(Nan::Get(js_declaration, j).ToLocalChecked()),
+        Nan::To<bool>(Nan::Get(js_declaration, j + 1).ToLocalChecked()).FromMaybe(false)
+      });
+    }
+    declarations.push_back(declaration);
+  }
+
+  language_registry::SetSupertypes(language, declarations);
+}
+
+static void LoadLanguage(const Nan::FunctionCallbackInfo<Value> &info) {
+  if (!info[0]->IsString() || !info[1]->IsString()) {
+    Nan::ThrowTypeError("Arguments must be a library path and a symbol name");
+    return;
+  }
+
+  Nan::Utf8String path(info[0]);
+  Nan::Utf8String symbol_name(info[1]);
+  std::string error;
+  const TSLanguage *language = language_registry::Load(*path, *symbol_name, &error);
+  if (!language) {
+    Nan::ThrowError(error.c_str());
+    return;
   }
+
+  Local<ObjectTemplate> language_template = Nan::New<ObjectTemplate>();
+  language_template->SetInternalFieldCount(1);
+  Local<Object> result = Nan::NewInstance(language_template).ToLocalChecked();
+  Nan::SetInternalFieldPointer(result, 0, const_cast<TSLanguage *>(language));
+
+  // Check the language's ABI version the same way as for languages passed
+  // to other methods, so that incompatible grammars fail here.
+  if (!UnwrapLanguage(result)) return;
+
   info.GetReturnValue().Set(result);
 }
 
 void Init(Local<Object> exports) {
   Nan::Set(
     exports,
-    Nan::New("getNodeTypeNamesById").ToLocalChecked(),
-    Nan::GetFunction(Nan::New<FunctionTemplate>(GetNodeTypeNamesById)).ToLocalChecked()
+    Nan::New("getLanguageTables").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(GetLanguageTables)).ToLocalChecked()
+  );
+
+  Nan::Set(
+    exports,
+    Nan::New("loadLanguage").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(LoadLanguage)).ToLocalChecked()
+  );
+
+  Nan::Set(
+    exports,
+    Nan::New("getLanguageMetadata").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(GetLanguageMetadata)).ToLocalChecked()
   );
 
   Nan::Set(
     exports,
-    Nan::New("getNodeFieldNamesById").ToLocalChecked(),
-    Nan::GetFunction(Nan::New<FunctionTemplate>(GetNodeFieldNamesById)).ToLocalChecked()
+    Nan::New("setLanguageSupertypes").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(SetLanguageSupertypes)).ToLocalChecked()
   );
 }
 
@@ -0,0 +1,226 @@
+#include "./language_registry.h"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace node_tree_sitter {
+namespace language_registry {
+
+using std::string;
+using std::unique_ptr;
+using std::unordered_map;
+using std::vector;
+
+typedef const TSLanguage *(*LanguageFunction)();
+
+#ifdef _WIN32
+typedef HMODULE Library;
+static void close_library(Library library) { FreeLibrary(library); }
+#else
+typedef void *Library;
+static void close_library(Library library) { dlclose(library); }
+#endif
+
+static std::mutex registry_mutex;
+static unordered_map<string, const TSLanguage *> languages_by_symbol;
+static unordered_map<const TSLanguage *, unique_ptr<LanguageMetadata>> metadata_by_language;
+static unordered_map<const TSLanguage *, unique_ptr<SupertypeInfo>> supertypes_by_language;
+static vector<unique_ptr<SupertypeInfo>> replaced_supertypes;
+
+// Libraries that define a language are never closed, because the language
+// can be referenced by trees and queries for the rest of the process's
+// lifetime.
+static const TSLanguage *load_language(const string &path, const string &symbol_name, string *error) {
+#ifdef _WIN32
+  Library library = LoadLibraryA(path.c_str());
+  if (!library) {
+    *error = "Could not load " + path + " (error " + std::to_string(GetLastError()) + ")";
+    return nullptr;
+  }
+  auto language_function = reinterpret_cast<LanguageFunction>(GetProcAddress(library, symbol_name.c_str()));
+#else
+  Library library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (!library) {
+    const char *message = dlerror();
+    *error = message ? message : "Could not load " + path;
+    return nullptr;
+  }
+  auto language_function = reinterpret_cast<LanguageFunction>(dlsym(library, symbol_name.c_str()));
+#endif
+
+  if (!language_function) {
+    *error = "Could not find symbol " + symbol_name + " in " + path;
+    close_library(library);
+    return nullptr;
+  }
+
+  const TSLanguage *language = language_function();
+  if (!language) {
+    *error = symbol_name + " in " + path + " returned a null language";
+    close_library(library);
+  }
+  return language;
+}
+
+const TSLanguage *Load(const string &path, const string &symbol_name, string *error) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+
+  string key = path + '\0' + symbol_name;
+  auto iter = languages_by_symbol.find(key);
+  if (iter != languages_by_symbol.end()) return iter->second;
+
+  const TSLanguage *language = load_language(path, symbol_name, error);
+  if (language) languages_by_symbol[key] = language;
+  return language;
+}
+
+static unique_ptr<LanguageMetadata> build_metadata(const TSLanguage *language) {
+  unique_ptr<LanguageMetadata> metadata(new LanguageMetadata());
+
+  uint32_t symbol_count = ts_language_symbol_count(language);
+  metadata->symbol_flags.resize(symbol_count);
+  for (uint32_t i = 0; i < symbol_count; i++) {
+    if (i > 0) metadata->node_type_names += '\0';
+    switch (ts_language_symbol_type(language, i)) {
+      // Hidden rules are reported as auxiliary symbols, so every regular
+      // symbol is a visible, named node type.
+      case TSSymbolTypeRegular:
+        metadata->node_type_names += ts_language_symbol_name(language, i);
+        metadata->symbol_flags[i] = SymbolFlagVisible | SymbolFlagNamed;
+        break;
+      case TSSymbolTypeAnonymous:
+        metadata->symbol_flags[i] = SymbolFlagVisible;
+        break;
+      default:
+        break;
+    }
+  }
+
+  uint32_t field_count = ts_language_field_count(language);
+  for (uint32_t i = 0; i < field_count + 1; i++) {
+    if (i > 0) metadata->node_field_names += '\0';
+    const char *name = ts_language_field_name_for_id(language, i);
+    if (name) metadata->node_field_names += name;
+  }
+
+  return metadata;
+}
+
+const LanguageMetadata &GetMetadata(const TSLanguage *language) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+
+  unique_ptr<LanguageMetadata> &metadata = metadata_by_language[language];
+  if (!metadata) metadata = build_metadata(language);
+  return *metadata;
+}
+
+const uint32_t *SupertypeInfo::SubtypesOf(TSSymbol symbol) const {
+  auto iter = std::lower_bound(supertypes.begin(), supertypes.end(), symbol);
+  if (iter == supertypes.end() || *iter != symbol) return nullptr;
+  return &subtype_sets[(iter - supertypes.begin()) * words_per_symbol_set];
+}
+
+static inline void add_to_set(uint32_t *set, TSSymbol symbol) {
+  set[symbol / 32] |= 1u << (symbol % 32);
+}
+
+static inline bool set_contains(const uint32_t *set, TSSymbol symbol) {
+  return set[symbol / 32] & (1u << (symbol % 32));
+}
+
+// The declarations come from the grammar's node-types.json, which refers to
+// node types by name, so each name is resolved to every symbol that has it.
+static unique_ptr<SupertypeInfo> build_supertypes(const TSLanguage *language,
+                                                  const vector<SupertypeDeclaration> &declarations) {
+  unique_ptr<SupertypeInfo> info(new SupertypeInfo());
+  uint32_t symbol_count = ts_language_symbol_count(language);
+  info->words_per_symbol_set = (symbol_count + 31) / 32;
+
+  vector<vector<TSSymbol>> subtypes_by_supertype;
+  for (const SupertypeDeclaration &declaration : declarations) {
+    vector<TSSymbol> subtypes;
+    for (TSSymbol i = 0; i < symbol_count; i++) {
+      TSSymbolType type = ts_language_symbol_type(language, i);
+      if (type == TSSymbolTypeAuxiliary) continue;
+      const char *name = ts_language_symbol_name(language, i);
+      for (const auto &subtype : declaration.subtypes) {
+        if (subtype.second == (type == TSSymbolTypeRegular) && subtype.first == name) {
+          subtypes.push_back(i);
+          break;
+        }
+      }
+    }
+
+    for (TSSymbol i = 0; i < symbol_count; i++) {
+      if (
+        ts_language_symbol_type(language, i) == TSSymbolTypeRegular &&
+        declaration.name == ts_language_symbol_name(language, i) &&
+        !std::binary_search(info->supertypes.begin(), info->supertypes.end(), i)
+      ) {
+        auto position = std::lower_bound(info->supertypes.begin(), info->supertypes.end(), i);
+        subtypes_by_supertype.insert(subtypes_by_supertype.begin() + (position - info->supertypes.begin()), subtypes);
+        info->supertypes.insert(position, i);
+      }
+    }
+  }
+
+  uint32_t words = info->words_per_symbol_set;
+  info->subtype_sets.resize(info->supertypes.size() * words);
+  for (size_t i = 0; i < info->supertypes.size(); i++) {
+    for (TSSymbol subtype : subtypes_by_supertype[i]) {
+      add_to_set(&info->subtype_sets[i * words], subtype);
+    }
+  }
+
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (size_t i = 0; i < info->supertypes.size(); i++) {
+      uint32_t *set = &info->subtype_sets[i * words];
+      for (size_t j = 0; j < info->supertypes.size(); j++) {
+        if (i == j || !set_contains(set, info->supertypes[j])) continue;
+        const uint32_t *subtypes = &info->subtype_sets[j * words];
+        for (uint32_t k = 0; k < words; k++) {
+          if (subtypes[k] & ~set[k]) {
+            set[k] |= subtypes[k];
+            changed = true;
+          }
+        }
+      }
+    }
+  }
+
+  return info;
+}
+
+const SupertypeInfo *GetSupertypes(const TSLanguage *language) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+
+  auto iter = supertypes_by_language.find(language);
+  if (iter == supertypes_by_language.end()) return nullptr;
+  return iter->second.get();
+}
+
+// A language's supertypes can only be set once, unless the earlier call
+// didn't declare any. Later calls return the existing information. Replaced
+// information is kept, because other threads may still be reading it.
+const SupertypeInfo *SetSupertypes(const TSLanguage *language,
+                                   const vector<SupertypeDeclaration> &declarations) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+
+  unique_ptr<SupertypeInfo> &info = supertypes_by_language[language];
+  if (info && info->supertypes.empty() && !declarations.empty()) {
+    replaced_supertypes.push_back(std::move(info));
+  }
+  if (!info) info = build_supertypes(language, declarations);
+  return info.get();
+}
+
+}  // namespace language_registry
+}  // namespace node_tree_sitter
@@ -0,0 +1,53 @@
+#ifndef NODE_TREE_SITTER_LANGUAGE_REGISTRY_H_
+#define NODE_TREE_SITTER_LANGUAGE_REGISTRY_H_
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <tree_sitter/api.h>
+
+namespace node_tree_sitter {
+namespace language_registry {
+
+// Languages and their metadata are shared by every isolate in the process,
+// so that each worker thread doesn't need to load grammars separately. Once
+// created, metadata is never modified or freed, so it can be read without
+// holding the registry's lock.
+
+enum SymbolFlag : uint8_t {
+  SymbolFlagVisible = 1,
+  SymbolFlagNamed = 2,
+};
+
+struct SupertypeInfo {
+  uint32_t words_per_symbol_set;
+  std::vector<TSSymbol> supertypes;
+
+  // One bitset of subtypes per supertype, including the subtypes of any
+  // supertypes that are themselves subtypes.
+  std::vector<uint32_t> subtype_sets;
+
+  const uint32_t *SubtypesOf(TSSymbol) const;
+};
+
+struct LanguageMetadata {
+  std::string node_type_names;
+  std::string node_field_names;
+  std::vector<uint8_t> symbol_flags;
+};
+
+struct SupertypeDeclaration {
+  std::string name;
+  std::vector<std::pair<std::string, bool>> subtypes;
+};
+
+const TSLanguage *Load(const std::string &path, const std::string &symbol_name, std::string *error);
+const LanguageMetadata &GetMetadata(const TSLanguage *);
+const SupertypeInfo *GetSupertypes(const TSLanguage *);
+const SupertypeInfo *SetSupertypes(const TSLanguage *, const std::vector<SupertypeDeclaration> &);
+
+}  // namespace language_registry
+}  // namespace node_tree_sitter
+
+#endif  // NODE_TREE_SITTER_LANGUAGE_REGISTRY_H_
@@ -1,4 +1,6 @@
 #include "./logger.h"
+#include <string.h>
+#include <algorithm>
 #include <string>
 #include <v8.h>
 #include <nan.h>
@@ -8,6 +10,7 @@ namespace node_tree_sitter {
 
 using namespace v8;
 using std::string;
+using std::vector;
 
 void Logger::Log(void *payload, TSLogType type, const char *message_str) {
   Logger *debugger = (Logger *)payload;
@@ -63,4 +66,139 @@ TSLogger Logger::Make(Local<Function> func) {
   return result;
 }
 
+LogBuffer::LogBuffer(uint32_t capacity, bool timestamps) :
+  ring_(capacity < MinCapacity ? MinCapacity : capacity),
+  head_(0),
+  size_(0),
+  dropped_count_(0),
+  drained_string_count_(0),
+  timestamps_(timestamps),
+  last_record_time_(std::chrono::steady_clock::now()) {
+  // Strings that don't fit in the table are recorded as the empty string.
+  Intern("", 0);
+}
+
+TSLogger LogBuffer::Make() {
+  TSLogger result;
+  result.payload = (void *)this;
+  result.log = Log;
+  return result;
+}
+
+static bool parse_integer(const char *string, size_t length, uint32_t *result) {
+  size_t i = 0;
+  bool negative = false;
+  if (length > 0 && string[0] == '-') {
+    negative = true;
+    i++;
+  }
+  if (i == length || length - i > 9) return false;
+
+  int32_t value = 0;
+  for (; i < length; i++) {
+    if (string[i] < '0' || string[i] > '9') return false;
+    value = value * 10 + (string[i] - '0');
+  }
+  *result = static_cast<uint32_t>(negative ? -value : value);
+  return true;
+}
+
+// Messages have the same format as those parsed by `Logger::Log`: a name,
+// followed by a space and a comma-separated list of `key:value` parameters.
+void LogBuffer::Log(void *payload, TSLogType type, const char *message) {
+  LogBuffer *buffer = (LogBuffer *)payload;
+  uint32_t record[2 + 2 * MaxParamCount];
+  uint32_t param_count = 0;
+
+  const char *name_end = strchr(message, ' ');
+  if (!name_end) name_end = message + strlen(message);
+
+  std::lock_guard<std::mutex> lock(buffer->mutex_);
+
+  uint32_t header_length = 1;
+  if (buffer->timestamps_) {
+    auto now = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - buffer->last_record_time_).count();
+    record[header_length++] = elapsed > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(elapsed);
+    buffer->last_record_time_ = now;
+  }
+
+  uint32_t name_id = buffer->Intern(message, name_end - message);
+  const char *key = *name_end ? name_end + 1 : nullptr;
+  while (key && param_count < MaxParamCount) {
+    const char *value_sep = strchr(key, ':');
+    if (!value_sep) break;
+
+    const char *value = value_sep + 1;
+    const char *value_end = strstr(value, ", ");
+    const char *next_key = value_end ? value_end + 2 : nullptr;
+    if (!value_end) value_end = value + strlen(value);
+
+    uint32_t *entry = &record[header_length + 2 * param_count];
+    if (parse_integer(value, value_end - value, &entry[1])) {
+      entry[0] = buffer->Intern(key, value_sep - key);
+    } else {
+      entry[0] = buffer->Intern(key, value_sep - key) | StringValueFlag;
+      entry[1] = buffer->Intern(value, value_end - value);
+    }
+
+    param_count++;
+    key = next_key;
+  }
+
+  record[0] = name_id | (param_count << 16) | ((type == TSLogTypeLex ? 1u : 0u) << 24);
+  if (buffer->timestamps_) record[0] |= TimestampFlag;
+  buffer->Push(record, header_length + 2 * param_count);
+}
+
+uint32_t LogBuffer::Intern(const char *chars, size_t length) {
+  string key(chars, length);
+  auto iter = string_ids_.find(key);
+  if (iter != string_ids_.end()) return iter->second;
+  if (strings_.size() == MaxStringCount) return 0;
+
+  uint32_t id = strings_.size();
+  string_ids_.emplace(key, id);
+  strings_.push_back(std::move(key));
+  return id;
+}
+
+static inline uint32_t record_length(uint32_t header) {
+  return (header & LogBuffer::TimestampFlag ? 2 : 1) + 2 * ((header >> 16) & 0xff);
+}
+
+void LogBuffer::Push(const uint32_t *record, uint32_t length) {
+  uint32_t capacity = ring_.size();
+  while (size_ + length > capacity) {
+    uint32_t oldest_length = record_length(ring_[head_]);
+    head_ = (head_ + oldest_length) % capacity;
+    size_ -= oldest_length;
+    dropped_count_++;
+  }
+
+  uint32_t position = (head_ + size_) % capacity;
+  for (uint32_t i = 0; i < length; i++) {
+    ring_[position] = record[i];
+    if (++position == capacity) position = 0;
+  }
+  size_ += length;
+}
+
+void LogBuffer::Drain(vector<uint32_t> *records, vector<string> *new_strings, uint32_t *dropped_count) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  uint32_t capacity = ring_.size();
+  uint32_t first_length = std::min(size_, capacity - head_);
+  records->assign(ring_.begin() + head_, ring_.begin() + head_ + first_length);
+  records->insert(records->end(), ring_.begin(), ring_.begin() + (size_ - first_length));
+  head_ = 0;
+  size_ = 0;
+
+  new_strings->assign(strings_.begin() + drained_string_count_, strings_.end());
+  drained_string_count_ = strings_.size();
+
+  *dropped_count = dropped_count_;
+  dropped_count_ = 0;
+}
+
 }  // namespace node_tree_sitter
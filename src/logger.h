@@ -3,6 +3,11 @@
 
 #include <v8.h>
 #include <nan.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <tree_sitter/api.h>
 
 namespace node_tree_sitter {
@@ -14,6 +19,46 @@ class Logger {
   static void Log(void *, TSLogType, const char *);
 };
 
+// A logger that stores each message as a compact binary record in a bounded
+// ring buffer, so that it can be used from any thread and the messages can
+// be read after the parse. When the buffer is full, the oldest records are
+// dropped.
+//
+// Each record is a header word, containing the message's name, parameter
+// count and type, followed by a pair of words for each parameter: the
+// parameter's name and its value. Names and non-numeric values are stored
+// as indices into a table of strings. If timestamps are enabled, the header
+// is followed by the number of nanoseconds since the previous record.
+class LogBuffer {
+ public:
+  static const uint32_t MinCapacity = 64;
+  static const uint32_t MaxParamCount = 15;
+  static const uint32_t MaxStringCount = 4096;
+  static const uint32_t StringValueFlag = 1u << 16;
+  static const uint32_t TimestampFlag = 1u << 25;
+
+  LogBuffer(uint32_t capacity, bool timestamps);
+  TSLogger Make();
+  static void Log(void *, TSLogType, const char *);
+
+  void Drain(std::vector<uint32_t> *records, std::vector<std::string> *new_strings, uint32_t *dropped_count);
+
+ private:
+  uint32_t Intern(const char *, size_t);
+  void Push(const uint32_t *, uint32_t);
+
+  std::mutex mutex_;
+  std::vector<uint32_t> ring_;
+  uint32_t head_;
+  uint32_t size_;
+  uint32_t dropped_count_;
+  std::vector<std::string> strings_;
+  std::unordered_map<std::string, uint32_t> string_ids_;
+  uint32_t drained_string_count_;
+  bool timestamps_;
+  std::chrono::steady_clock::time_point last_record_time_;
+};
+
 
 }  // namespace node_tree_sitter
 
@@ -0,0 +1,236 @@
+#include "./marker_layer.h"
+#include <vector>
+#include <v8.h>
+#include <nan.h>
+#include "./conversions.h"
+#include "./metrics.h"
+#include "./util.h"
+
+namespace node_tree_sitter {
+
+using std::vector;
+using namespace v8;
+
+Nan::Persistent<Function> MarkerLayer::constructor;
+
+void MarkerLayer::Init(Local<Object> exports) {
+  Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
+  tpl->InstanceTemplate()->SetInternalFieldCount(1);
+  Local<String> class_name = Nan::New("MarkerLayer").ToLocalChecked();
+  tpl->SetClassName(class_name);
+
+  FunctionPair methods[] = {
+    {"markRange", MarkRange},
+    {"markRanges", MarkRanges},
+    {"getRange", GetRange},
+    {"getRanges", GetRanges},
+    {"_findOverlapping", FindOverlapping},
+    {"_findContaining", FindContaining},
+    {"remove", Remove},
+    {"clear", Clear},
+    {"_setTree", SetTree},
+    {"_size", Size},
+  };
+
+  metrics::SetPrototypeMethods(tpl, "MarkerLayer", methods, length_of_array(methods));
+
+  Local<Function> ctor = Nan::GetFunction(tpl).ToLocalChecked();
+
+  constructor.Reset(ctor);
+  Nan::Set(exports, class_name, ctor);
+}
+
+MarkerLayer::MarkerLayer(const Tree *tree) : tree_(tree), next_id_(1) {
+  tree_->AddEditObserver(this);
+}
+
+MarkerLayer::~MarkerLayer() {
+  if (tree_) tree_->RemoveEditObserver(this);
+}
+
+void MarkerLayer::TreeEdited(const TSInputEdit &edit) {
+  intervals_.Edit(edit.start_byte, edit.old_end_byte, edit.new_end_byte);
+}
+
+void MarkerLayer::TreeDeleted() {
+  tree_ = nullptr;
+}
+
+uint32_t MarkerLayer::Mark(uint32_t start_byte, uint32_t end_byte) {
+  uint32_t id = next_id_++;
+  markers_[id] = intervals_.Insert(start_byte, end_byte, id);
+  return id;
+}
+
+// Markers are returned as flat arrays of (id, startIndex, endIndex) triples,
+// ordered by their start.
+Local<Value> MarkerLayer::EntriesToJS(const vector<IntervalTree::Entry> &entries) const {
+  const PositionIndex *index = position_index();
+  Local<ArrayBuffer> buffer = ArrayBuffer::New(Isolate::GetCurrent(), 3 * entries.size() * sizeof(uint32_t));
+  Local<Uint32Array> result = Uint32Array::New(buffer, 0, 3 * entries.size());
+  Nan::TypedArrayContents<uint32_t> contents(result);
+  uint32_t *p = *contents;
+  for (const IntervalTree::Entry &entry : entries) {
+    *(p++) = entry.value;
+    *(p++) = ByteCountToIndex(entry.start, index);
+    *(p++) = ByteCountToIndex(entry.end, index);
+  }
+  return result;
+}
+
+#define unwrap_marker_layer(layer)                                   \
+  MarkerLayer *layer = ObjectWrap::Unwrap<MarkerLayer>(info.This()); \
+  if (!layer->tree_) {                                               \
+    Nan::ThrowError("The marker layer's tree has been deleted");     \
+    return;                                                          \
+  }
+
+void MarkerLayer::New(const Nan::FunctionCallbackInfo<Value> &info) {
+  if (!info.IsConstructCall()) {
+    Nan::ThrowError("MarkerLayer must be called with `new`");
+    return;
+  }
+
+  const Tree *tree = Tree::UnwrapTree(info[0]);
+  if (!tree) {
+    Nan::ThrowTypeError("First argument must be a tree");
+    return;
+  }
+
+  (new MarkerLayer(tree))->Wrap(info.This());
+  info.GetReturnValue().Set(info.This());
+}
+
+void MarkerLayer::MarkRange(const Nan::FunctionCallbackInfo<Value> &info) {
+  unwrap_marker_layer(layer);
+
+  auto maybe_start = ByteCountFromJS(info[0], layer->position_index());
+  if (maybe_start.IsNothing()) return;
+  auto maybe_end = ByteCountFromJS(info[1], layer->position_index());
+  if (maybe_end.IsNothing()) return;
+
+  info.GetReturnValue().Set(Nan::New(layer->Mark(maybe_start.FromJust(), maybe_end.FromJust())));
+}
+
+void MarkerLayer::MarkRanges(const Nan::FunctionCallbackInfo<Value> &info) {
+  unwrap_marker_layer(layer);
+
+  if (!info[0]->IsUint32Array()) {
+    Nan::ThrowTypeError("Ranges must be a Uint32Array of start and end indices");
+    return;
+  }
+
+  Nan::TypedArrayContents<uint32_t> ranges(info[0]);
+  if (ranges.length() % 2 != 0) {
+    Nan::ThrowTypeError("Ranges must have an end index for each start index");
+    return;
+  }
+
+  uint32_t count = ranges.length() / 2;
+  const PositionIndex *index = layer->position_index();
+
+  Local<ArrayBuffer> buffer = ArrayBuffer::New(Isolate::GetCurrent(), count * sizeof(uint32_t));
+  Local<Uint32Array> result = Uint32Array::New(buffer, 0, count);
+  Nan::TypedArrayContents<uint32_t> ids(result);
+  for (uint32_t i = 0; i < count; i++) {
+    (*ids)[i] = layer->Mark(
+      IndexToByteCount((*ranges)[2 * i], index),
+      IndexToByteCount((*ranges)[2 * i + 1], index)
+    );
+  }
+
+  info.GetReturnValue().Set(result);
+}
+
+void MarkerLayer::GetRange(const Nan::FunctionCallbackInfo<Value> &info) {
+  unwrap_marker_layer(layer);
+
+  auto maybe_id = Nan::To<uint32_t>(info[0]);
+  if (maybe_id.IsNothing()) {
+    Nan::ThrowTypeError("Marker id must be an integer");
+    return;
+  }
+
+  auto iter = layer->markers_.find(maybe_id.FromJust());
+  if (iter == layer->markers_.end()) return;
+
+  IntervalTree::Entry entry = layer->intervals_.Get(iter->second);
+  Local<Object> result = Nan::New<Object>();
+  Nan::Set(result, Nan::New("startIndex").ToLocalChecked(), ByteCountToJS(entry.start, layer->position_index()));
+  Nan::Set(result, Nan::New("endIndex").ToLocalChecked(), ByteCountToJS(entry.end, layer->position_index()));
+  info.GetReturnValue().Set(result);
+}
+
+void MarkerLayer::GetRanges(const Nan::FunctionCallbackInfo<Value> &info) {
+  unwrap_marker_layer(layer);
+
+  vector<IntervalTree::Entry> entries;
+  layer->intervals_.GetAll(&entries);
+  info.GetReturnValue().Set(layer->EntriesToJS(entries));
+}
+
+#define define_find_method(name, find)                                      \
+  void MarkerLayer::name(const Nan::FunctionCallbackInfo<Value> &info) {    \
+    unwrap_marker_layer(layer);                                             \
+                                                                            \
+    auto maybe_start = ByteCountFromJS(info[0], layer->position_index());   \
+    if (maybe_start.IsNothing()) return;                                    \
+    auto maybe_end = ByteCountFromJS(info[1], layer->position_index());     \
+    if (maybe_end.IsNothing()) return;                                      \
+                                                                            \
+    vector<IntervalTree::Entry> entries;                                    \
+    layer->intervals_.find(                                                 \
+      maybe_start.FromJust(), maybe_end.FromJust(), &entries                \
+    );                                                                      \
+    info.GetReturnValue().Set(layer->EntriesToJS(entries));                 \
+  }
+
+define_find_method(FindOverlapping, FindOverlapping)
+define_find_method(FindContaining, FindContaining)
+
+void MarkerLayer::Remove(const Nan::FunctionCallbackInfo<Value> &info) {
+  MarkerLayer *layer = ObjectWrap::Unwrap<MarkerLayer>(info.This());
+
+  auto maybe_id = Nan::To<uint32_t>(info[0]);
+  if (maybe_id.IsNothing()) {
+    Nan::ThrowTypeError("Marker id must be an integer");
+    return;
+  }
+
+  auto iter = layer->markers_.find(maybe_id.FromJust());
+  if (iter == layer->markers_.end()) {
+    info.GetReturnValue().Set(Nan::False());
+    return;
+  }
+
+  layer->intervals_.Remove(iter->second);
+  layer->markers_.erase(iter);
+  info.GetReturnValue().Set(Nan::True());
+}
+
+void MarkerLayer::Clear(const Nan::FunctionCallbackInfo<Value> &info) {
+  MarkerLayer *layer = ObjectWrap::Unwrap<MarkerLayer>(info.This());
+  layer->intervals_.Clear();
+  layer->markers_.clear();
+}
+
+void MarkerLayer::SetTree(const Nan::FunctionCallbackInfo<Value> &info) {
+  MarkerLayer *layer = ObjectWrap::Unwrap<MarkerLayer>(info.This());
+  const Tree *tree = Tree::UnwrapTree(info[0]);
+  if (!tree) {
+    Nan::ThrowTypeError("First argument must be a tree");
+    return;
+  }
+
+  if (tree == layer->tree_) return;
+  if (layer->tree_) layer->tree_->RemoveEditObserver(layer);
+  layer->tree_ = tree;
+  tree->AddEditObserver(layer);
+}
+
+void MarkerLayer::Size(const Nan::FunctionCallbackInfo<Value> &info) {
+  MarkerLayer *layer = ObjectWrap::Unwrap<MarkerLayer>(info.This());
+  info.GetReturnValue().Set(Nan::New(layer->intervals_.size()));
+}
+
+}  // namespace node_tree_sitter
@@ -0,0 +1,55 @@
+#ifndef NODE_TREE_SITTER_MARKER_LAYER_H_
+#define NODE_TREE_SITTER_MARKER_LAYER_H_
+
+#include <v8.h>
+#include <nan.h>
+#include <node_object_wrap.h>
+#include <unordered_map>
+#include <vector>
+#include <tree_sitter/api.h>
+#include "./interval_tree.h"
+#include "./tree.h"
+
+namespace node_tree_sitter {
+
+// A set of ranges attached to a tree, which are moved by the tree's edits
+// the same way that its nodes are. The ranges are stored in an interval
+// tree, so an edit costs O(log n) rather than O(n) in the number of markers.
+class MarkerLayer : public Nan::ObjectWrap, public TreeEditObserver {
+ public:
+  static void Init(v8::Local<v8::Object> exports);
+
+  void TreeEdited(const TSInputEdit &) override;
+  void TreeDeleted() override;
+
+ private:
+  explicit MarkerLayer(const Tree *);
+  ~MarkerLayer();
+
+  const PositionIndex *position_index() const { return tree_->position_index(); }
+  uint32_t Mark(uint32_t, uint32_t);
+  v8::Local<v8::Value> EntriesToJS(const std::vector<IntervalTree::Entry> &) const;
+
+  static void New(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void MarkRange(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void MarkRanges(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void GetRange(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void GetRanges(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void FindOverlapping(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void FindContaining(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void Remove(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void Clear(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void SetTree(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void Size(const Nan::FunctionCallbackInfo<v8::Value> &);
+
+  const Tree *tree_;
+  IntervalTree intervals_;
+  std::unordered_map<uint32_t, IntervalTree::Node *> markers_;
+  uint32_t next_id_;
+
+  static Nan::Persistent<v8::Function> constructor;
+};
+
+}  // namespace node_tree_sitter
+
+#endif  // NODE_TREE_SITTER_MARKER_LAYER_H_
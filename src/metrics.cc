@@ -0,0 +1,136 @@
+#include "./metrics.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <v8.h>
+#include <nan.h>
+
+namespace node_tree_sitter {
+namespace metrics {
+
+using std::string;
+using std::unique_ptr;
+using namespace v8;
+
+std::atomic<uint64_t> counters[CounterCount];
+
+struct CounterInfo {
+  const char *name;
+  const char *type;
+  const char *help;
+};
+
+static const CounterInfo counter_info[CounterCount] = {
+  {"nodes_marshalled", "counter", "Nodes returned from native methods to JS."},
+  {"node_cache_hits", "counter", "Marshalled nodes that were found in their tree's node cache."},
+  {"node_cache_misses", "counter", "Marshalled nodes that were written to the transfer buffer."},
+  {"transfer_buffer_growths", "counter", "Times that the node transfer buffer was reallocated."},
+  {"transfer_buffer_bytes", "gauge", "Size of the node transfer buffer."},
+  {"cached_node_updates", "counter", "Cached nodes whose positions were updated by tree edits."},
+  {"nodes_cached", "counter", "JS nodes that were added to their tree's node cache."},
+  {"nodes_finalized", "counter", "Cached JS nodes that were garbage collected."},
+  {"trees_created", "counter", "Trees that were wrapped in JS objects."},
+  {"trees_deleted", "counter", "Trees that were freed after their JS objects were garbage collected."},
+  {"query_matches", "counter", "Query matches produced by the runtime, before predicates are applied."},
+  {"query_captures", "counter", "Query captures produced by the runtime, before predicates are applied."},
+  {"query_matches_dropped", "counter", "Query matches and captures that were rejected by predicates."},
+  {"parses", "counter", "Parses that produced a tree."},
+  {"parse_bytes", "counter", "UTF-16 bytes of text in the trees produced by parses."},
+  {"parse_time_nanoseconds", "counter", "Time spent in the runtime's parse function."},
+};
+
+struct CountedMethod {
+  string name;
+  Nan::FunctionCallback callback;
+  std::atomic<uint64_t> call_count;
+};
+
+// Each method is registered once, by the first isolate that defines it, and
+// later isolates share its counter. Methods are never unregistered, so that
+// their counts survive the isolates of worker threads.
+static std::mutex methods_mutex;
+static std::map<string, unique_ptr<CountedMethod>> counted_methods;
+
+static void call_counted_method(const Nan::FunctionCallbackInfo<Value> &info) {
+  CountedMethod *method = static_cast<CountedMethod *>(info.Data().As<External>()->Value());
+  method->call_count.fetch_add(1, std::memory_order_relaxed);
+  method->callback(info);
+}
+
+static Local<Value> register_method(const char *class_name, const FunctionPair &method) {
+  string name = string(class_name) + "." + method.name;
+
+  std::lock_guard<std::mutex> lock(methods_mutex);
+  unique_ptr<CountedMethod> &counted_method = counted_methods[name];
+  if (!counted_method) {
+    counted_method.reset(new CountedMethod());
+    counted_method->name = name;
+    counted_method->callback = method.callback;
+    counted_method->call_count = 0;
+  }
+  return Nan::New<External>(counted_method.get());
+}
+
+void SetPrototypeMethods(Local<FunctionTemplate> tpl, const char *class_name,
+                         const FunctionPair *methods, size_t method_count) {
+  for (size_t i = 0; i < method_count; i++) {
+    Nan::SetPrototypeMethod(tpl, methods[i].name, call_counted_method, register_method(class_name, methods[i]));
+  }
+}
+
+Local<Function> NewFunction(const char *class_name, const FunctionPair &method) {
+  Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(call_counted_method, register_method(class_name, method));
+  return Nan::GetFunction(tpl).ToLocalChecked();
+}
+
+// Counters are returned as (name, type, help, value) rows, and method calls
+// as (name, count) pairs, over all of the isolates that use each method.
+static void GetMetrics(const Nan::FunctionCallbackInfo<Value> &info) {
+  Local<Array> js_counters = Nan::New<Array>(CounterCount);
+  for (unsigned i = 0; i < CounterCount; i++) {
+    Local<Array> row = Nan::New<Array>(4);
+    Nan::Set(row, 0, Nan::New(counter_info[i].name).ToLocalChecked());
+    Nan::Set(row, 1, Nan::New(counter_info[i].type).ToLocalChecked());
+    Nan::Set(row, 2, Nan::New(counter_info[i].help).ToLocalChecked());
+    Nan::Set(row, 3, Nan::New<Number>(static_cast<double>(counters[i].load(std::memory_order_relaxed))));
+    Nan::Set(js_counters, i, row);
+  }
+
+  std::lock_guard<std::mutex> lock(methods_mutex);
+  Local<Array> js_methods = Nan::New<Array>(counted_methods.size());
+  unsigned index = 0;
+  for (const auto &entry : counted_methods) {
+    Local<Array> pair = Nan::New<Array>(2);
+    Nan::Set(pair, 0, Nan::New(entry.first).ToLocalChecked());
+    Nan::Set(pair, 1, Nan::New<Number>(static_cast<double>(entry.second->call_count.load(std::memory_order_relaxed))));
+    Nan::Set(js_methods, index++, pair);
+  }
+
+  Local<Array> result = Nan::New<Array>(2);
+  Nan::Set(result, 0, js_counters);
+  Nan::Set(result, 1, js_methods);
+  info.GetReturnValue().Set(result);
+}
+
+// Query predicates are applied in JS, so the matches that they reject are
+// counted once per call to `matches` or `captures`.
+static void AddDroppedQueryMatches(const Nan::FunctionCallbackInfo<Value> &info) {
+  Add(QueryMatchesDropped, Nan::To<uint32_t>(info[0]).FromMaybe(0));
+}
+
+void Init(Local<Object> exports) {
+  Nan::Set(
+    exports,
+    Nan::New("getMetrics").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(GetMetrics)).ToLocalChecked()
+  );
+  Nan::Set(
+    exports,
+    Nan::New("addDroppedQueryMatches").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(AddDroppedQueryMatches)).ToLocalChecked()
+  );
+}
+
+}  // namespace metrics
+}  // namespace node_tree_sitter
@@ -0,0 +1,57 @@
+#ifndef NODE_TREE_SITTER_METRICS_H_
+#define NODE_TREE_SITTER_METRICS_H_
+
+#include <v8.h>
+#include <nan.h>
+#include <atomic>
+#include <stdint.h>
+#include "./util.h"
+
+namespace node_tree_sitter {
+namespace metrics {
+
+// Process-wide counters of the binding's own work. They are updated with
+// relaxed atomic operations, so they are cheap enough to always be enabled,
+// and are shared by every worker thread.
+enum Counter {
+  NodesMarshalled,
+  NodeCacheHits,
+  NodeCacheMisses,
+  TransferBufferGrowths,
+  TransferBufferBytes,
+  CachedNodeUpdates,
+  NodesCached,
+  NodesFinalized,
+  TreesCreated,
+  TreesDeleted,
+  QueryMatches,
+  QueryCaptures,
+  QueryMatchesDropped,
+  Parses,
+  ParseBytes,
+  ParseTime,
+  CounterCount,
+};
+
+extern std::atomic<uint64_t> counters[CounterCount];
+
+inline void Add(Counter counter, uint64_t amount = 1) {
+  counters[counter].fetch_add(amount, std::memory_order_relaxed);
+}
+
+inline void Set(Counter counter, uint64_t value) {
+  counters[counter].store(value, std::memory_order_relaxed);
+}
+
+// Native methods that are registered through these functions count their
+// calls, by class and method name.
+void SetPrototypeMethods(v8::Local<v8::FunctionTemplate>, const char *class_name,
+                         const FunctionPair *methods, size_t method_count);
+v8::Local<v8::Function> NewFunction(const char *class_name, const FunctionPair &method);
+
+void Init(v8::Local<v8::Object> exports);
+
+}  // namespace metrics
+}  // namespace node_tree_sitter
+
+#endif  // NODE_TREE_SITTER_METRICS_H_
@@ -1,10 +1,15 @@
 #include "./node.h"
 #include <nan.h>
 #include <tree_sitter/api.h>
+#include <algorithm>
 #include <vector>
 #include <v8.h>
 #include "./util.h"
 #include "./conversions.h"
+#include "./language_registry.h"
+#include "./metrics.h"
+#include "./probes.h"
+#include "./trace_events.h"
 #include "./tree.h"
 #include "./tree_cursor.h"
 
@@ -21,6 +26,10 @@ static uint32_t transfer_buffer_length = 0;
 static Nan::Persistent<Object> module_exports;
 static TSTreeCursor scratch_cursor = {nullptr, nullptr, {0, 0}};
 
+// Nodes with at least this many children have their children indexed by
+// the tree on first access, rather than being searched linearly.
+static const uint32_t WIDE_NODE_CHILD_COUNT = 64;
+
 static inline void setup_transfer_buffer(uint32_t node_count) {
   uint32_t new_length = node_count * FIELD_COUNT_PER_NODE;
   if (new_length > transfer_buffer_length) {
@@ -29,6 +38,8 @@ static inline void setup_transfer_buffer(uint32_t node_count) {
     }
     transfer_buffer_length = new_length;
     transfer_buffer = static_cast<uint32_t *>(malloc(transfer_buffer_length * sizeof(uint32_t)));
+    metrics::Add(metrics::TransferBufferGrowths);
+    metrics::Set(metrics::TransferBufferBytes, transfer_buffer_length * sizeof(uint32_t));
     auto js_transfer_buffer = ArrayBuffer::New(Isolate::GetCurrent(), transfer_buffer, transfer_buffer_length * sizeof(uint32_t));
     Nan::Set(
       Nan::New(module_exports),
@@ -55,9 +66,11 @@ void MarshalNode(const Nan::FunctionCallbackInfo<Value> &info, const Tree *tree,
 
 Local<Value> GetMarshalNodes(const Nan::FunctionCallbackInfo<Value> &info,
                          const Tree *tree, const TSNode *nodes, uint32_t node_count) {
+  trace_events::Span span(trace_events::CategoryMarshal, "marshalNodes");
   auto result = Nan::New<Array>();
   setup_transfer_buffer(node_count);
   uint32_t *p = transfer_buffer;
+  uint32_t cache_hit_count = 0;
   for (unsigned i = 0; i < node_count; i++) {
     TSNode node = nodes[i];
     const auto &cache_entry = tree->cached_nodes_.find(node.id);
@@ -75,14 +88,26 @@ Local<Value> GetMarshalNodes(const Nan::FunctionCallbackInfo<Value> &info,
       }
     } else {
       Nan::Set(result, i, Nan::New(cache_entry->second->node));
+      cache_hit_count++;
     }
   }
+
+  metrics::Add(metrics::NodesMarshalled, node_count);
+  metrics::Add(metrics::NodeCacheHits, cache_hit_count);
+  metrics::Add(metrics::NodeCacheMisses, node_count - cache_hit_count);
+  PROBE_MARSHAL(node_count, cache_hit_count, transfer_buffer_length * sizeof(uint32_t));
+  if (span.enabled()) {
+    span.AddArg("nodeCount", node_count);
+    span.AddArg("cacheHits", cache_hit_count);
+  }
   return result;
 }
 
 Local<Value> GetMarshalNode(const Nan::FunctionCallbackInfo<Value> &info, const Tree *tree, TSNode node) {
   const auto &cache_entry = tree->cached_nodes_.find(node.id);
+  metrics::Add(metrics::NodesMarshalled);
   if (cache_entry == tree->cached_nodes_.end()) {
+    metrics::Add(metrics::NodeCacheMisses);
     setup_transfer_buffer(1);
     uint32_t *p = transfer_buffer;
     MarshalNodeId(node.id, p);
@@ -95,6 +120,7 @@ Local<Value> GetMarshalNode(const Nan::FunctionCallbackInfo<Value> &info, const
       return Nan::New(ts_node_symbol(node));
     }
   } else {
+    metrics::Add(metrics::NodeCacheHits);
     return Nan::New(cache_entry->second->node);
   }
   return Nan::Null();
@@ -161,7 +187,7 @@ static void FirstNamedChildForIndex(const Nan::FunctionCallbackInfo<Value> &info
   const Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   if (node.id) {
-    Nan::Maybe<uint32_t> byte = ByteCountFromJS(info[1]);
+    Nan::Maybe<uint32_t> byte = ByteCountFromJS(info[1], tree->position_index());
     if (byte.IsJust()) {
       MarshalNode(info, tree, ts_node_first_named_child_for_byte(node, byte.FromJust()));
       return;
@@ -175,7 +201,7 @@ static void FirstChildForIndex(const Nan::FunctionCallbackInfo<Value> &info) {
   TSNode node = UnmarshalNode(tree);
 
   if (node.id && info.Length() > 1) {
-    Nan::Maybe<uint32_t> byte = ByteCountFromJS(info[1]);
+    Nan::Maybe<uint32_t> byte = ByteCountFromJS(info[1], tree->position_index());
     if (byte.IsJust()) {
       MarshalNode(info, tree, ts_node_first_child_for_byte(node, byte.FromJust()));
       return;
@@ -189,8 +215,8 @@ static void NamedDescendantForIndex(const Nan::FunctionCallbackInfo<Value> &info
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
-    Nan::Maybe<uint32_t> maybe_min = ByteCountFromJS(info[1]);
-    Nan::Maybe<uint32_t> maybe_max = ByteCountFromJS(info[2]);
+    Nan::Maybe<uint32_t> maybe_min = ByteCountFromJS(info[1], tree->position_index());
+    Nan::Maybe<uint32_t> maybe_max = ByteCountFromJS(info[2], tree->position_index());
     if (maybe_min.IsJust() && maybe_max.IsJust()) {
       uint32_t min = maybe_min.FromJust();
       uint32_t max = maybe_max.FromJust();
@@ -206,8 +232,8 @@ static void DescendantForIndex(const Nan::FunctionCallbackInfo<Value> &info) {
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
-    Nan::Maybe<uint32_t> maybe_min = ByteCountFromJS(info[1]);
-    Nan::Maybe<uint32_t> maybe_max = ByteCountFromJS(info[2]);
+    Nan::Maybe<uint32_t> maybe_min = ByteCountFromJS(info[1], tree->position_index());
+    Nan::Maybe<uint32_t> maybe_max = ByteCountFromJS(info[2], tree->position_index());
     if (maybe_min.IsJust() && maybe_max.IsJust()) {
       uint32_t min = maybe_min.FromJust();
       uint32_t max = maybe_max.FromJust();
@@ -223,8 +249,8 @@ static void NamedDescendantForPosition(const Nan::FunctionCallbackInfo<Value> &i
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
-    Nan::Maybe<TSPoint> maybe_min = PointFromJS(info[1]);
-    Nan::Maybe<TSPoint> maybe_max = PointFromJS(info[2]);
+    Nan::Maybe<TSPoint> maybe_min = PointFromJS(info[1], tree->position_index());
+    Nan::Maybe<TSPoint> maybe_max = PointFromJS(info[2], tree->position_index());
     if (maybe_min.IsJust() && maybe_max.IsJust()) {
       TSPoint min = maybe_min.FromJust();
       TSPoint max = maybe_max.FromJust();
@@ -240,8 +266,8 @@ static void DescendantForPosition(const Nan::FunctionCallbackInfo<Value> &info)
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
-    Nan::Maybe<TSPoint> maybe_min = PointFromJS(info[1]);
-    Nan::Maybe<TSPoint> maybe_max = PointFromJS(info[2]);
+    Nan::Maybe<TSPoint> maybe_min = PointFromJS(info[1], tree->position_index());
+    Nan::Maybe<TSPoint> maybe_max = PointFromJS(info[2], tree->position_index());
     if (maybe_min.IsJust() && maybe_max.IsJust()) {
       TSPoint min = maybe_min.FromJust();
       TSPoint max = maybe_max.FromJust();
@@ -287,8 +313,7 @@ static void StartIndex(const Nan::FunctionCallbackInfo<Value> &info) {
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
-    int32_t result = ts_node_start_byte(node) / 2;
-    info.GetReturnValue().Set(Nan::New<Integer>(result));
+    info.GetReturnValue().Set(ByteCountToJS(ts_node_start_byte(node), tree->position_index()));
   }
 }
 
@@ -297,8 +322,7 @@ static void EndIndex(const Nan::FunctionCallbackInfo<Value> &info) {
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
-    int32_t result = ts_node_end_byte(node) / 2;
-    info.GetReturnValue().Set(Nan::New<Integer>(result));
+    info.GetReturnValue().Set(ByteCountToJS(ts_node_end_byte(node), tree->position_index()));
   }
 }
 
@@ -307,7 +331,7 @@ static void StartPosition(const Nan::FunctionCallbackInfo<Value> &info) {
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
-    TransferPoint(ts_node_start_point(node));
+    TransferPoint(ts_node_start_point(node), ts_node_start_byte(node), tree->position_index());
   }
 }
 
@@ -316,7 +340,7 @@ static void EndPosition(const Nan::FunctionCallbackInfo<Value> &info) {
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
-    TransferPoint(ts_node_end_point(node));
+    TransferPoint(ts_node_end_point(node), ts_node_end_byte(node), tree->position_index());
   }
 }
 
@@ -330,8 +354,16 @@ static void Child(const Nan::FunctionCallbackInfo<Value> &info) {
       return;
     }
     uint32_t index = Nan::To<uint32_t>(info[1]).FromJust();
-    MarshalNode(info, tree, ts_node_child(node, index));
-    return;
+    if (ts_node_child_count(node) >= WIDE_NODE_CHILD_COUNT) {
+      const Tree::ChildIndex &child_index = tree->GetChildIndex(node);
+      if (index < child_index.children.size()) {
+        MarshalNode(info, tree, child_index.children[index]);
+        return;
+      }
+    } else {
+      MarshalNode(info, tree, ts_node_child(node, index));
+      return;
+    }
   }
   MarshalNullNode();
 }
@@ -346,8 +378,16 @@ static void NamedChild(const Nan::FunctionCallbackInfo<Value> &info) {
       return;
     }
     uint32_t index = Nan::To<uint32_t>(info[1]).FromJust();
-    MarshalNode(info, tree, ts_node_named_child(node, index));
-    return;
+    if (ts_node_named_child_count(node) >= WIDE_NODE_CHILD_COUNT) {
+      const Tree::ChildIndex &child_index = tree->GetChildIndex(node);
+      if (index < child_index.named_child_indices.size()) {
+        MarshalNode(info, tree, child_index.children[child_index.named_child_indices[index]]);
+        return;
+      }
+    } else {
+      MarshalNode(info, tree, ts_node_named_child(node, index));
+      return;
+    }
   }
   MarshalNullNode();
 }
@@ -466,12 +506,6 @@ static void PreviousNamedSibling(const Nan::FunctionCallbackInfo<Value> &info) {
   MarshalNullNode();
 }
 
-struct SymbolSet {
-  std::basic_string<TSSymbol> symbols;
-  void add(TSSymbol symbol) { symbols += symbol; }
-  bool contains(TSSymbol symbol) { return symbols.find(symbol) != symbols.npos; }
-};
-
 bool symbol_set_from_js(SymbolSet *symbols, const Local<Value> &value, const TSLanguage *language) {
   if (!value->IsArray()) {
     Nan::ThrowTypeError("Argument must be a string or array of strings");
@@ -479,6 +513,7 @@ bool symbol_set_from_js(SymbolSet *symbols, const Local<Value> &value, const TSL
   }
 
   unsigned symbol_count = ts_language_symbol_count(language);
+  const language_registry::SupertypeInfo *supertypes = language_registry::GetSupertypes(language);
 
   Local<Array> js_types = Local<Array>::Cast(value);
   for (unsigned i = 0, n = js_types->Length(); i < n; i++) {
@@ -509,6 +544,10 @@ bool symbol_set_from_js(SymbolSet *symbols, const Local<Value> &value, const TSL
           for (TSSymbol j = 0; j < symbol_count; j++) {
             if (node_type == ts_language_symbol_name(language, j)) {
               symbols->add(j);
+
+              // Supertypes never appear in trees, so match their subtypes.
+              const uint32_t *subtypes = supertypes ? supertypes->SubtypesOf(j) : nullptr;
+              if (subtypes) symbols->add_all(subtypes, supertypes->words_per_symbol_set);
             }
           }
         }
@@ -560,6 +599,86 @@ static void NamedChildren(const Nan::FunctionCallbackInfo<Value> &info) {
   MarshalNodes(info, tree, result.data(), result.size());
 }
 
+static bool slice_bounds_from_js(const Nan::FunctionCallbackInfo<Value> &info, uint32_t *start, uint32_t *count) {
+  if (!info[1]->IsUint32()) {
+    Nan::ThrowTypeError("Second argument must be an integer");
+    return false;
+  }
+  *start = Nan::To<uint32_t>(info[1]).FromJust();
+  *count = UINT32_MAX;
+  if (info.Length() > 2 && !info[2]->IsUndefined()) {
+    if (!info[2]->IsUint32()) {
+      Nan::ThrowTypeError("Third argument must be an integer");
+      return false;
+    }
+    *count = Nan::To<uint32_t>(info[2]).FromJust();
+  }
+  return true;
+}
+
+static void ChildrenSlice(const Nan::FunctionCallbackInfo<Value> &info) {
+  const Tree *tree = Tree::UnwrapTree(info[0]);
+  TSNode node = UnmarshalNode(tree);
+  if (!node.id) return;
+
+  uint32_t start, count;
+  if (!slice_bounds_from_js(info, &start, &count)) return;
+
+  uint32_t child_count = ts_node_child_count(node);
+  if (start > child_count) start = child_count;
+  if (count > child_count - start) count = child_count - start;
+
+  if (child_count >= WIDE_NODE_CHILD_COUNT) {
+    const Tree::ChildIndex &child_index = tree->GetChildIndex(node);
+    MarshalNodes(info, tree, child_index.children.data() + start, count);
+    return;
+  }
+
+  vector<TSNode> result;
+  ts_tree_cursor_reset(&scratch_cursor, node);
+  if (count > 0 && ts_tree_cursor_goto_first_child(&scratch_cursor)) {
+    uint32_t i = 0;
+    do {
+      if (i++ >= start) result.push_back(ts_tree_cursor_current_node(&scratch_cursor));
+    } while (result.size() < count && ts_tree_cursor_goto_next_sibling(&scratch_cursor));
+  }
+
+  MarshalNodes(info, tree, result.data(), result.size());
+}
+
+static void NamedChildrenSlice(const Nan::FunctionCallbackInfo<Value> &info) {
+  const Tree *tree = Tree::UnwrapTree(info[0]);
+  TSNode node = UnmarshalNode(tree);
+  if (!node.id) return;
+
+  uint32_t start, count;
+  if (!slice_bounds_from_js(info, &start, &count)) return;
+
+  uint32_t child_count = ts_node_named_child_count(node);
+  if (start > child_count) start = child_count;
+  if (count > child_count - start) count = child_count - start;
+
+  vector<TSNode> result;
+  result.reserve(count);
+  if (child_count >= WIDE_NODE_CHILD_COUNT) {
+    const Tree::ChildIndex &child_index = tree->GetChildIndex(node);
+    for (uint32_t i = start; i < start + count; i++) {
+      result.push_back(child_index.children[child_index.named_child_indices[i]]);
+    }
+  } else {
+    ts_tree_cursor_reset(&scratch_cursor, node);
+    if (count > 0 && ts_tree_cursor_goto_first_child(&scratch_cursor)) {
+      uint32_t i = 0;
+      do {
+        TSNode child = ts_tree_cursor_current_node(&scratch_cursor);
+        if (ts_node_is_named(child) && i++ >= start) result.push_back(child);
+      } while (result.size() < count && ts_tree_cursor_goto_next_sibling(&scratch_cursor));
+    }
+  }
+
+  MarshalNodes(info, tree, result.data(), result.size());
+}
+
 static void DescendantsOfType(const Nan::FunctionCallbackInfo<Value> &info) {
   const Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
@@ -572,13 +691,13 @@ static void DescendantsOfType(const Nan::FunctionCallbackInfo<Value> &info) {
   TSPoint end_point = {UINT32_MAX, UINT32_MAX};
 
   if (info.Length() > 2 && info[2]->IsObject()) {
-    auto maybe_start_point = PointFromJS(info[2]);
+    auto maybe_start_point = PointFromJS(info[2], tree->position_index());
     if (maybe_start_point.IsNothing()) return;
     start_point = maybe_start_point.FromJust();
   }
 
   if (info.Length() > 3 && info[3]->IsObject()) {
-    auto maybe_end_point = PointFromJS(info[3]);
+    auto maybe_end_point = PointFromJS(info[3], tree->position_index());
     if (maybe_end_point.IsNothing()) return;
     end_point = maybe_end_point.FromJust();
   }
@@ -652,6 +771,35 @@ static void ChildNodesForFieldId(const Nan::FunctionCallbackInfo<Value> &info) {
   MarshalNodes(info, tree, result.data(), result.size());
 }
 
+static void FieldsAll(const Nan::FunctionCallbackInfo<Value> &info) {
+  const Tree *tree = Tree::UnwrapTree(info[0]);
+  TSNode node = UnmarshalNode(tree);
+  if (!node.id) return;
+
+  vector<TSNode> nodes;
+  vector<TSFieldId> field_ids;
+  ts_tree_cursor_reset(&scratch_cursor, node);
+  if (ts_tree_cursor_goto_first_child(&scratch_cursor)) {
+    do {
+      TSFieldId field_id = ts_tree_cursor_current_field_id(&scratch_cursor);
+      if (field_id) {
+        nodes.push_back(ts_tree_cursor_current_node(&scratch_cursor));
+        field_ids.push_back(field_id);
+      }
+    } while (ts_tree_cursor_goto_next_sibling(&scratch_cursor));
+  }
+
+  Local<ArrayBuffer> buffer = ArrayBuffer::New(Isolate::GetCurrent(), field_ids.size() * sizeof(TSFieldId));
+  Local<Uint16Array> js_field_ids = Uint16Array::New(buffer, 0, field_ids.size());
+  Nan::TypedArrayContents<uint16_t> contents(js_field_ids);
+  std::copy(field_ids.begin(), field_ids.end(), *contents);
+
+  Local<Array> result = Nan::New<Array>();
+  Nan::Set(result, 0, js_field_ids);
+  Nan::Set(result, 1, GetMarshalNodes(info, tree, nodes.data(), nodes.size()));
+  info.GetReturnValue().Set(result);
+}
+
 static void ChildNodeForFieldId(const Nan::FunctionCallbackInfo<Value> &info) {
   const Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
@@ -690,11 +838,26 @@ static void Closest(const Nan::FunctionCallbackInfo<Value> &info) {
   MarshalNullNode();
 }
 
+static void UTF16Range(const Nan::FunctionCallbackInfo<Value> &info) {
+  const Tree *tree = Tree::UnwrapTree(info[0]);
+  TSNode node = UnmarshalNode(tree);
+
+  if (node.id) {
+    TSRange range = {
+      ts_node_start_point(node),
+      ts_node_end_point(node),
+      ts_node_start_byte(node),
+      ts_node_end_byte(node),
+    };
+    info.GetReturnValue().Set(RangeToJS(range));
+  }
+}
+
 static void Walk(const Nan::FunctionCallbackInfo<Value> &info) {
   const Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   TSTreeCursor cursor = ts_tree_cursor_new(node);
-  info.GetReturnValue().Set(TreeCursor::NewInstance(cursor));
+  info.GetReturnValue().Set(TreeCursor::NewInstance(cursor, tree));
 }
 
 void Init(Local<Object> exports) {
@@ -711,6 +874,8 @@ void Init(Local<Object> exports) {
     {"namedChild", NamedChild},
     {"children", Children},
     {"namedChildren", NamedChildren},
+    {"childrenSlice", ChildrenSlice},
+    {"namedChildrenSlice", NamedChildrenSlice},
     {"childCount", ChildCount},
     {"namedChildCount", NamedChildCount},
     {"firstChild", FirstChild},
@@ -737,14 +902,16 @@ void Init(Local<Object> exports) {
     {"walk", Walk},
     {"closest", Closest},
     {"childNodeForFieldId", ChildNodeForFieldId},
+    {"fieldsAll", FieldsAll},
     {"childNodesForFieldId", ChildNodesForFieldId},
+    {"utf16Range", UTF16Range},
   };
 
   for (size_t i = 0; i < length_of_array(methods); i++) {
     Nan::Set(
       result,
       Nan::New(methods[i].name).ToLocalChecked(),
-      Nan::GetFunction(Nan::New<FunctionTemplate>(methods[i].callback)).ToLocalChecked()
+      metrics::NewFunction("SyntaxNode", methods[i])
     );
   }
 
@@ -4,6 +4,7 @@
 #include <nan.h>
 #include <v8.h>
 #include <node_object_wrap.h>
+#include <vector>
 #include <tree_sitter/api.h>
 #include "./tree.h"
 
@@ -18,6 +19,32 @@ Local<Value> GetMarshalNode(const Nan::FunctionCallbackInfo<Value> &info, const
 Local<Value> GetMarshalNodes(const Nan::FunctionCallbackInfo<Value> &info, const Tree *tree, const TSNode *nodes, uint32_t node_count);
 TSNode UnmarshalNode(const Tree *tree);
 
+struct SymbolSet {
+  std::vector<uint32_t> words;
+  bool includes_error = false;
+
+  void add(TSSymbol symbol) {
+    if (symbol == static_cast<TSSymbol>(-1)) {
+      includes_error = true;
+      return;
+    }
+    if (symbol / 32 >= words.size()) words.resize(symbol / 32 + 1);
+    words[symbol / 32] |= 1u << (symbol % 32);
+  }
+
+  void add_all(const uint32_t *set, uint32_t word_count) {
+    if (word_count > words.size()) words.resize(word_count);
+    for (uint32_t i = 0; i < word_count; i++) words[i] |= set[i];
+  }
+
+  bool contains(TSSymbol symbol) const {
+    if (symbol == static_cast<TSSymbol>(-1)) return includes_error;
+    return symbol / 32 < words.size() && (words[symbol / 32] & (1u << (symbol % 32)));
+  }
+};
+
+bool symbol_set_from_js(SymbolSet *, const Local<Value> &, const TSLanguage *);
+
 static inline const void *UnmarshalNodeId(const uint32_t *buffer) {
   const void *result;
   memcpy(&result, buffer, sizeof(result));
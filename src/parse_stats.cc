@@ -0,0 +1,275 @@
+#include "./parse_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include <v8.h>
+#include <nan.h>
+
+namespace node_tree_sitter {
+
+using std::vector;
+using namespace v8;
+
+static inline bool message_is(const char *message, size_t length, const char *name) {
+  return length == strlen(name) && strncmp(message, name, length) == 0;
+}
+
+static inline bool message_starts_with(const char *message, size_t length, const char *prefix) {
+  size_t prefix_length = strlen(prefix);
+  return length >= prefix_length && strncmp(message, prefix, prefix_length) == 0;
+}
+
+static void discard_message(void *, TSLogType, const char *) {}
+
+// Estimate the cost of each log message, in nanoseconds, by timing and
+// formatting messages like the runtime's. The fastest of several rounds is
+// used, so that interruptions don't inflate the estimate.
+static uint64_t estimate_message_overhead() {
+  typedef std::chrono::steady_clock Clock;
+  const unsigned round_count = 5, message_count = 1000;
+  void (*volatile log)(void *, TSLogType, const char *) = discard_message;
+  char buffer[256];
+  uint64_t result = UINT64_MAX;
+
+  for (unsigned round = 0; round < round_count; round++) {
+    Clock::time_point start = Clock::now();
+    for (unsigned i = 0; i < message_count; i++) {
+      Clock::now();
+      if (i % 2) {
+        snprintf(buffer, sizeof(buffer), "lex_internal state:%u, row:%u, column:%u", i, i / 80, i % 80);
+      } else {
+        snprintf(buffer, sizeof(buffer), "shift state:%u", i);
+      }
+      log(nullptr, TSLogTypeParse, buffer);
+    }
+    uint64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    result = std::min(result, time / message_count);
+  }
+  return result;
+}
+
+ParseStats::ParseStats() : inner_({0, 0}) {
+  // Function-local statics are initialized once, even across threads.
+  static const uint64_t message_overhead = estimate_message_overhead();
+  message_overhead_ = message_overhead;
+  Reset();
+}
+
+void ParseStats::Reset() {
+  phase_ = PhaseParse;
+  total_time_ = 0;
+  for (unsigned i = 0; i < PhaseCount; i++) {
+    phase_times_[i] = 0;
+    phase_message_counts_[i] = 0;
+  }
+  lex_count_ = 0;
+  shift_count_ = 0;
+  reduce_count_ = 0;
+  error_count_ = 0;
+  reused_node_count_ = 0;
+  reused_subtree_count_ = 0;
+  reused_byte_count_ = 0;
+}
+
+TSLogger ParseStats::Install(TSLogger inner) {
+  inner_ = inner;
+  install_time_ = phase_start_ = Clock::now();
+  phase_ = PhaseParse;
+
+  TSLogger result;
+  result.payload = (void *)this;
+  result.log = Log;
+  return result;
+}
+
+void ParseStats::Uninstall() {
+  Clock::time_point now = Clock::now();
+  EnterPhase(PhaseParse, now);
+  total_time_ += std::chrono::duration_cast<std::chrono::nanoseconds>(now - install_time_).count();
+  inner_ = {0, 0};
+}
+
+// Each message is formatted at the end of the phase before it, so its cost
+// is subtracted from that phase.
+uint64_t ParseStats::AdjustedPhaseTime(Phase phase) const {
+  uint64_t overhead = static_cast<uint64_t>(phase_message_counts_[phase]) * message_overhead_;
+  return phase_times_[phase] > overhead ? phase_times_[phase] - overhead : 0;
+}
+
+void ParseStats::EnterPhase(Phase phase, Clock::time_point now) {
+  phase_times_[phase_] += std::chrono::duration_cast<std::chrono::nanoseconds>(now - phase_start_).count();
+  phase_start_ = now;
+  phase_ = phase;
+}
+
+// Each message is assigned to the phase of the work that follows it. For
+// example, `lex_internal` is logged before a token is lexed, and
+// `lexed_lookahead` after.
+void ParseStats::Log(void *payload, TSLogType type, const char *message) {
+  ParseStats *stats = (ParseStats *)payload;
+  Clock::time_point now = Clock::now();
+
+  const char *name_end = strchr(message, ' ');
+  size_t length = name_end ? name_end - message : strlen(message);
+
+  stats->phase_message_counts_[stats->phase_]++;
+
+  Phase phase = PhaseParse;
+  if (type == TSLogTypeLex) {
+    phase = PhaseLex;
+  } else if (message_is(message, length, "lex_internal") || message_is(message, length, "lex_external")) {
+    phase = PhaseLex;
+    stats->lex_count_++;
+  } else if (message_is(message, length, "shift") || message_is(message, length, "shift_extra")) {
+    stats->shift_count_++;
+  } else if (message_is(message, length, "reduce")) {
+    stats->reduce_count_++;
+  } else if (message_is(message, length, "detect_error")) {
+    phase = PhaseErrorRecovery;
+    stats->error_count_++;
+  } else if (
+    message_starts_with(message, length, "recover") ||
+    message_is(message, length, "skip_token") ||
+    message_is(message, length, "handle_error")
+  ) {
+    phase = PhaseErrorRecovery;
+  } else if (message_is(message, length, "reuse_node")) {
+    phase = PhaseReuse;
+    stats->reused_node_count_++;
+  } else if (
+    message_starts_with(message, length, "cant_reuse") ||
+    message_starts_with(message, length, "breakdown") ||
+    message_is(message, length, "state_mismatch") ||
+    message_is(message, length, "past_change")
+  ) {
+    phase = PhaseReuse;
+  } else if (stats->phase_ == PhaseErrorRecovery && !message_is(message, length, "process")) {
+    phase = PhaseErrorRecovery;
+  }
+
+  stats->EnterPhase(phase, now);
+  if (stats->inner_.log) stats->inner_.log(stats->inner_.payload, type, message);
+}
+
+// The ranges of the old tree that were edited, which are the ranges of the
+// innermost nodes that have changes. Only the nodes with changes are
+// visited.
+static void collect_edited_ranges(const TSTree *old_tree, vector<TSRange> *ranges) {
+  TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(old_tree));
+  for (bool done = false; !done;) {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    if (ts_node_has_changes(node)) {
+      if (ts_tree_cursor_goto_first_child(&cursor)) {
+        bool child_has_changes = false;
+        do {
+          if (ts_node_has_changes(ts_tree_cursor_current_node(&cursor))) {
+            child_has_changes = true;
+            break;
+          }
+        } while (ts_tree_cursor_goto_next_sibling(&cursor));
+        if (child_has_changes) continue;
+        ts_tree_cursor_goto_parent(&cursor);
+      }
+      ranges->push_back({
+        ts_node_start_point(node), ts_node_end_point(node),
+        ts_node_start_byte(node), ts_node_end_byte(node)
+      });
+    }
+    while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) {
+        done = true;
+        break;
+      }
+    }
+  }
+  ts_tree_cursor_delete(&cursor);
+}
+
+static inline bool overlaps_changes(TSNode node, const vector<TSRange> &ranges) {
+  uint32_t start = ts_node_start_byte(node), end = ts_node_end_byte(node);
+  auto range = std::lower_bound(ranges.begin(), ranges.end(), start, [](const TSRange &range, uint32_t start) {
+    return range.end_byte < start;
+  });
+  for (; range != ranges.end() && range->start_byte <= end; ++range) {
+    if (range->start_byte == range->end_byte) {
+      if (start < range->start_byte && end > range->start_byte) return true;
+    } else if (start < range->end_byte && end > range->start_byte) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// A subtree of the new tree that doesn't overlap any of the changed or
+// edited ranges is counted as reused, without visiting its descendants, so
+// only the nodes along the changes are visited.
+void ParseStats::CountReusedNodes(const TSTree *old_tree, const TSTree *new_tree) {
+  if (!old_tree || !new_tree) return;
+
+  uint32_t range_count;
+  TSRange *changed_ranges = ts_tree_get_changed_ranges(old_tree, new_tree, &range_count);
+  vector<TSRange> ranges(changed_ranges, changed_ranges + range_count);
+  free(changed_ranges);
+  collect_edited_ranges(old_tree, &ranges);
+  std::sort(ranges.begin(), ranges.end(), [](const TSRange &a, const TSRange &b) {
+    return a.start_byte < b.start_byte;
+  });
+
+  // Ranges are merged so that their ends are ordered too, for the search.
+  vector<TSRange> merged_ranges;
+  for (const TSRange &range : ranges) {
+    if (!merged_ranges.empty() && range.start_byte < merged_ranges.back().end_byte) {
+      merged_ranges.back().end_byte = std::max(merged_ranges.back().end_byte, range.end_byte);
+    } else {
+      merged_ranges.push_back(range);
+    }
+  }
+
+  // This can run on a background thread, so it uses a cursor of its own.
+  TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(new_tree));
+  for (bool done = false; !done;) {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    if (!overlaps_changes(node, merged_ranges)) {
+      reused_subtree_count_++;
+      reused_byte_count_ += ts_node_end_byte(node) - ts_node_start_byte(node);
+    } else if (ts_tree_cursor_goto_first_child(&cursor)) {
+      continue;
+    }
+    while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) {
+        done = true;
+        break;
+      }
+    }
+  }
+  ts_tree_cursor_delete(&cursor);
+}
+
+// Times are in nanoseconds, with the estimated logging overhead subtracted,
+// which is reported separately. Byte counts are in UTF-16, which is the
+// encoding that the runtime parses.
+Local<Object> ParseStats::ToJS() const {
+  uint64_t phase_total_time = 0;
+  for (unsigned i = 0; i < PhaseCount; i++) phase_total_time += AdjustedPhaseTime(static_cast<Phase>(i));
+  uint64_t logging_time = total_time_ > phase_total_time ? total_time_ - phase_total_time : 0;
+
+  Local<Object> result = Nan::New<Object>();
+  Nan::Set(result, Nan::New("totalTime").ToLocalChecked(), Nan::New<Number>(static_cast<double>(phase_total_time)));
+  Nan::Set(result, Nan::New("lexTime").ToLocalChecked(), Nan::New<Number>(static_cast<double>(AdjustedPhaseTime(PhaseLex))));
+  Nan::Set(result, Nan::New("parseTime").ToLocalChecked(), Nan::New<Number>(static_cast<double>(AdjustedPhaseTime(PhaseParse))));
+  Nan::Set(result, Nan::New("errorRecoveryTime").ToLocalChecked(), Nan::New<Number>(static_cast<double>(AdjustedPhaseTime(PhaseErrorRecovery))));
+  Nan::Set(result, Nan::New("reuseTime").ToLocalChecked(), Nan::New<Number>(static_cast<double>(AdjustedPhaseTime(PhaseReuse))));
+  Nan::Set(result, Nan::New("loggingTime").ToLocalChecked(), Nan::New<Number>(static_cast<double>(logging_time)));
+  Nan::Set(result, Nan::New("lexCount").ToLocalChecked(), Nan::New(lex_count_));
+  Nan::Set(result, Nan::New("shiftCount").ToLocalChecked(), Nan::New(shift_count_));
+  Nan::Set(result, Nan::New("reduceCount").ToLocalChecked(), Nan::New(reduce_count_));
+  Nan::Set(result, Nan::New("errorCount").ToLocalChecked(), Nan::New(error_count_));
+  Nan::Set(result, Nan::New("reusedNodeCount").ToLocalChecked(), Nan::New(reused_node_count_));
+  Nan::Set(result, Nan::New("reusedSubtreeCount").ToLocalChecked(), Nan::New(reused_subtree_count_));
+  Nan::Set(result, Nan::New("reusedBytes").ToLocalChecked(), Nan::New(reused_byte_count_));
+  return result;
+}
+
+}  // namespace node_tree_sitter
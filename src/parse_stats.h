@@ -0,0 +1,64 @@
+#ifndef NODE_TREE_SITTER_PARSE_STATS_H_
+#define NODE_TREE_SITTER_PARSE_STATS_H_
+
+#include <v8.h>
+#include <nan.h>
+#include <chrono>
+#include <tree_sitter/api.h>
+
+namespace node_tree_sitter {
+
+// Measures how a parse spends its time. The runtime doesn't report this
+// itself, so the statistics are collected by a logger that is installed for
+// the duration of each parse. The time between two log messages is counted
+// towards the phase of the first one. Any other logger is called as well.
+//
+// The runtime formats a message for every step when a logger is installed,
+// so the phase times are samples of a slower parse. An estimate of the time
+// spent logging is subtracted from them, but they are only meaningful
+// relative to each other.
+class ParseStats {
+ public:
+  ParseStats();
+
+  void Reset();
+  TSLogger Install(TSLogger inner);
+  void Uninstall();
+  void CountReusedNodes(const TSTree *old_tree, const TSTree *new_tree);
+  v8::Local<v8::Object> ToJS() const;
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  enum Phase {
+    PhaseParse,
+    PhaseLex,
+    PhaseErrorRecovery,
+    PhaseReuse,
+    PhaseCount,
+  };
+
+  static void Log(void *, TSLogType, const char *);
+  void EnterPhase(Phase, Clock::time_point);
+  uint64_t AdjustedPhaseTime(Phase) const;
+
+  TSLogger inner_;
+  Phase phase_;
+  Clock::time_point phase_start_;
+  Clock::time_point install_time_;
+  uint64_t total_time_;
+  uint64_t phase_times_[PhaseCount];
+  uint32_t phase_message_counts_[PhaseCount];
+  uint64_t message_overhead_;
+  uint32_t lex_count_;
+  uint32_t shift_count_;
+  uint32_t reduce_count_;
+  uint32_t error_count_;
+  uint32_t reused_node_count_;
+  uint32_t reused_subtree_count_;
+  uint32_t reused_byte_count_;
+};
+
+}  // namespace node_tree_sitter
+
+#endif  // NODE_TREE_SITTER_PARSE_STATS_H_
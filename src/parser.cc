@@ -1,12 +1,21 @@
 #include "./parser.h"
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <climits>
+#include <memory>
 #include <v8.h>
 #include <nan.h>
+#include <uv.h>
 #include "./conversions.h"
 #include "./language.h"
 #include "./logger.h"
+#include "./metrics.h"
+#include "./parse_stats.h"
+#include "./probes.h"
+#include "./slow_log.h"
+#include "./text_buffer_input.h"
+#include "./trace_events.h"
 #include "./tree.h"
 #include "./util.h"
 #include "text-buffer-snapshot-wrapper.h"
@@ -25,7 +34,11 @@ class CallbackInput {
   CallbackInput(v8::Local<v8::Function> callback, v8::Local<v8::Value> js_buffer_size)
     : callback(callback),
       byte_offset(0),
-      partial_string_offset(0) {
+      partial_string_offset(0),
+      position_index(nullptr),
+      indexed_position({0, 0}),
+      indexed_to_end(false),
+      finishing_index(false) {
     uint32_t buffer_size = Nan::To<uint32_t>(js_buffer_size).FromMaybe(0);
     if (buffer_size == 0) buffer_size = 32 * 1024;
     buffer.resize(buffer_size);
@@ -39,6 +52,26 @@ class CallbackInput {
     return result;
   }
 
+  // Add the text to a position index as the parser reads it, so that the
+  // callback isn't called twice for the same text. Only text that follows
+  // the indexed text directly can be appended.
+  void IndexText(PositionIndex *index) {
+    position_index = index;
+  }
+
+  // Index the text that the parser skipped, such as text outside of the
+  // included ranges, or text covered by reused subtrees. If the callback
+  // throws, the exception is left pending and false is returned.
+  bool FinishIndex() {
+    finishing_index = true;
+    while (!indexed_to_end) {
+      uint32_t length = 0;
+      if (!Read(this, 2 * position_index->length(), indexed_position, &length) || length == 0) break;
+    }
+    finishing_index = false;
+    return indexed_to_end;
+  }
+
  private:
   static const char * Read(void *payload, uint32_t byte, TSPoint position, uint32_t *bytes_read) {
     CallbackInput *reader = (CallbackInput *)payload;
@@ -50,6 +83,7 @@ class CallbackInput {
     }
 
     *bytes_read = 0;
+    bool is_next_indexed_text = reader->position_index && byte == 2 * reader->position_index->length();
     Local<String> result;
     uint32_t start = 0;
     if (reader->partial_string_offset) {
@@ -61,11 +95,17 @@ class CallbackInput {
       Local<Value> argv[2] = { Nan::New<Number>(utf16_unit), PointToJS(position) };
       TryCatch try_catch(Isolate::GetCurrent());
       auto maybe_result_value = Nan::Call(callback, callback->CreationContext()->Global(), 2, argv);
-      if (try_catch.HasCaught()) return nullptr;
+      if (try_catch.HasCaught()) {
+        if (reader->finishing_index) try_catch.ReThrow();
+        return nullptr;
+      }
 
       Local<Value> result_value;
       if (!maybe_result_value.ToLocal(&result_value)) return nullptr;
-      if (!result_value->IsString()) return nullptr;
+      if (!result_value->IsString()) {
+        if (is_next_indexed_text) reader->indexed_to_end = true;
+        return nullptr;
+      }
       if (!Nan::To<String>(result_value).ToLocal(&result)) return nullptr;
     }
 
@@ -84,6 +124,10 @@ class CallbackInput {
     int end = start + utf16_units_read;
     *bytes_read = 2 * utf16_units_read;
 
+    if (is_next_indexed_text) {
+      reader->AppendToIndex(reader->buffer.data(), utf16_units_read);
+    }
+
     reader->byte_offset += *bytes_read;
 
     if (end < result->Length()) {
@@ -97,68 +141,32 @@ class CallbackInput {
     return (const char *)reader->buffer.data();
   }
 
-  Nan::Persistent<v8::Function> callback;
-  std::vector<uint16_t> buffer;
-  size_t byte_offset;
-  Nan::Persistent<v8::String> partial_string;
-  size_t partial_string_offset;
-};
-
-class TextBufferInput {
-public:
-  TextBufferInput(const vector<pair<const char16_t *, uint32_t>> *slices)
-    : slices_(slices),
-      byte_offset(0),
-      slice_index_(0),
-      slice_offset_(0) {}
-
-  TSInput input() {
-    return TSInput{this, Read, TSInputEncodingUTF16};
-  }
-
-private:
-  void seek(uint32_t byte_offset) {
-    this->byte_offset = byte_offset;
-
-    uint32_t total_length = 0;
-    uint32_t goal_index = byte_offset / 2;
-    for (unsigned i = 0, n = this->slices_->size(); i < n; i++) {
-      uint32_t next_total_length = total_length + this->slices_->at(i).second;
-      if (next_total_length > goal_index) {
-        this->slice_index_ = i;
-        this->slice_offset_ = goal_index - total_length;
-        return;
-      }
-      total_length = next_total_length;
+  void AppendToIndex(const uint16_t *units, uint32_t count) {
+    if (count == 0) {
+      indexed_to_end = true;
+      return;
     }
 
-    this->slice_index_ = this->slices_->size();
-    this->slice_offset_ = 0;
-  }
-
-  static const char *Read(void *payload, uint32_t byte, TSPoint position, uint32_t *length) {
-    auto self = static_cast<TextBufferInput *>(payload);
-
-    if (byte != self->byte_offset) self->seek(byte);
-
-    if (self->slice_index_ == self->slices_->size()) {
-      *length = 0;
-      return "";
+    position_index->Append(units, count);
+    for (uint32_t i = 0; i < count; i++) {
+      if (units[i] == '\n') {
+        indexed_position.row++;
+        indexed_position.column = 0;
+      } else {
+        indexed_position.column += 2;
+      }
     }
-
-    auto &slice = self->slices_->at(self->slice_index_);
-    const char16_t *result = slice.first + self->slice_offset_;
-    *length = 2 * (slice.second - self->slice_offset_);
-    self->byte_offset += *length;
-    self->slice_index_++;
-    self->slice_offset_ = 0;
-    return reinterpret_cast<const char *>(result);
   }
 
-  const vector<pair<const char16_t *, uint32_t>> *slices_;
-  uint32_t byte_offset;
-  uint32_t slice_index_;
-  uint32_t slice_offset_;
+  Nan::Persistent<v8::Function> callback;
+  std::vector<uint16_t> buffer;
+  size_t byte_offset;
+  Nan::Persistent<v8::String> partial_string;
+  size_t partial_string_offset;
+  PositionIndex *position_index;
+  TSPoint indexed_position;
+  bool indexed_to_end;
+  bool finishing_index;
 };
 
 void Parser::Init(Local<Object> exports) {
@@ -170,27 +178,130 @@ void Parser::Init(Local<Object> exports) {
   FunctionPair methods[] = {
     {"getLogger", GetLogger},
     {"setLogger", SetLogger},
+    {"_setLogBuffer", SetLogBuffer},
+    {"_drainLog", DrainLog},
     {"setLanguage", SetLanguage},
     {"printDotGraphs", PrintDotGraphs},
+    {"enableParseStats", EnableParseStats},
+    {"getParseStats", GetParseStats},
     {"parse", Parse},
     {"parseTextBuffer", ParseTextBuffer},
     {"parseTextBufferSync", ParseTextBufferSync},
   };
 
-  for (size_t i = 0; i < length_of_array(methods); i++) {
-    Nan::SetPrototypeMethod(tpl, methods[i].name, methods[i].callback);
-  }
+  metrics::SetPrototypeMethods(tpl, "Parser", methods, length_of_array(methods));
+
+  Local<Function> ctor = Nan::GetFunction(tpl).ToLocalChecked();
+  Nan::SetMethod(ctor, "_trialParse", TrialParse);
 
-  constructor.Reset(Nan::Persistent<Function>(Nan::GetFunction(tpl).ToLocalChecked()));
+  constructor.Reset(Nan::Persistent<Function>(ctor));
   Nan::Set(exports, class_name, Nan::New(constructor));
   Nan::Set(exports, Nan::New("LANGUAGE_VERSION").ToLocalChecked(), Nan::New<Number>(TREE_SITTER_LANGUAGE_VERSION));
 }
 
-Parser::Parser() : parser_(ts_parser_new()), is_parsing_async_(false) {}
+Parser::Parser() : parser_(ts_parser_new()), is_parsing_async_(false), parse_stats_(nullptr) {}
+
+static void delete_logger(TSLogger logger) {
+  if (!logger.payload) return;
+  if (logger.log == Logger::Log) {
+    delete (Logger *)logger.payload;
+  } else if (logger.log == LogBuffer::Log) {
+    delete (LogBuffer *)logger.payload;
+  }
+}
+
+Parser::~Parser() {
+  delete_logger(ts_parser_logger(parser_));
+  ts_parser_delete(parser_);
+  delete parse_stats_;
+}
+
+// Logging callbacks can only be called on the main thread, so they are
+// disabled for parses that may continue on a background thread. Log buffers
+// can be written from any thread, so they are left in place. If parse stats
+// are enabled, their logger is installed in front of the parser's own.
+//
+// A parse that times out on the main thread is resumed on a background
+// thread, and is measured as one parse from its first slice to its last.
+TSLogger Parser::BeginParse(bool allow_logging_callback, bool resuming) {
+  parse_slice_start_time_ = uv_hrtime();
+  if (!resuming) {
+    parse_start_time_ = parse_slice_start_time_;
+    PROBE_PARSE_START(this, language_name_.c_str());
+  }
+  TSLogger logger = ts_parser_logger(parser_);
+  TSLogger inner_logger = logger;
+  if (!allow_logging_callback && logger.log == Logger::Log) inner_logger = TSLogger{0, 0};
+
+  if (parse_stats_) {
+    ts_parser_set_logger(parser_, parse_stats_->Install(inner_logger));
+  } else if (inner_logger.log != logger.log) {
+    ts_parser_set_logger(parser_, inner_logger);
+  }
+  return logger;
+}
+
+static uint32_t changed_byte_count(const TSTree *old_tree, const TSTree *new_tree) {
+  uint32_t range_count;
+  TSRange *ranges = ts_tree_get_changed_ranges(old_tree, new_tree, &range_count);
+  uint32_t result = 0;
+  for (uint32_t i = 0; i < range_count; i++) {
+    result += ranges[i].end_byte - ranges[i].start_byte;
+  }
+  free(ranges);
+  return result;
+}
+
+static void record_slow_parse(const std::string &language_name, const TSTree *old_tree, const TSTree *result,
+                              const char *method_name, uint32_t byte_count, uint64_t duration,
+                              bool incremental) {
+  slow_log::Entry entry;
+  entry.operation = incremental ? slow_log::OperationReparse : slow_log::OperationParse;
+  entry.method_name = method_name;
+  entry.language = language_name;
+  entry.duration = duration;
+  entry.byte_count = byte_count;
+  entry.changed_byte_count = old_tree && result ? changed_byte_count(old_tree, result) : 0;
+  entry.result_count = 0;
+  entry.node_count = 0;
+  slow_log::Record(std::move(entry));
+}
+
+// The old tree is only used to measure the changes in slow reparses, and
+// may be null even if the parse was incremental.
+void Parser::EndParse(TSLogger logger, const TSTree *old_tree, const TSTree *result,
+                      const char *method_name, bool incremental, bool suspending) {
+  if (parse_stats_) parse_stats_->Uninstall();
+  ts_parser_set_logger(parser_, logger);
+
+  uint64_t end_time = uv_hrtime();
+  metrics::Add(metrics::ParseTime, end_time - parse_slice_start_time_);
+  if (suspending) return;
+
+  uint32_t byte_count = result ? ts_node_end_byte(ts_tree_root_node(result)) : 0;
+  uint64_t duration = end_time - parse_start_time_;
+  if (result) {
+    metrics::Add(metrics::Parses);
+    metrics::Add(metrics::ParseBytes, byte_count);
+  }
+  PROBE_PARSE_DONE(this, language_name_.c_str(), byte_count, duration, incremental);
+  if (slow_log::IsSlowParse(duration)) {
+    record_slow_parse(language_name_, old_tree, result, method_name, byte_count, duration, incremental);
+  }
 
-Parser::~Parser() { ts_parser_delete(parser_); }
+  trace_events::Span span(
+    incremental ? trace_events::CategoryIncrementalParse : trace_events::CategoryParse,
+    method_name,
+    parse_start_time_
+  );
+  if (span.enabled()) {
+    span.AddArg("language", language_name_);
+    span.AddArg("bytes", byte_count);
+    span.AddArg("completed", result ? 1 : 0);
+  }
+}
 
-static bool handle_included_ranges(TSParser *parser, Local<Value> arg) {
+static bool handle_included_ranges(TSParser *parser, Local<Value> arg, const PositionIndex *index) {
   uint32_t last_included_range_end = 0;
   if (arg->IsArray()) {
     auto js_included_ranges = Local<Array>::Cast(arg);
@@ -198,7 +309,7 @@ static bool handle_included_ranges(TSParser *parser, Local<Value> arg) {
     for (unsigned i = 0; i < js_included_ranges->Length(); i++) {
       Local<Value> range_value;
       if (!Nan::Get(js_included_ranges, i).ToLocal(&range_value)) return false;
-      auto maybe_range = RangeFromJS(range_value);
+      auto maybe_range = RangeFromJS(range_value, index);
       if (!maybe_range.IsJust()) return false;
       auto range = maybe_range.FromJust();
       if (range.start_byte < last_included_range_end) {
@@ -216,6 +327,97 @@ static bool handle_included_ranges(TSParser *parser, Local<Value> arg) {
   return true;
 }
 
+static bool position_encoding_from_js(Local<Value> arg, PositionEncoding *result) {
+  if (arg->IsUndefined() || arg->IsNull()) {
+    *result = PositionEncodingUTF16;
+    return true;
+  }
+
+  switch (Nan::To<uint32_t>(arg).FromMaybe(0)) {
+    case PositionEncodingUTF8:
+      *result = PositionEncodingUTF8;
+      return true;
+    case PositionEncodingUTF16:
+      *result = PositionEncodingUTF16;
+      return true;
+    case PositionEncodingUTF32:
+      *result = PositionEncodingUTF32;
+      return true;
+    default:
+      Nan::ThrowTypeError("Position encoding must be 'utf8', 'utf16' or 'utf32'");
+      return false;
+  }
+}
+
+// Trees that don't use UTF-16 positions need an index of the text's non-ASCII
+// characters. An edited old tree already has an up-to-date index, so it can
+// be shared.
+static bool needs_new_position_index(PositionEncoding encoding, const Tree *old_tree) {
+  if (encoding == PositionEncodingUTF16) return false;
+  return !(old_tree && old_tree->position_index_ && old_tree->position_index_->encoding() == encoding);
+}
+
+static std::shared_ptr<PositionIndex> existing_position_index(PositionEncoding encoding, const Tree *old_tree) {
+  if (encoding == PositionEncodingUTF16) return nullptr;
+  return old_tree->position_index_;
+}
+
+static std::shared_ptr<PositionIndex> position_index_for_string(PositionEncoding encoding, Local<String> string) {
+  auto result = std::make_shared<PositionIndex>(encoding);
+  vector<uint16_t> buffer(32 * 1024);
+  for (int start = 0, length = string->Length(); start < length;) {
+    int count = string->Write(
+
+      // Nan doesn't wrap this functionality
+      #if NODE_MAJOR_VERSION >= 12
+        Isolate::GetCurrent(),
+      #endif
+
+      buffer.data(),
+      start,
+      buffer.size(),
+      String::NO_NULL_TERMINATION
+    );
+    result->Append(buffer.data(), count);
+    start += count;
+  }
+  return result;
+}
+
+// Otherwise, the whole input is scanned before parsing. This is done for text
+// buffers, whose text is read natively, and for callbacks with included
+// ranges, whose positions have to be converted before parsing.
+static std::shared_ptr<PositionIndex> position_index_for_input(
+  PositionEncoding encoding,
+  const Tree *old_tree,
+  TSInput input
+) {
+  if (!needs_new_position_index(encoding, old_tree)) return existing_position_index(encoding, old_tree);
+
+  auto result = std::make_shared<PositionIndex>(encoding);
+  uint32_t byte = 0;
+  TSPoint position = {0, 0};
+  for (;;) {
+    uint32_t length = 0;
+    const char *chunk = input.read(input.payload, byte, position, &length);
+    if (!chunk || length == 0) break;
+
+    const uint16_t *units = reinterpret_cast<const uint16_t *>(chunk);
+    uint32_t unit_count = length / 2;
+    result->Append(units, unit_count);
+    for (uint32_t i = 0; i < unit_count; i++) {
+      if (units[i] == '\n') {
+        position.row++;
+        position.column = 0;
+      } else {
+        position.column += 2;
+      }
+    }
+    byte += length;
+  }
+  return result;
+}
+
 void Parser::New(const Nan::FunctionCallbackInfo<Value> &info) {
   if (info.IsConstructCall()) {
     Parser *parser = new Parser();
@@ -242,6 +444,7 @@ void Parser::SetLanguage(const Nan::FunctionCallbackInfo<Value> &info) {
   const TSLanguage *language = language_methods::UnwrapLanguage(info[0]);
   if (language) {
     ts_parser_set_language(parser->parser_, language);
+    parser->language_name_ = info[1]->IsString() ? *Nan::Utf8String(info[1]) : "";
     info.GetReturnValue().Set(info.This());
   }
 }
@@ -261,24 +464,60 @@ void Parser::Parse(const Nan::FunctionCallbackInfo<Value> &info) {
   Local<Function> callback = Local<Function>::Cast(info[0]);
 
   Local<Object> js_old_tree;
-  const TSTree *old_tree = nullptr;
+  const Tree *old_tree = nullptr;
   if (info.Length() > 1 && !info[1]->IsNull() && !info[1]->IsUndefined() && Nan::To<Object>(info[1]).ToLocal(&js_old_tree)) {
-    const Tree *tree = Tree::UnwrapTree(js_old_tree);
-    if (!tree) {
+    old_tree = Tree::UnwrapTree(js_old_tree);
+    if (!old_tree) {
       Nan::ThrowTypeError("Second argument must be a tree");
       return;
     }
-    old_tree = tree->tree_;
   }
 
   Local<Value> buffer_size = Nan::Null();
   if (info.Length() > 2) buffer_size = info[2];
 
-  if (!handle_included_ranges(parser->parser_, info[3])) return;
+  PositionEncoding encoding;
+  if (!position_encoding_from_js(info[4], &encoding)) return;
 
+  // When the input is a string, its index is built from the string. For
+  // other callbacks, the index is built from the text as the parser reads it,
+  // unless included ranges have to be converted before parsing.
   CallbackInput callback_input(callback, buffer_size);
-  TSTree *tree = ts_parser_parse(parser->parser_, old_tree, callback_input.Input());
-  Local<Value> result = Tree::NewInstance(tree);
+  std::shared_ptr<PositionIndex> position_index;
+  bool index_while_parsing = false;
+  if (!needs_new_position_index(encoding, old_tree)) {
+    position_index = existing_position_index(encoding, old_tree);
+  } else if (info[5]->IsString()) {
+    position_index = position_index_for_string(encoding, Local<String>::Cast(info[5]));
+  } else if (info[3]->IsArray() && Local<Array>::Cast(info[3])->Length() > 0) {
+    position_index = position_index_for_input(encoding, old_tree, callback_input.Input());
+  } else {
+    position_index = std::make_shared<PositionIndex>(encoding);
+    callback_input.IndexText(position_index.get());
+    index_while_parsing = true;
+  }
+
+  if (!handle_included_ranges(parser->parser_, info[3], position_index.get())) return;
+
+  if (parser->parse_stats_) parser->parse_stats_->Reset();
+  TSLogger logger = parser->BeginParse(true);
+  TSTree *tree = ts_parser_parse(parser->parser_, old_tree ? old_tree->tree_ : nullptr, callback_input.Input());
+  parser->EndParse(logger, old_tree ? old_tree->tree_ : nullptr, tree, "Parser.parse", old_tree);
+  if (parser->parse_stats_) parser->parse_stats_->CountReusedNodes(old_tree ? old_tree->tree_ : nullptr, tree);
+  if (tree && index_while_parsing) {
+    TryCatch try_catch(Isolate::GetCurrent());
+    if (!callback_input.FinishIndex()) {
+      ts_tree_delete(tree);
+      if (try_catch.HasCaught()) {
+        try_catch.ReThrow();
+      } else {
+        Nan::ThrowError("Input callback didn't return the rest of the text");
+      }
+      return;
+    }
+  }
+
+  Local<Value> result = Tree::NewInstance(tree, position_index);
   info.GetReturnValue().Set(result);
 }
 
@@ -286,29 +525,148 @@ class ParseWorker : public Nan::AsyncWorker {
   Parser *parser_;
   TSTree *new_tree_;
   TextBufferInput *input_;
+  std::shared_ptr<PositionIndex> position_index_;
+  TSTree *old_tree_;
+  bool incremental_;
+  bool resuming_;
 
 public:
-  ParseWorker(Nan::Callback *callback, Parser *parser, TextBufferInput *input) :
+  // The old tree is only needed to count reused nodes for parse stats, and to
+  // measure the changes in slow reparses.
+  ParseWorker(Nan::Callback *callback, Parser *parser, TextBufferInput *input,
+              std::shared_ptr<PositionIndex> position_index, TSTree *old_tree, bool incremental,
+              bool resuming) :
     AsyncWorker(callback, "tree-sitter.parseTextBuffer"),
     parser_(parser),
     new_tree_(nullptr),
-    input_(input) {}
+    input_(input),
+    position_index_(position_index),
+    old_tree_(old_tree),
+    incremental_(incremental),
+    resuming_(resuming) {}
 
   void Execute() {
-    TSLogger logger = ts_parser_logger(parser_->parser_);
-    ts_parser_set_logger(parser_->parser_, TSLogger{0, 0});
+    TSLogger logger = parser_->BeginParse(false, resuming_);
     new_tree_ = ts_parser_parse(parser_->parser_, nullptr, input_->input());
-    ts_parser_set_logger(parser_->parser_, logger);
+    parser_->EndParse(logger, old_tree_, new_tree_, "Parser.parseTextBuffer", incremental_);
+    if (parser_->parse_stats_) parser_->parse_stats_->CountReusedNodes(old_tree_, new_tree_);
   }
 
   void HandleOKCallback() {
     parser_->is_parsing_async_ = false;
     delete input_;
-    Local<Value> argv[] = {Tree::NewInstance(new_tree_)};
+    if (old_tree_) ts_tree_delete(old_tree_);
+    Local<Value> argv[] = {Tree::NewInstance(new_tree_, position_index_)};
     callback->Call(1, argv, async_resource);
   }
 };
 
+// Parses a text with a language on a background thread, using a parser of
+// its own so that several languages can be tried at once, and measures the
+// errors in the resulting tree.
+class TrialParseWorker : public Nan::AsyncWorker {
+  const TSLanguage *language_;
+  std::shared_ptr<const vector<uint16_t>> text_;
+  TSTree *tree_;
+  uint32_t error_count_;
+  uint32_t error_cost_;
+
+public:
+  TrialParseWorker(Nan::Callback *callback, const TSLanguage *language,
+                   std::shared_ptr<const vector<uint16_t>> text) :
+    AsyncWorker(callback, "tree-sitter.detectLanguage"),
+    language_(language),
+    text_(text),
+    tree_(nullptr),
+    error_count_(0),
+    error_cost_(0) {}
+
+  void Execute() {
+    TSParser *parser = ts_parser_new();
+    if (ts_parser_set_language(parser, language_)) {
+      tree_ = ts_parser_parse_string_encoding(
+        parser,
+        nullptr,
+        reinterpret_cast<const char *>(text_->data()),
+        text_->size() * sizeof(uint16_t),
+        TSInputEncodingUTF16
+      );
+    }
+    ts_parser_delete(parser);
+    if (!tree_) return;
+
+    // Each error or missing node counts as an error. The cost of an error
+    // is the number of characters that it skips, and at least one.
+    TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree_));
+    bool visited_children = false;
+    while (true) {
+      if (!visited_children) {
+        TSNode node = ts_tree_cursor_current_node(&cursor);
+        if (ts_node_is_error(node) || ts_node_is_missing(node)) {
+          uint32_t length = (ts_node_end_byte(node) - ts_node_start_byte(node)) / 2;
+          error_count_++;
+          error_cost_ += length > 0 ? length : 1;
+          visited_children = true;
+          continue;
+        }
+        if (!ts_node_has_error(node)) {
+          visited_children = true;
+          continue;
+        }
+        if (ts_tree_cursor_goto_first_child(&cursor)) continue;
+        visited_children = true;
+      } else if (ts_tree_cursor_goto_next_sibling(&cursor)) {
+        visited_children = false;
+      } else if (!ts_tree_cursor_goto_parent(&cursor)) {
+        break;
+      }
+    }
+    ts_tree_cursor_delete(&cursor);
+  }
+
+  void HandleOKCallback() {
+    Local<Value> argv[] = {
+      Tree::NewInstance(tree_),
+      Nan::New(error_count_),
+      Nan::New(error_cost_),
+    };
+    callback->Call(3, argv, async_resource);
+  }
+};
+
+void Parser::TrialParse(const Nan::FunctionCallbackInfo<Value> &info) {
+  if (!info[0]->IsFunction()) {
+    Nan::ThrowTypeError("First argument must be a callback");
+    return;
+  }
+
+  const TSLanguage *language = language_methods::UnwrapLanguage(info[1]);
+  if (!language) return;
+
+  if (!info[2]->IsString()) {
+    Nan::ThrowTypeError("Input must be a string");
+    return;
+  }
+
+  Local<String> js_text = Local<String>::Cast(info[2]);
+  auto text = std::make_shared<vector<uint16_t>>(js_text->Length());
+  js_text->Write(
+
+    // Nan doesn't wrap this functionality
+    #if NODE_MAJOR_VERSION >= 12
+      Isolate::GetCurrent(),
+    #endif
+
+    text->data(),
+    0,
+    text->size(),
+    String::NO_NULL_TERMINATION
+  );
+
+  auto callback = new Nan::Callback(info[0].As<Function>());
+  Nan::AsyncQueueWorker(new TrialParseWorker(callback, language, text));
+}
+
 void Parser::ParseTextBuffer(const Nan::FunctionCallbackInfo<Value> &info) {
   Parser *parser = ObjectWrap::Unwrap<Parser>(info.This());
   if (parser->is_parsing_async_) {
@@ -317,23 +675,32 @@ void Parser::ParseTextBuffer(const Nan::FunctionCallbackInfo<Value> &info) {
   }
 
   Local<Object> js_old_tree;
-  const TSTree *old_tree = nullptr;
+  const Tree *old_tree = nullptr;
   if (info.Length() > 2 && info[2]->IsObject() && Nan::To<Object>(info[2]).ToLocal(&js_old_tree)) {
-    const Tree *tree = Tree::UnwrapTree(js_old_tree);
-    if (!tree) {
+    old_tree = Tree::UnwrapTree(js_old_tree);
+    if (!old_tree) {
       Nan::ThrowTypeError("Second argument must be a tree");
       return;
     }
-    old_tree = tree->tree_;
   }
 
-  if (!handle_included_ranges(parser->parser_, info[3])) return;
+  PositionEncoding encoding;
+  if (!position_encoding_from_js(info[5], &encoding)) return;
 
   auto snapshot = Nan::ObjectWrap::Unwrap<TextBufferSnapshotWrapper>(info[1].As<Object>());
   auto input = new TextBufferInput(snapshot->slices());
+  auto position_index = position_index_for_input(encoding, old_tree, input->input());
+
+  if (!handle_included_ranges(parser->parser_, info[3], position_index.get())) {
+    delete input;
+    return;
+  }
+
+  if (parser->parse_stats_) parser->parse_stats_->Reset();
 
   // If a `syncTimeoutMicros` option is passed, parse synchronously
   // for the given amount of time before queuing an async task.
+  bool resuming = false;
   double js_sync_timeout = Nan::To<double>(info[4]).FromMaybe(-1);
   if (js_sync_timeout > 0) {
     size_t sync_timeout;
@@ -351,22 +718,23 @@ void Parser::ParseTextBuffer(const Nan::FunctionCallbackInfo<Value> &info) {
       }
     }
 
-    // Logging is disabled for this method, because we can't call the
-    // logging callback from an async worker.
-    TSLogger logger = ts_parser_logger(parser->parser_);
+    // Logging callbacks are disabled for this method, because we can't call
+    // them from an async worker.
+    TSLogger logger = parser->BeginParse(false);
     ts_parser_set_timeout_micros(parser->parser_, sync_timeout);
-    ts_parser_set_logger(parser->parser_, TSLogger{0, 0});
-    TSTree *result = ts_parser_parse(parser->parser_, old_tree, input->input());
+    TSTree *result = ts_parser_parse(parser->parser_, old_tree ? old_tree->tree_ : nullptr, input->input());
     ts_parser_set_timeout_micros(parser->parser_, 0);
-    ts_parser_set_logger(parser->parser_, logger);
+    parser->EndParse(logger, old_tree ? old_tree->tree_ : nullptr, result, "Parser.parseTextBuffer", old_tree, !result);
 
     if (result) {
+      if (parser->parse_stats_) parser->parse_stats_->CountReusedNodes(old_tree ? old_tree->tree_ : nullptr, result);
       delete input;
-      Local<Value> argv[] = {Tree::NewInstance(result)};
+      Local<Value> argv[] = {Tree::NewInstance(result, position_index)};
       auto callback = info[0].As<Function>();
       Nan::Call(callback, callback->CreationContext()->Global(), 1, argv);
       return;
     }
+    resuming = true;
   }
 
   auto callback = new Nan::Callback(info[0].As<Function>());
@@ -374,7 +742,11 @@ void Parser::ParseTextBuffer(const Nan::FunctionCallbackInfo<Value> &info) {
   Nan::AsyncQueueWorker(new ParseWorker(
     callback,
     parser,
-    input
+    input,
+    position_index,
+    old_tree && (parser->parse_stats_ || slow_log::IsEnabled()) ? ts_tree_copy(old_tree->tree_) : nullptr,
+    old_tree,
+    resuming
   ));
 }
 
@@ -386,22 +758,31 @@ void Parser::ParseTextBufferSync(const Nan::FunctionCallbackInfo<Value> &info) {
   }
 
   Local<Object> js_old_tree;
-  const TSTree *old_tree = nullptr;
+  const Tree *old_tree = nullptr;
   if (info.Length() > 1 && info[1]->IsObject() && Nan::To<Object>(info[1]).ToLocal(&js_old_tree)) {
-    const Tree *tree = Tree::UnwrapTree(js_old_tree);
-    if (!tree) {
+    old_tree = Tree::UnwrapTree(js_old_tree);
+    if (!old_tree) {
       Nan::ThrowTypeError("Second argument must be a tree");
       return;
     }
-    old_tree = ts_tree_copy(tree->tree_);
   }
 
-  if (!handle_included_ranges(parser->parser_, info[2])) return;
+  PositionEncoding encoding;
+  if (!position_encoding_from_js(info[3], &encoding)) return;
 
   auto snapshot = Nan::ObjectWrap::Unwrap<TextBufferSnapshotWrapper>(info[0].As<Object>());
   TextBufferInput input(snapshot->slices());
-  TSTree *result = ts_parser_parse(parser->parser_, old_tree, input.input());
-  info.GetReturnValue().Set(Tree::NewInstance(result));
+  auto position_index = position_index_for_input(encoding, old_tree, input.input());
+
+  if (!handle_included_ranges(parser->parser_, info[2], position_index.get())) return;
+
+  if (parser->parse_stats_) parser->parse_stats_->Reset();
+  TSLogger logger = parser->BeginParse(true);
+  TSTree *result = ts_parser_parse(parser->parser_, old_tree ? ts_tree_copy(old_tree->tree_) : nullptr, input.input());
+  parser->EndParse(logger, old_tree ? old_tree->tree_ : nullptr, result, "Parser.parseTextBufferSync", old_tree);
+  if (parser->parse_stats_) parser->parse_stats_->CountReusedNodes(old_tree ? old_tree->tree_ : nullptr, result);
+
+  info.GetReturnValue().Set(Tree::NewInstance(result, position_index));
 }
 
 void Parser::GetLogger(const Nan::FunctionCallbackInfo<Value> &info) {
@@ -426,10 +807,10 @@ void Parser::SetLogger(const Nan::FunctionCallbackInfo<Value> &info) {
   TSLogger current_logger = ts_parser_logger(parser->parser_);
 
   if (info[0]->IsFunction()) {
-    if (current_logger.payload) delete (Logger *)current_logger.payload;
+    delete_logger(current_logger);
     ts_parser_set_logger(parser->parser_, Logger::Make(Local<Function>::Cast(info[0])));
   } else if (!Nan::To<bool>(info[0]).FromMaybe(true)) {
-    if (current_logger.payload) delete (Logger *)current_logger.payload;
+    delete_logger(current_logger);
     ts_parser_set_logger(parser->parser_, { 0, 0 });
   } else {
     Nan::ThrowTypeError("Logger callback must either be a function or a falsy value");
@@ -439,6 +820,92 @@ void Parser::SetLogger(const Nan::FunctionCallbackInfo<Value> &info) {
   info.GetReturnValue().Set(info.This());
 }
 
+void Parser::SetLogBuffer(const Nan::FunctionCallbackInfo<Value> &info) {
+  Parser *parser = ObjectWrap::Unwrap<Parser>(info.This());
+  if (parser->is_parsing_async_) {
+    Nan::ThrowError("Parser is in use");
+    return;
+  }
+
+  auto maybe_capacity = Nan::To<uint32_t>(info[0]);
+  if (maybe_capacity.IsNothing()) {
+    Nan::ThrowTypeError("Log buffer capacity must be an integer");
+    return;
+  }
+  bool timestamps = Nan::To<bool>(info[1]).FromMaybe(false);
+
+  delete_logger(ts_parser_logger(parser->parser_));
+  uint32_t capacity = maybe_capacity.FromJust();
+  if (capacity > 0) {
+    LogBuffer *buffer = new LogBuffer(capacity / sizeof(uint32_t), timestamps);
+    ts_parser_set_logger(parser->parser_, buffer->Make());
+  } else {
+    ts_parser_set_logger(parser->parser_, { 0, 0 });
+  }
+}
+
+// Log records are returned along with the strings that were added to the
+// buffer's string table since the last time it was drained, and the number
+// of records that were dropped because the buffer was full.
+void Parser::DrainLog(const Nan::FunctionCallbackInfo<Value> &info) {
+  Parser *parser = ObjectWrap::Unwrap<Parser>(info.This());
+
+  TSLogger current_logger = ts_parser_logger(parser->parser_);
+  if (!current_logger.payload || current_logger.log != LogBuffer::Log) return;
+
+  vector<uint32_t> records;
+  vector<std::string> new_strings;
+  uint32_t dropped_count;
+  ((LogBuffer *)current_logger.payload)->Drain(&records, &new_strings, &dropped_count);
+
+  Local<ArrayBuffer> buffer = ArrayBuffer::New(Isolate::GetCurrent(), records.size() * sizeof(uint32_t));
+  Local<Uint32Array> js_records = Uint32Array::New(buffer, 0, records.size());
+  Nan::TypedArrayContents<uint32_t> contents(js_records);
+  std::copy(records.begin(), records.end(), *contents);
+
+  Local<Array> js_strings = Nan::New<Array>(new_strings.size());
+  for (unsigned i = 0; i < new_strings.size(); i++) {
+    Nan::Set(js_strings, i, Nan::New(new_strings[i]).ToLocalChecked());
+  }
+
+  Local<Array> result = Nan::New<Array>(3);
+  Nan::Set(result, 0, js_records);
+  Nan::Set(result, 1, js_strings);
+  Nan::Set(result, 2, Nan::New(dropped_count));
+  info.GetReturnValue().Set(result);
+}
+
+void Parser::EnableParseStats(const Nan::FunctionCallbackInfo<Value> &info) {
+  Parser *parser = ObjectWrap::Unwrap<Parser>(info.This());
+  if (parser->is_parsing_async_) {
+    Nan::ThrowError("Parser is in use");
+    return;
+  }
+
+  if (Nan::To<bool>(info[0]).FromMaybe(true)) {
+    if (!parser->parse_stats_) parser->parse_stats_ = new ParseStats();
+  } else {
+    delete parser->parse_stats_;
+    parser->parse_stats_ = nullptr;
+  }
+
+  info.GetReturnValue().Set(info.This());
+}
+
+void Parser::GetParseStats(const Nan::FunctionCallbackInfo<Value> &info) {
+  Parser *parser = ObjectWrap::Unwrap<Parser>(info.This());
+  if (parser->is_parsing_async_) {
+    Nan::ThrowError("Parser is in use");
+    return;
+  }
+
+  if (parser->parse_stats_) {
+    info.GetReturnValue().Set(parser->parse_stats_->ToJS());
+  } else {
+    info.GetReturnValue().Set(Nan::Null());
+  }
+}
+
 void Parser::PrintDotGraphs(const Nan::FunctionCallbackInfo<Value> &info) {
   Parser *parser = ObjectWrap::Unwrap<Parser>(info.This());
   if (parser->is_parsing_async_) {
@@ -4,7 +4,9 @@
 #include <v8.h>
 #include <nan.h>
 #include <node_object_wrap.h>
+#include <string>
 #include <tree_sitter/api.h>
+#include "./parse_stats.h"
 
 namespace node_tree_sitter {
 
@@ -12,8 +14,13 @@ class Parser : public Nan::ObjectWrap {
  public:
   static void Init(v8::Local<v8::Object> exports);
 
+  TSLogger BeginParse(bool allow_logging_callback, bool resuming = false);
+  void EndParse(TSLogger, const TSTree *old_tree, const TSTree *result, const char *method_name, bool incremental,
+                bool suspending = false);
+
   TSParser *parser_;
   bool is_parsing_async_;
+  ParseStats *parse_stats_;
 
  private:
   explicit Parser();
@@ -23,10 +30,19 @@ class Parser : public Nan::ObjectWrap {
   static void SetLanguage(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void GetLogger(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void SetLogger(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void SetLogBuffer(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void DrainLog(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void Parse(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void ParseTextBuffer(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void ParseTextBufferSync(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void PrintDotGraphs(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void EnableParseStats(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void GetParseStats(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void TrialParse(const Nan::FunctionCallbackInfo<v8::Value> &);
+
+  uint64_t parse_start_time_;
+  uint64_t parse_slice_start_time_;
+  std::string language_name_;
 
   static Nan::Persistent<v8::Function> constructor;
 };
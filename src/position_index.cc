@@ -0,0 +1,190 @@
+#include "./position_index.h"
+#include <algorithm>
+
+namespace node_tree_sitter {
+
+using std::vector;
+
+PositionIndex::PositionIndex(PositionEncoding encoding) :
+  encoding_(encoding),
+  length_(0),
+  line_starts_(1, 0) {}
+
+static inline void push_run(vector<PositionIndex::Run> *runs, const PositionIndex::Run &run) {
+  if (run.length == 0) return;
+  if (!runs->empty()) {
+    PositionIndex::Run &last = runs->back();
+    if (last.kind == run.kind && last.start + last.length == run.start) {
+      last.length += run.length;
+      return;
+    }
+  }
+  runs->push_back(run);
+}
+
+uint32_t PositionIndex::EncodedLength(const Run &run, uint32_t length) const {
+  if (encoding_ == PositionEncodingUTF8) {
+    return run.kind == RunKindThreeByte ? 3 * length : 2 * length;
+  } else {
+    return run.kind == RunKindSurrogate ? (length + 1) / 2 : length;
+  }
+}
+
+uint32_t PositionIndex::DecodedLength(const Run &run, uint32_t encoded_length) const {
+  if (encoding_ == PositionEncodingUTF8) {
+    switch (run.kind) {
+      case RunKindTwoByte: return encoded_length / 2;
+      case RunKindThreeByte: return encoded_length / 3;
+      default: return encoded_length / 4 * 2;
+    }
+  } else {
+    return run.kind == RunKindSurrogate ? 2 * encoded_length : encoded_length;
+  }
+}
+
+void PositionIndex::Scan(const uint16_t *units, uint32_t length, uint32_t offset,
+                         vector<Run> *runs, vector<uint32_t> *line_starts) const {
+  for (uint32_t i = 0; i < length; i++) {
+    uint16_t unit = units[i];
+    if (unit < 0x80) {
+      if (unit == '\n') line_starts->push_back(offset + i + 1);
+      continue;
+    }
+
+    RunKind kind;
+    if (unit < 0x800) {
+      kind = RunKindTwoByte;
+    } else if (unit >= 0xD800 && unit < 0xE000) {
+      kind = RunKindSurrogate;
+    } else {
+      kind = RunKindThreeByte;
+    }
+
+    uint32_t run_start = i;
+    while (i + 1 < length) {
+      uint16_t next = units[i + 1];
+      RunKind next_kind;
+      if (next < 0x80) break;
+      if (next < 0x800) {
+        next_kind = RunKindTwoByte;
+      } else if (next >= 0xD800 && next < 0xE000) {
+        next_kind = RunKindSurrogate;
+      } else {
+        next_kind = RunKindThreeByte;
+      }
+      if (next_kind != kind) break;
+      i++;
+    }
+
+    push_run(runs, Run{offset + run_start, 0, i + 1 - run_start, kind});
+  }
+}
+
+void PositionIndex::UpdateEncodedStarts(size_t index) {
+  for (size_t i = index, n = runs_.size(); i < n; i++) {
+    Run &run = runs_[i];
+    if (i == 0) {
+      run.encoded_start = run.start;
+    } else {
+      const Run &previous = runs_[i - 1];
+      run.encoded_start =
+        previous.encoded_start +
+        EncodedLength(previous, previous.length) +
+        (run.start - previous.start - previous.length);
+    }
+  }
+}
+
+void PositionIndex::Append(const uint16_t *units, uint32_t length) {
+  size_t first_changed_run = runs_.empty() ? 0 : runs_.size() - 1;
+  Scan(units, length, length_, &runs_, &line_starts_);
+  UpdateEncodedStarts(first_changed_run);
+  length_ += length;
+}
+
+void PositionIndex::Edit(uint32_t start, uint32_t old_end, const uint16_t *units, uint32_t length) {
+  if (start > length_) start = length_;
+  if (old_end > length_) old_end = length_;
+  if (old_end < start) old_end = start;
+  uint32_t new_end = start + length;
+
+  vector<Run> inserted_runs;
+  vector<uint32_t> inserted_line_starts;
+  Scan(units, length, start, &inserted_runs, &inserted_line_starts);
+
+  // Runs that end before the edit are unchanged, runs that begin after it
+  // are shifted, and runs that overlap it are clipped to its boundaries.
+  vector<Run> runs;
+  runs.reserve(runs_.size() + inserted_runs.size() + 1);
+  Run tail = {0, 0, 0, RunKindTwoByte};
+  size_t i = 0, n = runs_.size();
+  for (; i < n && runs_[i].start < start; i++) {
+    Run run = runs_[i];
+    uint32_t run_end = run.start + run.length;
+    if (run_end > old_end) {
+      tail = Run{new_end, 0, run_end - old_end, run.kind};
+    }
+    if (run_end > start) run.length = start - run.start;
+    push_run(&runs, run);
+  }
+  size_t first_changed_run = runs.empty() ? 0 : runs.size() - 1;
+  for (const Run &run : inserted_runs) push_run(&runs, run);
+  push_run(&runs, tail);
+  for (; i < n; i++) {
+    Run run = runs_[i];
+    uint32_t run_end = run.start + run.length;
+    if (run_end <= old_end) continue;
+    if (run.start < old_end) {
+      run.length = run_end - old_end;
+      run.start = old_end;
+    }
+    run.start = run.start - old_end + new_end;
+    push_run(&runs, run);
+  }
+  runs_.swap(runs);
+  UpdateEncodedStarts(first_changed_run);
+
+  // Line starts are the offsets just after each newline character.
+  auto first_removed = std::upper_bound(line_starts_.begin(), line_starts_.end(), start);
+  auto first_kept = std::upper_bound(first_removed, line_starts_.end(), old_end);
+  for (auto iter = first_kept; iter != line_starts_.end(); ++iter) {
+    *iter = *iter - old_end + new_end;
+  }
+  auto insertion_point = line_starts_.erase(first_removed, first_kept);
+  line_starts_.insert(insertion_point, inserted_line_starts.begin(), inserted_line_starts.end());
+
+  length_ = length_ - (old_end - start) + length;
+}
+
+uint32_t PositionIndex::FromUTF16(uint32_t offset) const {
+  auto iter = std::upper_bound(
+    runs_.begin(), runs_.end(), offset,
+    [](uint32_t value, const Run &run) { return value < run.start; }
+  );
+  if (iter == runs_.begin()) return offset;
+  const Run &run = *(iter - 1);
+  uint32_t run_offset = std::min(offset - run.start, run.length);
+  return run.encoded_start + EncodedLength(run, run_offset) + (offset - run.start - run_offset);
+}
+
+uint32_t PositionIndex::ToUTF16(uint32_t encoded_offset) const {
+  auto iter = std::upper_bound(
+    runs_.begin(), runs_.end(), encoded_offset,
+    [](uint32_t value, const Run &run) { return value < run.encoded_start; }
+  );
+  if (iter == runs_.begin()) return encoded_offset;
+  const Run &run = *(iter - 1);
+  uint32_t run_offset = encoded_offset - run.encoded_start;
+  uint32_t run_encoded_length = EncodedLength(run, run.length);
+  if (run_offset >= run_encoded_length) {
+    return run.start + run.length + (run_offset - run_encoded_length);
+  }
+  return run.start + DecodedLength(run, run_offset);
+}
+
+uint32_t PositionIndex::LineStart(uint32_t row) const {
+  if (row >= line_starts_.size()) return length_;
+  return line_starts_[row];
+}
+
+}  // namespace node_tree_sitter
@@ -0,0 +1,64 @@
+#ifndef NODE_TREE_SITTER_POSITION_INDEX_H_
+#define NODE_TREE_SITTER_POSITION_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace node_tree_sitter {
+
+// Tree-sitter works in UTF-16 bytes, because that is the encoding of the
+// text that we pass it. Offsets in the other encodings are numbered in the
+// encoding's own code units.
+enum PositionEncoding {
+  PositionEncodingUTF8 = 8,
+  PositionEncodingUTF16 = 16,
+  PositionEncodingUTF32 = 32,
+};
+
+// Maps between UTF-16 offsets and offsets in another encoding. Only the
+// runs of non-ASCII text and the starts of lines are stored, so the index
+// stays small for mostly-ASCII source code and can be kept up to date by
+// replaying edits rather than by rescanning the whole text.
+class PositionIndex {
+ public:
+  explicit PositionIndex(PositionEncoding);
+
+  PositionEncoding encoding() const { return encoding_; }
+  uint32_t length() const { return length_; }
+
+  void Append(const uint16_t *, uint32_t);
+  void Edit(uint32_t start, uint32_t old_end, const uint16_t *, uint32_t);
+
+  uint32_t FromUTF16(uint32_t) const;
+  uint32_t ToUTF16(uint32_t) const;
+  uint32_t LineStart(uint32_t row) const;
+
+  enum RunKind : uint8_t {
+    RunKindTwoByte,
+    RunKindThreeByte,
+    RunKindSurrogate,
+  };
+
+  struct Run {
+    uint32_t start;
+    uint32_t encoded_start;
+    uint32_t length;
+    RunKind kind;
+  };
+
+ private:
+  uint32_t EncodedLength(const Run &, uint32_t) const;
+  uint32_t DecodedLength(const Run &, uint32_t) const;
+  void Scan(const uint16_t *, uint32_t, uint32_t, std::vector<Run> *, std::vector<uint32_t> *) const;
+  void UpdateEncodedStarts(size_t);
+
+  PositionEncoding encoding_;
+  uint32_t length_;
+  std::vector<Run> runs_;
+  std::vector<uint32_t> line_starts_;
+};
+
+}  // namespace node_tree_sitter
+
+#endif  // NODE_TREE_SITTER_POSITION_INDEX_H_
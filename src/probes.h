@@ -0,0 +1,57 @@
+#ifndef NODE_TREE_SITTER_PROBES_H_
+#define NODE_TREE_SITTER_PROBES_H_
+
+// USDT probes, which tracers such as bpftrace and perf can attach to in a
+// running process. For example:
+//
+//   bpftrace -e 'usdt:build/Release/tree_sitter_runtime_binding.node:node_tree_sitter:parse__done
+//     { @bytes[str(arg1)] = hist(arg2); }'
+//
+// Until a tracer attaches, each probe is a single `nop` instruction whose
+// arguments are already in registers. Probes are only compiled on Linux when
+// systemtap's <sys/sdt.h> is installed, and can be disabled by defining
+// NODE_TREE_SITTER_DISABLE_PROBES.
+//
+// Probes and their arguments:
+//
+//   parse__start(parser, language)
+//   parse__done(parser, language, byte_count, duration_ns, incremental)
+//   query__start(query, pattern_count)
+//   query__done(query, captures, result_count, node_count)
+//   marshal(node_count, cache_hit_count, transfer_buffer_bytes)
+//   tree__delete(tree, cached_node_count)
+
+#if defined(__linux__) && defined(__has_include) && !defined(NODE_TREE_SITTER_DISABLE_PROBES)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define NODE_TREE_SITTER_HAVE_PROBES 1
+#endif
+#endif
+
+#ifdef NODE_TREE_SITTER_HAVE_PROBES
+
+#define PROBE_PARSE_START(parser, language) \
+  STAP_PROBE2(node_tree_sitter, parse__start, parser, language)
+#define PROBE_PARSE_DONE(parser, language, byte_count, duration_ns, incremental) \
+  STAP_PROBE5(node_tree_sitter, parse__done, parser, language, byte_count, duration_ns, incremental)
+#define PROBE_QUERY_START(query, pattern_count) \
+  STAP_PROBE2(node_tree_sitter, query__start, query, pattern_count)
+#define PROBE_QUERY_DONE(query, captures, result_count, node_count) \
+  STAP_PROBE4(node_tree_sitter, query__done, query, captures, result_count, node_count)
+#define PROBE_MARSHAL(node_count, cache_hit_count, transfer_buffer_bytes) \
+  STAP_PROBE3(node_tree_sitter, marshal, node_count, cache_hit_count, transfer_buffer_bytes)
+#define PROBE_TREE_DELETE(tree, cached_node_count) \
+  STAP_PROBE2(node_tree_sitter, tree__delete, tree, cached_node_count)
+
+#else
+
+#define PROBE_PARSE_START(parser, language)
+#define PROBE_PARSE_DONE(parser, language, byte_count, duration_ns, incremental)
+#define PROBE_QUERY_START(query, pattern_count)
+#define PROBE_QUERY_DONE(query, captures, result_count, node_count)
+#define PROBE_MARSHAL(node_count, cache_hit_count, transfer_buffer_bytes)
+#define PROBE_TREE_DELETE(tree, cached_node_count)
+
+#endif
+
+#endif  // NODE_TREE_SITTER_PROBES_H_
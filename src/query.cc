@@ -1,13 +1,20 @@
 #include "./query.h"
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <v8.h>
 #include <nan.h>
+#include <uv.h>
 #include "./node.h"
 #include "./language.h"
 #include "./logger.h"
 #include "./util.h"
 #include "./conversions.h"
+#include "./metrics.h"
+#include "./probes.h"
+#include "./rewrite.h"
+#include "./slow_log.h"
+#include "./trace_events.h"
 
 namespace node_tree_sitter {
 
@@ -40,11 +47,10 @@ void Query::Init(Local<Object> exports) {
     {"_matches", Matches},
     {"_captures", Captures},
     {"_getPredicates", GetPredicates},
+    {"_rewrite", Rewrite},
   };
 
-  for (size_t i = 0; i < length_of_array(methods); i++) {
-    Nan::SetPrototypeMethod(tpl, methods[i].name, methods[i].callback);
-  }
+  metrics::SetPrototypeMethods(tpl, "Query", methods, length_of_array(methods));
 
   Local<Function> ctor = Nan::GetFunction(tpl).ToLocalChecked();
 
@@ -134,6 +140,14 @@ void Query::New(const Nan::FunctionCallbackInfo<Value> &info) {
   Query *query_wrapper = new Query(query);
   query_wrapper->Wrap(self);
 
+  Local<Value> language_name;
+  if (
+    Nan::Get(info[0].As<Object>(), Nan::New("name").ToLocalChecked()).ToLocal(&language_name) &&
+    language_name->IsString()
+  ) {
+    query_wrapper->language_name_ = *Nan::Utf8String(language_name);
+  }
+
   auto init =
     Nan::To<Function>(
       Nan::Get(self, Nan::New<String>("_init").ToLocalChecked()).ToLocalChecked()
@@ -196,13 +210,38 @@ void Query::GetPredicates(const Nan::FunctionCallbackInfo<Value> &info) {
   info.GetReturnValue().Set(js_predicates);
 }
 
+// Queries are only timed while the slow log is enabled. The number of
+// results for each pattern is counted at the same time, so that slow queries
+// can be attributed to their patterns.
+static void record_slow_query(slow_log::Operation operation, const char *method_name,
+                              const Query *query, TSNode root_node, uint64_t start_time,
+                              uint32_t result_count, uint32_t node_count,
+                              const vector<uint32_t> &pattern_result_counts) {
+  uint64_t duration = uv_hrtime() - start_time;
+  if (!slow_log::IsSlowQuery(duration)) return;
+
+  slow_log::Entry entry;
+  entry.operation = operation;
+  entry.method_name = method_name;
+  entry.language = query->language_name_;
+  entry.duration = duration;
+  entry.byte_count = ts_node_end_byte(root_node) - ts_node_start_byte(root_node);
+  entry.changed_byte_count = 0;
+  entry.result_count = result_count;
+  entry.node_count = node_count;
+  for (uint32_t i = 0; i < pattern_result_counts.size(); i++) {
+    if (pattern_result_counts[i] > 0) entry.pattern_result_counts.push_back({i, pattern_result_counts[i]});
+  }
+  slow_log::Record(std::move(entry));
+}
+
 void Query::Matches(const Nan::FunctionCallbackInfo<Value> &info) {
   Query *query = Query::UnwrapQuery(info.This());
   const Tree *tree = Tree::UnwrapTree(info[0]);
   uint32_t start_row    = Nan::To<uint32_t>(info[1]).ToChecked();
-  uint32_t start_column = Nan::To<uint32_t>(info[2]).ToChecked() << 1;
+  uint32_t start_column = Nan::To<uint32_t>(info[2]).ToChecked();
   uint32_t end_row      = Nan::To<uint32_t>(info[3]).ToChecked();
-  uint32_t end_column   = Nan::To<uint32_t>(info[4]).ToChecked() << 1;
+  uint32_t end_column   = Nan::To<uint32_t>(info[4]).ToChecked();
 
   if (query == nullptr) {
     Nan::ThrowError("Missing argument query");
@@ -216,8 +255,13 @@ void Query::Matches(const Nan::FunctionCallbackInfo<Value> &info) {
 
   TSQuery *ts_query = query->query_;
   TSNode rootNode = node_methods::UnmarshalNode(tree);
-  TSPoint start_point = {start_row, start_column};
-  TSPoint end_point = {end_row, end_column};
+  TSPoint start_point = PointFromRowAndColumn(start_row, start_column, tree->position_index());
+  TSPoint end_point = PointFromRowAndColumn(end_row, end_column, tree->position_index());
+  trace_events::Span span(trace_events::CategoryQuery, "Query.matches");
+  uint64_t slow_log_start_time = slow_log::IsEnabled() ? uv_hrtime() : 0;
+  vector<uint32_t> pattern_result_counts;
+  if (slow_log_start_time) pattern_result_counts.resize(ts_query_pattern_count(ts_query));
+  PROBE_QUERY_START(ts_query, ts_query_pattern_count(ts_query));
   ts_query_cursor_set_point_range(ts_query_cursor, start_point, end_point);
   ts_query_cursor_exec(ts_query_cursor, ts_query, rootNode);
 
@@ -226,7 +270,10 @@ void Query::Matches(const Nan::FunctionCallbackInfo<Value> &info) {
   vector<TSNode> nodes;
   TSQueryMatch match;
 
+  uint32_t match_count = 0;
   while (ts_query_cursor_next_match(ts_query_cursor, &match)) {
+    match_count++;
+    if (slow_log_start_time) pattern_result_counts[match.pattern_index]++;
     Nan::Set(js_matches, index++, Nan::New(match.pattern_index));
 
     for (uint16_t i = 0; i < match.capture_count; i++) {
@@ -244,7 +291,19 @@ void Query::Matches(const Nan::FunctionCallbackInfo<Value> &info) {
     }
   }
 
+  metrics::Add(metrics::QueryMatches, match_count);
+  PROBE_QUERY_DONE(ts_query, 0, match_count, nodes.size());
+  if (span.enabled()) {
+    span.AddArg("patternCount", ts_query_pattern_count(ts_query));
+    span.AddArg("matchCount", match_count);
+    span.AddArg("nodeCount", nodes.size());
+  }
+
   auto js_nodes = node_methods::GetMarshalNodes(info, tree, nodes.data(), nodes.size());
+  if (slow_log_start_time) {
+    record_slow_query(slow_log::OperationQueryMatches, "Query.matches", query, rootNode,
+                      slow_log_start_time, match_count, nodes.size(), pattern_result_counts);
+  }
 
   auto result = Nan::New<Array>();
   Nan::Set(result, 0, js_matches);
@@ -256,9 +315,9 @@ void Query::Captures(const Nan::FunctionCallbackInfo<Value> &info) {
   Query *query = Query::UnwrapQuery(info.This());
   const Tree *tree = Tree::UnwrapTree(info[0]);
   uint32_t start_row    = Nan::To<uint32_t>(info[1]).ToChecked();
-  uint32_t start_column = Nan::To<uint32_t>(info[2]).ToChecked() << 1;
+  uint32_t start_column = Nan::To<uint32_t>(info[2]).ToChecked();
   uint32_t end_row      = Nan::To<uint32_t>(info[3]).ToChecked();
-  uint32_t end_column   = Nan::To<uint32_t>(info[4]).ToChecked() << 1;
+  uint32_t end_column   = Nan::To<uint32_t>(info[4]).ToChecked();
 
   if (query == nullptr) {
     Nan::ThrowError("Missing argument query");
@@ -272,8 +331,13 @@ void Query::Captures(const Nan::FunctionCallbackInfo<Value> &info) {
 
   TSQuery *ts_query = query->query_;
   TSNode rootNode = node_methods::UnmarshalNode(tree);
-  TSPoint start_point = {start_row, start_column};
-  TSPoint end_point = {end_row, end_column};
+  TSPoint start_point = PointFromRowAndColumn(start_row, start_column, tree->position_index());
+  TSPoint end_point = PointFromRowAndColumn(end_row, end_column, tree->position_index());
+  trace_events::Span span(trace_events::CategoryQuery, "Query.captures");
+  uint64_t slow_log_start_time = slow_log::IsEnabled() ? uv_hrtime() : 0;
+  vector<uint32_t> pattern_result_counts;
+  if (slow_log_start_time) pattern_result_counts.resize(ts_query_pattern_count(ts_query));
+  PROBE_QUERY_START(ts_query, ts_query_pattern_count(ts_query));
   ts_query_cursor_set_point_range(ts_query_cursor, start_point, end_point);
   ts_query_cursor_exec(ts_query_cursor, ts_query, rootNode);
 
@@ -282,13 +346,15 @@ void Query::Captures(const Nan::FunctionCallbackInfo<Value> &info) {
   vector<TSNode> nodes;
   TSQueryMatch match;
   uint32_t capture_index;
+  uint32_t capture_count = 0;
 
   while (ts_query_cursor_next_capture(
     ts_query_cursor,
     &match,
     &capture_index
   )) {
-
+    capture_count++;
+    if (slow_log_start_time) pattern_result_counts[match.pattern_index]++;
     Nan::Set(js_matches, index++, Nan::New(match.pattern_index));
     Nan::Set(js_matches, index++, Nan::New(capture_index));
 
@@ -307,7 +373,19 @@ void Query::Captures(const Nan::FunctionCallbackInfo<Value> &info) {
     }
   }
 
+  metrics::Add(metrics::QueryCaptures, capture_count);
+  PROBE_QUERY_DONE(ts_query, 1, capture_count, nodes.size());
+  if (span.enabled()) {
+    span.AddArg("patternCount", ts_query_pattern_count(ts_query));
+    span.AddArg("captureCount", capture_count);
+    span.AddArg("nodeCount", nodes.size());
+  }
+
   auto js_nodes = node_methods::GetMarshalNodes(info, tree, nodes.data(), nodes.size());
+  if (slow_log_start_time) {
+    record_slow_query(slow_log::OperationQueryCaptures, "Query.captures", query, rootNode,
+                      slow_log_start_time, capture_count, nodes.size(), pattern_result_counts);
+  }
 
   auto result = Nan::New<Array>();
   Nan::Set(result, 0, js_matches);
@@ -315,5 +393,256 @@ void Query::Captures(const Nan::FunctionCallbackInfo<Value> &info) {
   info.GetReturnValue().Set(result);
 }
 
+// The predicates that compare the text of captures are evaluated natively
+// during rewrites. `#match?` predicates are passed as functions that test a
+// capture's text, so that they use JavaScript's regular expressions.
+enum RewritePredicateKind {
+  RewritePredicateEqString,
+  RewritePredicateEqCapture,
+  RewritePredicateMatch,
+};
+
+struct RewritePredicate {
+  RewritePredicateKind kind;
+  bool is_positive;
+  uint32_t capture_id;
+  uint32_t other_capture_id;
+  vector<uint16_t> value;
+  Local<Function> test;
+};
+
+struct RewriteMatch {
+  uint32_t pattern_index;
+  vector<rewrite::Range> capture_ranges;
+  vector<bool> has_capture;
+};
+
+static uint32_t capture_id_for_name(TSQuery *query, const std::string &name) {
+  for (uint32_t id = 0, n = ts_query_capture_count(query); id < n; id++) {
+    uint32_t length;
+    const char *capture_name = ts_query_capture_name_for_id(query, id, &length);
+    if (name.size() == length && name.compare(0, length, capture_name, length) == 0) return id;
+  }
+  return UINT32_MAX;
+}
+
+static bool evaluate_rewrite_predicate(const RewritePredicate &predicate, const RewriteMatch &match,
+                                       const vector<uint16_t> &source) {
+  if (!match.has_capture[predicate.capture_id]) return false;
+  const rewrite::Range &range = match.capture_ranges[predicate.capture_id];
+  auto begin = source.begin() + range.start;
+  auto end = source.begin() + range.end;
+
+  switch (predicate.kind) {
+    case RewritePredicateEqString:
+      return (
+        predicate.value.size() == range.end - range.start &&
+        std::equal(begin, end, predicate.value.begin())
+      ) == predicate.is_positive;
+
+    case RewritePredicateEqCapture: {
+      if (!match.has_capture[predicate.other_capture_id]) return false;
+      const rewrite::Range &other_range = match.capture_ranges[predicate.other_capture_id];
+      return (
+        other_range.end - other_range.start == range.end - range.start &&
+        std::equal(begin, end, source.begin() + other_range.start)
+      ) == predicate.is_positive;
+    }
+
+    case RewritePredicateMatch: {
+      Local<Value> text = Nan::New<String>(source.data() + range.start, range.end - range.start).ToLocalChecked();
+      Local<Value> result;
+      if (!Nan::Call(predicate.test, Nan::GetCurrentContext()->Global(), 1, &text).ToLocal(&result)) return false;
+      return Nan::To<bool>(result).FromMaybe(false) == predicate.is_positive;
+    }
+  }
+
+  return false;
+}
+
+// Rewrites return the new text, the positions of the edits as a flat array
+// with nine fields per edit (the index, row and column of the start, old end
+// and new end), and the edits' new text.
+void Query::Rewrite(const Nan::FunctionCallbackInfo<Value> &info) {
+  Query *query = Query::UnwrapQuery(info.This());
+  const Tree *tree = Tree::UnwrapTree(info[0]);
+  if (tree == nullptr) {
+    Nan::ThrowTypeError("First argument must be a tree");
+    return;
+  }
+
+  if (!info[1]->IsObject()) {
+    Nan::ThrowTypeError("Templates must be an object mapping capture names to strings");
+    return;
+  }
+
+  if (!info[2]->IsString()) {
+    Nan::ThrowTypeError("Source must be a string");
+    return;
+  }
+
+  TSQuery *ts_query = query->query_;
+  uint32_t capture_count = ts_query_capture_count(ts_query);
+  vector<vector<uint16_t>> capture_names(capture_count);
+  for (uint32_t id = 0; id < capture_count; id++) {
+    uint32_t length;
+    const char *name = ts_query_capture_name_for_id(ts_query, id, &length);
+    capture_names[id] = UTF16FromJS(Nan::New<String>(name, length).ToLocalChecked());
+  }
+
+  Local<Object> js_templates = Local<Object>::Cast(info[1]);
+  Local<Array> js_template_names = Nan::GetOwnPropertyNames(js_templates).ToLocalChecked();
+  vector<rewrite::Template> templates(capture_count);
+  vector<bool> has_template(capture_count);
+  for (uint32_t i = 0, n = js_template_names->Length(); i < n; i++) {
+    Local<Value> js_name = Nan::Get(js_template_names, i).ToLocalChecked();
+    std::string name = *Nan::Utf8String(js_name);
+    uint32_t capture_id = capture_id_for_name(ts_query, name);
+    if (capture_id == UINT32_MAX) {
+      Nan::ThrowTypeError(("The query has no capture named @" + name).c_str());
+      return;
+    }
+
+    Local<Value> js_template = Nan::Get(js_templates, js_name).ToLocalChecked();
+    if (!js_template->IsString()) {
+      Nan::ThrowTypeError(("The template for @" + name + " must be a string").c_str());
+      return;
+    }
+
+    std::string error;
+    if (!templates[capture_id].Compile(UTF16FromJS(Local<String>::Cast(js_template)), capture_names, &error)) {
+      Nan::ThrowTypeError((error + " in the template for @" + name).c_str());
+      return;
+    }
+    has_template[capture_id] = true;
+  }
+
+  vector<vector<RewritePredicate>> predicates(ts_query_pattern_count(ts_query));
+  if (info[3]->IsArray()) {
+    Local<Array> js_predicates = Local<Array>::Cast(info[3]);
+    for (uint32_t i = 0; i + 4 < js_predicates->Length(); i += 5) {
+      RewritePredicate predicate;
+      uint32_t pattern_index = Nan::To<uint32_t>(Nan::Get(js_predicates, i).ToLocalChecked()).FromJust();
+      predicate.kind = static_cast<RewritePredicateKind>(
+        Nan::To<uint32_t>(Nan::Get(js_predicates, i + 1).ToLocalChecked()).FromJust()
+      );
+      predicate.is_positive = Nan::To<bool>(Nan::Get(js_predicates, i + 2).ToLocalChecked()).FromJust();
+      predicate.capture_id = capture_id_for_name(
+        ts_query, *Nan::Utf8String(Nan::Get(js_predicates, i + 3).ToLocalChecked())
+      );
+
+      Local<Value> js_value = Nan::Get(js_predicates, i + 4).ToLocalChecked();
+      if (predicate.kind == RewritePredicateEqCapture) {
+        predicate.other_capture_id = capture_id_for_name(ts_query, *Nan::Utf8String(js_value));
+      } else if (predicate.kind == RewritePredicateMatch) {
+        predicate.test = Local<Function>::Cast(js_value);
+      } else {
+        predicate.value = UTF16FromJS(Local<String>::Cast(js_value));
+      }
+
+      if (
+        pattern_index >= predicates.size() ||
+        predicate.capture_id == UINT32_MAX ||
+        (predicate.kind == RewritePredicateEqCapture && predicate.other_capture_id == UINT32_MAX)
+      ) {
+        Nan::ThrowTypeError("Invalid rewrite predicate");
+        return;
+      }
+      predicates[pattern_index].push_back(predicate);
+    }
+  }
+
+  vector<uint16_t> source = UTF16FromJS(Local<String>::Cast(info[2]));
+  trace_events::Span span(trace_events::CategoryQuery, "Query.rewrite");
+
+  // Matches are collected before their predicates are evaluated, because
+  // evaluating `#match?` predicates runs JavaScript, which could use the
+  // shared query cursor.
+  vector<RewriteMatch> matches;
+  TSQueryMatch match;
+  uint32_t match_count = 0;
+  ts_query_cursor_set_byte_range(ts_query_cursor, 0, UINT32_MAX);
+  ts_query_cursor_set_point_range(ts_query_cursor, {0, 0}, {UINT32_MAX, UINT32_MAX});
+  ts_query_cursor_exec(ts_query_cursor, ts_query, ts_tree_root_node(tree->tree_));
+  while (ts_query_cursor_next_match(ts_query_cursor, &match)) {
+    match_count++;
+    RewriteMatch rewrite_match;
+    rewrite_match.pattern_index = match.pattern_index;
+    rewrite_match.capture_ranges.resize(capture_count, {0, 0});
+    rewrite_match.has_capture.resize(capture_count);
+
+    bool has_replacement = false;
+    for (uint16_t i = 0; i < match.capture_count; i++) {
+      const TSQueryCapture &capture = match.captures[i];
+      uint32_t start = std::min<uint32_t>(ts_node_start_byte(capture.node) / 2, source.size());
+      uint32_t end = std::min<uint32_t>(ts_node_end_byte(capture.node) / 2, source.size());
+      rewrite::Range &range = rewrite_match.capture_ranges[capture.index];
+      if (rewrite_match.has_capture[capture.index]) {
+        range.start = std::min(range.start, start);
+        range.end = std::max(range.end, end);
+      } else {
+        range = {start, end};
+        rewrite_match.has_capture[capture.index] = true;
+      }
+      if (has_template[capture.index]) has_replacement = true;
+    }
+
+    if (has_replacement) matches.push_back(std::move(rewrite_match));
+  }
+  metrics::Add(metrics::QueryMatches, match_count);
+
+  vector<rewrite::Edit> edits;
+  for (const RewriteMatch &rewrite_match : matches) {
+    bool is_match = true;
+    for (const RewritePredicate &predicate : predicates[rewrite_match.pattern_index]) {
+      if (!evaluate_rewrite_predicate(predicate, rewrite_match, source)) {
+        is_match = false;
+        break;
+      }
+    }
+    if (!is_match) continue;
+
+    for (uint32_t id = 0; id < capture_count; id++) {
+      if (!has_template[id] || !rewrite_match.has_capture[id]) continue;
+      const rewrite::Range &range = rewrite_match.capture_ranges[id];
+      rewrite::Edit edit = {range.start, range.end, {}};
+      templates[id].Expand(source.data(), rewrite_match.capture_ranges, &edit.text);
+      edits.push_back(std::move(edit));
+    }
+  }
+
+  rewrite::RemoveOverlappingEdits(&edits);
+  vector<uint16_t> new_source = rewrite::ApplyEdits(source.data(), source.size(), edits);
+
+  const PositionIndex *position_index = tree->position_index();
+  PositionEncoding encoding = position_index ? position_index->encoding() : PositionEncodingUTF16;
+  vector<rewrite::EditPositions> positions = rewrite::GetEditPositions(
+    source.data(), source.size(), edits, encoding
+  );
+
+  vector<uint32_t> edit_data;
+  edit_data.reserve(9 * edits.size());
+  Local<Array> js_edit_texts = Nan::New<Array>(edits.size());
+  for (size_t i = 0; i < edits.size(); i++) {
+    for (const rewrite::Position &position : {positions[i].start, positions[i].old_end, positions[i].new_end}) {
+      edit_data.push_back(position.index);
+      edit_data.push_back(position.row);
+      edit_data.push_back(position.column);
+    }
+    Nan::Set(js_edit_texts, i, Nan::New<String>(edits[i].text.data(), edits[i].text.size()).ToLocalChecked());
+  }
+
+  if (span.enabled()) {
+    span.AddArg("patternCount", ts_query_pattern_count(ts_query));
+    span.AddArg("matchCount", match_count);
+    span.AddArg("editCount", edits.size());
+  }
+
+  Local<Array> result = Nan::New<Array>(3);
+  Nan::Set(result, 0, Nan::New<String>(new_source.data(), new_source.size()).ToLocalChecked());
+  Nan::Set(result, 1, typed_array_from_vector<uint32_t, Uint32Array>(edit_data));
+  Nan::Set(result, 2, js_edit_texts);
+  info.GetReturnValue().Set(result);
+}
 
 }  // namespace node_tree_sitter
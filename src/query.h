@@ -4,6 +4,7 @@
 #include <v8.h>
 #include <nan.h>
 #include <node_object_wrap.h>
+#include <string>
 #include <unordered_map>
 #include <tree_sitter/api.h>
 
@@ -16,6 +17,7 @@ class Query : public Nan::ObjectWrap {
   static Query *UnwrapQuery(const v8::Local<v8::Value> &);
 
   TSQuery *query_;
+  std::string language_name_;
 
  private:
   explicit Query(TSQuery *);
@@ -25,6 +27,7 @@ class Query : public Nan::ObjectWrap {
   static void Matches(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void Captures(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void GetPredicates(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void Rewrite(const Nan::FunctionCallbackInfo<v8::Value> &);
 
   static TSQueryCursor *ts_query_cursor;
   static Nan::Persistent<v8::Function> constructor;
@@ -0,0 +1,334 @@
+#include "./range_index.h"
+#include <stdlib.h>
+#include <vector>
+#include <v8.h>
+#include <nan.h>
+#include "./conversions.h"
+#include "./metrics.h"
+#include "./util.h"
+
+namespace node_tree_sitter {
+
+using std::vector;
+using namespace v8;
+using node_methods::SymbolSet;
+
+Nan::Persistent<Function> RangeIndex::constructor;
+
+static TSTreeCursor scratch_cursor = {nullptr, nullptr, {0, 0}};
+static const TSNode null_node = {{0, 0, 0, 0}, nullptr, nullptr};
+
+// Once this many edits are waiting to be applied to the stored nodes, the
+// nodes are found again instead, so that the edits don't accumulate.
+static const size_t MAX_PENDING_EDITS = 1024;
+
+static inline bool overlaps(uint32_t start, uint32_t end, uint32_t query_start, uint32_t query_end) {
+  if (start == end || query_start == query_end) {
+    return start <= query_end && end >= query_start;
+  }
+  return start < query_end && end > query_start;
+}
+
+void RangeIndex::Init(Local<Object> exports) {
+  Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
+  tpl->InstanceTemplate()->SetInternalFieldCount(1);
+  Local<String> class_name = Nan::New("RangeIndex").ToLocalChecked();
+  tpl->SetClassName(class_name);
+
+  FunctionPair methods[] = {
+    {"_overlapping", Overlapping},
+    {"_containing", Containing},
+    {"_within", Within},
+    {"_update", Update},
+    {"_size", Size},
+  };
+
+  metrics::SetPrototypeMethods(tpl, "RangeIndex", methods, length_of_array(methods));
+
+  Local<Function> ctor = Nan::GetFunction(tpl).ToLocalChecked();
+
+  constructor.Reset(ctor);
+  Nan::Set(exports, class_name, ctor);
+}
+
+RangeIndex::RangeIndex(const Tree *tree, const SymbolSet &symbols) :
+  tree_(tree),
+  symbols_(symbols),
+  generation_(0) {
+  tree_->AddEditObserver(this);
+  IndexNodes(ts_tree_root_node(tree_->tree_), 0, UINT32_MAX, nullptr);
+}
+
+RangeIndex::~RangeIndex() {
+  if (tree_) tree_->RemoveEditObserver(this);
+}
+
+void RangeIndex::TreeEdited(const TSInputEdit &edit) {
+  intervals_.Edit(edit.start_byte, edit.old_end_byte, edit.new_end_byte);
+  if (edits_.size() == MAX_PENDING_EDITS) {
+    generation_++;
+    edits_.clear();
+  }
+  edits_.push_back(edit);
+}
+
+void RangeIndex::TreeDeleted() {
+  tree_ = nullptr;
+}
+
+// Add every node of the indexed types that overlaps the given range, except
+// for those that also overlap the previous range, which were already added.
+void RangeIndex::IndexNodes(TSNode root, uint32_t start, uint32_t end, const TSRange *previous_range) {
+  ts_tree_cursor_reset(&scratch_cursor, root);
+  auto already_visited_children = false;
+  while (true) {
+    TSNode node = ts_tree_cursor_current_node(&scratch_cursor);
+
+    if (!already_visited_children) {
+      uint32_t node_start = ts_node_start_byte(node);
+      uint32_t node_end = ts_node_end_byte(node);
+
+      if (node_end < start) {
+        if (ts_tree_cursor_goto_next_sibling(&scratch_cursor)) {
+          already_visited_children = false;
+        } else {
+          if (!ts_tree_cursor_goto_parent(&scratch_cursor)) break;
+          already_visited_children = true;
+        }
+        continue;
+      }
+
+      if (node_start > end) break;
+
+      if (
+        symbols_.contains(ts_node_symbol(node)) &&
+        overlaps(node_start, node_end, start, end) &&
+        !(previous_range && overlaps(node_start, node_end, previous_range->start_byte, previous_range->end_byte))
+      ) {
+        InsertNode(node, node_start, node_end);
+      }
+
+      if (ts_tree_cursor_goto_first_child(&scratch_cursor)) {
+        already_visited_children = false;
+      } else if (ts_tree_cursor_goto_next_sibling(&scratch_cursor)) {
+        already_visited_children = false;
+      } else {
+        if (!ts_tree_cursor_goto_parent(&scratch_cursor)) break;
+        already_visited_children = true;
+      }
+    } else {
+      if (ts_tree_cursor_goto_next_sibling(&scratch_cursor)) {
+        already_visited_children = false;
+      } else {
+        if (!ts_tree_cursor_goto_parent(&scratch_cursor)) break;
+      }
+    }
+  }
+}
+
+void RangeIndex::InsertNode(TSNode node, uint32_t start, uint32_t end) {
+  uint32_t slot;
+  if (free_slots_.empty()) {
+    slot = nodes_.size();
+    nodes_.push_back(IndexedNode());
+  } else {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+  }
+  nodes_[slot] = {node, ts_node_symbol(node), generation_, static_cast<uint32_t>(edits_.size())};
+  intervals_.Insert(start, end, slot);
+}
+
+void RangeIndex::RemoveNodes(uint32_t start, uint32_t end) {
+  vector<IntervalTree::Entry> removed;
+  intervals_.RemoveOverlapping(start, end, &removed);
+  for (const IntervalTree::Entry &entry : removed) {
+    nodes_[entry.value].node = null_node;
+    free_slots_.push_back(entry.value);
+  }
+}
+
+// Nodes that were stored for the current tree are returned after applying
+// the edits that were made since they were returned last, in the same way
+// as the tree's cached nodes are updated, so a query costs O(log n + k). The
+// others are found in the current tree with a single cursor, which moves
+// forward from each node to the next, because the entries are ordered by
+// their starts.
+void RangeIndex::GetNodes(const vector<IntervalTree::Entry> &entries, vector<TSNode> *nodes) {
+  nodes->reserve(entries.size());
+  bool cursor_is_reset = false;
+  for (const IntervalTree::Entry &entry : entries) {
+    IndexedNode &indexed_node = nodes_[entry.value];
+    if (indexed_node.generation != generation_) {
+      if (!cursor_is_reset) {
+        ts_tree_cursor_reset(&scratch_cursor, ts_tree_root_node(tree_->tree_));
+        cursor_is_reset = true;
+      }
+      indexed_node.node = FindNode(entry, indexed_node.symbol);
+      indexed_node.generation = generation_;
+    } else if (indexed_node.node.id) {
+      for (size_t i = indexed_node.edit_count; i < edits_.size(); i++) {
+        ts_node_edit(&indexed_node.node, &edits_[i]);
+      }
+    }
+    indexed_node.edit_count = edits_.size();
+    if (indexed_node.node.id) nodes->push_back(indexed_node.node);
+  }
+}
+
+static inline bool contains_entry(TSNode node, const IntervalTree::Entry &entry) {
+  return ts_node_start_byte(node) <= entry.start && ts_node_end_byte(node) >= entry.end;
+}
+
+// Move the cursor forward through its current node's siblings to the first
+// one that contains the entry.
+static bool goto_sibling_containing_entry(const IntervalTree::Entry &entry) {
+  do {
+    TSNode node = ts_tree_cursor_current_node(&scratch_cursor);
+    if (ts_node_start_byte(node) > entry.start) return false;
+    if (ts_node_end_byte(node) >= entry.end) return true;
+  } while (ts_tree_cursor_goto_next_sibling(&scratch_cursor));
+  return false;
+}
+
+// Search the nodes below the cursor's node that contain the entry, in
+// document order. Several of them can contain an empty entry at their
+// boundaries, so the search backtracks.
+static TSNode find_node_below_cursor(const IntervalTree::Entry &entry, TSSymbol symbol) {
+  uint32_t depth = 0;
+  bool contains = true;
+  while (true) {
+    if (contains) {
+      TSNode node = ts_tree_cursor_current_node(&scratch_cursor);
+      if (
+        ts_node_start_byte(node) == entry.start &&
+        ts_node_end_byte(node) == entry.end &&
+        ts_node_symbol(node) == symbol
+      ) return node;
+
+      if (ts_tree_cursor_goto_first_child(&scratch_cursor)) {
+        depth++;
+        contains = goto_sibling_containing_entry(entry);
+      } else {
+        contains = false;
+      }
+    } else {
+      if (depth == 0) return null_node;
+      if (ts_tree_cursor_goto_next_sibling(&scratch_cursor) && goto_sibling_containing_entry(entry)) {
+        contains = true;
+      } else {
+        ts_tree_cursor_goto_parent(&scratch_cursor);
+        depth--;
+      }
+    }
+  }
+}
+
+// The cursor is at the previous entry's node, so it first moves to the
+// nearest node that contains this entry, usually a later sibling or an
+// ancestor, and then searches below it.
+TSNode RangeIndex::FindNode(const IntervalTree::Entry &entry, TSSymbol symbol) const {
+  while (true) {
+    TSNode node = ts_tree_cursor_current_node(&scratch_cursor);
+    if (contains_entry(node, entry)) break;
+    if (ts_node_end_byte(node) <= entry.start && ts_tree_cursor_goto_next_sibling(&scratch_cursor)) continue;
+    if (!ts_tree_cursor_goto_parent(&scratch_cursor)) return null_node;
+  }
+
+  TSNode result = find_node_below_cursor(entry, symbol);
+  if (!result.id) {
+    ts_tree_cursor_reset(&scratch_cursor, ts_tree_root_node(tree_->tree_));
+    result = find_node_below_cursor(entry, symbol);
+  }
+  return result;
+}
+
+void RangeIndex::New(const Nan::FunctionCallbackInfo<Value> &info) {
+  if (!info.IsConstructCall()) {
+    Nan::ThrowError("RangeIndex must be called with `new`");
+    return;
+  }
+
+  const Tree *tree = Tree::UnwrapTree(info[0]);
+  if (!tree) {
+    Nan::ThrowTypeError("First argument must be a tree");
+    return;
+  }
+
+  SymbolSet symbols;
+  if (!node_methods::symbol_set_from_js(&symbols, info[1], ts_tree_language(tree->tree_))) return;
+
+  (new RangeIndex(tree, symbols))->Wrap(info.This());
+  info.GetReturnValue().Set(info.This());
+}
+
+#define define_query_method(name, find)                                                  \
+  void RangeIndex::name(const Nan::FunctionCallbackInfo<Value> &info) {                  \
+    RangeIndex *index = ObjectWrap::Unwrap<RangeIndex>(info.This());                     \
+    if (!index->tree_) {                                                                 \
+      Nan::ThrowError("The index's tree has been deleted");                              \
+      return;                                                                            \
+    }                                                                                    \
+                                                                                         \
+    const PositionIndex *position_index = index->tree_->position_index();                \
+    auto maybe_start = ByteCountFromJS(info[0], position_index);                         \
+    if (maybe_start.IsNothing()) return;                                                 \
+    auto maybe_end = ByteCountFromJS(info[1], position_index);                           \
+    if (maybe_end.IsNothing()) return;                                                   \
+                                                                                         \
+    vector<IntervalTree::Entry> entries;                                                 \
+    index->intervals_.find(maybe_start.FromJust(), maybe_end.FromJust(), &entries);      \
+                                                                                         \
+    vector<TSNode> nodes;                                                                \
+    index->GetNodes(entries, &nodes);                                                    \
+                                                                                         \
+    info.GetReturnValue().Set(                                                           \
+      node_methods::GetMarshalNodes(info, index->tree_, nodes.data(), nodes.size())      \
+    );                                                                                   \
+  }
+
+define_query_method(Overlapping, FindOverlapping)
+define_query_method(Containing, FindContaining)
+define_query_method(Within, FindContainedIn)
+
+void RangeIndex::Update(const Nan::FunctionCallbackInfo<Value> &info) {
+  RangeIndex *index = ObjectWrap::Unwrap<RangeIndex>(info.This());
+  const Tree *new_tree = Tree::UnwrapTree(info[0]);
+  if (!new_tree) {
+    Nan::ThrowTypeError("First argument must be a tree");
+    return;
+  }
+
+  if (new_tree == index->tree_) return;
+
+  TSNode root = ts_tree_root_node(new_tree->tree_);
+  index->generation_++;
+  index->edits_.clear();
+  if (index->tree_) {
+    uint32_t range_count;
+    TSRange *ranges = ts_tree_get_changed_ranges(index->tree_->tree_, new_tree->tree_, &range_count);
+    for (uint32_t i = 0; i < range_count; i++) {
+      index->RemoveNodes(ranges[i].start_byte, ranges[i].end_byte);
+    }
+    for (uint32_t i = 0; i < range_count; i++) {
+      index->IndexNodes(root, ranges[i].start_byte, ranges[i].end_byte, i > 0 ? &ranges[i - 1] : nullptr);
+    }
+    free(ranges);
+    index->tree_->RemoveEditObserver(index);
+  } else {
+    index->intervals_.Clear();
+    index->nodes_.clear();
+    index->free_slots_.clear();
+    index->IndexNodes(root, 0, UINT32_MAX, nullptr);
+  }
+
+  index->tree_ = new_tree;
+  new_tree->AddEditObserver(index);
+}
+
+void RangeIndex::Size(const Nan::FunctionCallbackInfo<Value> &info) {
+  RangeIndex *index = ObjectWrap::Unwrap<RangeIndex>(info.This());
+  info.GetReturnValue().Set(Nan::New(index->intervals_.size()));
+}
+
+}  // namespace node_tree_sitter
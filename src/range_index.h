@@ -0,0 +1,68 @@
+#ifndef NODE_TREE_SITTER_RANGE_INDEX_H_
+#define NODE_TREE_SITTER_RANGE_INDEX_H_
+
+#include <v8.h>
+#include <nan.h>
+#include <node_object_wrap.h>
+#include <tree_sitter/api.h>
+#include <vector>
+#include "./interval_tree.h"
+#include "./node.h"
+#include "./tree.h"
+
+namespace node_tree_sitter {
+
+// An index of the ranges of all of the nodes of certain types in a tree,
+// answering range queries without walking the tree. It follows edits to its
+// tree, and can be moved to a newly-parsed tree by reindexing only the
+// changed ranges.
+class RangeIndex : public Nan::ObjectWrap, public TreeEditObserver {
+ public:
+  static void Init(v8::Local<v8::Object> exports);
+
+  void TreeEdited(const TSInputEdit &) override;
+  void TreeDeleted() override;
+
+ private:
+  RangeIndex(const Tree *, const node_methods::SymbolSet &);
+  ~RangeIndex();
+
+  // Each interval's value is the number of a slot that stores its node.
+  // Edits only shift the intervals, and are applied to a stored node when a
+  // query returns it. After the index moves to a new tree, the nodes outside
+  // of the changed ranges still belong to the old tree, so they are found
+  // again in the new tree the first time that a query returns them.
+  struct IndexedNode {
+    TSNode node;
+    TSSymbol symbol;
+    uint32_t generation;
+    uint32_t edit_count;
+  };
+
+  void IndexNodes(TSNode, uint32_t, uint32_t, const TSRange *);
+  void InsertNode(TSNode, uint32_t, uint32_t);
+  void RemoveNodes(uint32_t, uint32_t);
+  void GetNodes(const std::vector<IntervalTree::Entry> &, std::vector<TSNode> *);
+  TSNode FindNode(const IntervalTree::Entry &, TSSymbol) const;
+
+  static void New(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void Overlapping(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void Containing(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void Within(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void Update(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void Size(const Nan::FunctionCallbackInfo<v8::Value> &);
+
+  const Tree *tree_;
+  node_methods::SymbolSet symbols_;
+  IntervalTree intervals_;
+  std::vector<IndexedNode> nodes_;
+  std::vector<uint32_t> free_slots_;
+  uint32_t generation_;
+  std::vector<TSInputEdit> edits_;
+
+  static Nan::Persistent<v8::Function> constructor;
+};
+
+}  // namespace node_tree_sitter
+
+#endif  // NODE_TREE_SITTER_RANGE_INDEX_H_
@@ -0,0 +1,174 @@
+#include "./rewrite.h"
+#include <algorithm>
+
+namespace node_tree_sitter {
+namespace rewrite {
+
+using std::string;
+using std::vector;
+
+bool Template::Compile(const vector<uint16_t> &text, const vector<vector<uint16_t>> &capture_names,
+                       string *error) {
+  parts_.clear();
+  parts_.push_back({{}, NoCapture});
+
+  for (size_t i = 0; i < text.size();) {
+    if (text[i] != '@') {
+      parts_.back().text.push_back(text[i++]);
+      continue;
+    }
+
+    if (i + 1 < text.size() && text[i + 1] == '@') {
+      parts_.back().text.push_back('@');
+      i += 2;
+      continue;
+    }
+
+    uint32_t capture_id = NoCapture;
+    size_t name_length = 0;
+    for (uint32_t id = 0; id < capture_names.size(); id++) {
+      const vector<uint16_t> &name = capture_names[id];
+      if (
+        name.size() > name_length &&
+        i + 1 + name.size() <= text.size() &&
+        std::equal(name.begin(), name.end(), text.begin() + i + 1)
+      ) {
+        capture_id = id;
+        name_length = name.size();
+      }
+    }
+
+    if (capture_id == NoCapture) {
+      *error = "Template refers to an unknown capture at position " + std::to_string(i);
+      return false;
+    }
+
+    parts_.push_back({{}, capture_id});
+    parts_.push_back({{}, NoCapture});
+    i += 1 + name_length;
+  }
+
+  return true;
+}
+
+void Template::Expand(const uint16_t *source, const vector<Range> &capture_ranges, vector<uint16_t> *result) const {
+  for (const Part &part : parts_) {
+    if (part.capture_id == NoCapture) {
+      result->insert(result->end(), part.text.begin(), part.text.end());
+    } else {
+      const Range &range = capture_ranges[part.capture_id];
+      result->insert(result->end(), source + range.start, source + range.end);
+    }
+  }
+}
+
+void RemoveOverlappingEdits(vector<Edit> *edits) {
+  std::stable_sort(edits->begin(), edits->end(), [](const Edit &a, const Edit &b) {
+    return a.start < b.start;
+  });
+
+  size_t kept_count = 0;
+  uint32_t end = 0;
+  for (size_t i = 0; i < edits->size(); i++) {
+    Edit &edit = (*edits)[i];
+    if (kept_count > 0 && edit.start < end) continue;
+    end = edit.old_end;
+    if (kept_count != i) (*edits)[kept_count] = std::move(edit);
+    kept_count++;
+  }
+  edits->resize(kept_count);
+}
+
+vector<uint16_t> ApplyEdits(const uint16_t *source, uint32_t length, const vector<Edit> &edits) {
+  size_t result_length = length;
+  for (const Edit &edit : edits) result_length += edit.text.size() - (edit.old_end - edit.start);
+
+  vector<uint16_t> result;
+  result.reserve(result_length);
+  uint32_t position = 0;
+  for (const Edit &edit : edits) {
+    result.insert(result.end(), source + position, source + edit.start);
+    result.insert(result.end(), edit.text.begin(), edit.text.end());
+    position = edit.old_end;
+  }
+  result.insert(result.end(), source + position, source + length);
+  return result;
+}
+
+uint32_t EncodedLength(const uint16_t *text, uint32_t length, PositionEncoding encoding) {
+  if (encoding == PositionEncodingUTF16) return length;
+
+  uint32_t result = 0;
+  for (uint32_t i = 0; i < length; i++) {
+    uint16_t unit = text[i];
+    bool is_surrogate = unit >= 0xd800 && unit <= 0xdfff;
+    if (encoding == PositionEncodingUTF32) {
+      if (!(unit >= 0xdc00 && unit <= 0xdfff)) result++;
+    } else if (unit < 0x80) {
+      result += 1;
+    } else if (unit < 0x800) {
+      result += 2;
+    } else {
+      result += is_surrogate ? 2 : 3;
+    }
+  }
+  return result;
+}
+
+// The source is scanned once, from the first edit to the last, to find the
+// rows and the starts of the lines.
+vector<EditPositions> GetEditPositions(const uint16_t *source, uint32_t length, const vector<Edit> &edits,
+                                       PositionEncoding encoding) {
+  vector<EditPositions> result;
+  result.reserve(edits.size());
+
+  // The column is advanced along with the offset, and is only measured from
+  // the start of the line when the scan crosses a newline.
+  uint32_t offset = 0, encoded_offset = 0, row = 0, column = 0;
+  auto position_at = [&](uint32_t target) {
+    target = std::min(target, length);
+    uint32_t line_start = offset;
+    bool crossed_newline = false;
+    for (uint32_t i = offset; i < target; i++) {
+      if (source[i] == '\n') {
+        row++;
+        line_start = i + 1;
+        crossed_newline = true;
+      }
+    }
+
+    uint32_t line_length = EncodedLength(source + line_start, target - line_start, encoding);
+    encoded_offset += EncodedLength(source + offset, line_start - offset, encoding) + line_length;
+    column = crossed_newline ? line_length : column + line_length;
+    offset = target;
+    return Position{encoded_offset, row, column};
+  };
+
+  for (const Edit &edit : edits) {
+    EditPositions positions;
+    positions.start = position_at(edit.start);
+    positions.old_end = position_at(edit.old_end);
+
+    const uint16_t *text = edit.text.data();
+    uint32_t text_length = edit.text.size();
+    uint32_t last_line_start = 0, newline_count = 0;
+    for (uint32_t i = 0; i < text_length; i++) {
+      if (text[i] == '\n') {
+        newline_count++;
+        last_line_start = i + 1;
+      }
+    }
+
+    positions.new_end.index = positions.start.index + EncodedLength(text, text_length, encoding);
+    positions.new_end.row = positions.start.row + newline_count;
+    positions.new_end.column = newline_count > 0
+      ? EncodedLength(text + last_line_start, text_length - last_line_start, encoding)
+      : positions.start.column + EncodedLength(text, text_length, encoding);
+    result.push_back(positions);
+  }
+
+  return result;
+}
+
+}  // namespace rewrite
+}  // namespace node_tree_sitter
@@ -0,0 +1,82 @@
+#ifndef NODE_TREE_SITTER_REWRITE_H_
+#define NODE_TREE_SITTER_REWRITE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "./position_index.h"
+
+namespace node_tree_sitter {
+namespace rewrite {
+
+// All offsets are in UTF-16 code units of the source text.
+struct Range {
+  uint32_t start;
+  uint32_t end;
+};
+
+// A replacement for the nodes of one capture. The template's text is copied
+// as is, except for `@name` references to other captures of the same match,
+// which are replaced by the text of those captures, and `@@`, which stands
+// for a single `@`.
+class Template {
+ public:
+  // Each reference is resolved to the longest capture name that it starts
+  // with. Returns false, with a message in `error`, if a reference doesn't
+  // start with any of the names.
+  bool Compile(const std::vector<uint16_t> &text, const std::vector<std::vector<uint16_t>> &capture_names,
+               std::string *error);
+
+  // Captures that aren't part of the match have an empty range.
+  void Expand(const uint16_t *source, const std::vector<Range> &capture_ranges, std::vector<uint16_t> *) const;
+
+ private:
+  static const uint32_t NoCapture = UINT32_MAX;
+
+  struct Part {
+    std::vector<uint16_t> text;
+    uint32_t capture_id;
+  };
+
+  std::vector<Part> parts_;
+};
+
+struct Edit {
+  uint32_t start;
+  uint32_t old_end;
+  std::vector<uint16_t> text;
+};
+
+// Order the edits by their start, and remove those that overlap an earlier
+// one. Edits with the same start keep the order in which they were found.
+void RemoveOverlappingEdits(std::vector<Edit> *);
+
+// Apply non-overlapping edits, ordered by their start, in a single pass.
+std::vector<uint16_t> ApplyEdits(const uint16_t *source, uint32_t length, const std::vector<Edit> &);
+
+// The number of code units that UTF-16 text has in the given encoding.
+uint32_t EncodedLength(const uint16_t *, uint32_t, PositionEncoding);
+
+// Offsets, rows and columns in the given encoding.
+struct Position {
+  uint32_t index;
+  uint32_t row;
+  uint32_t column;
+};
+
+struct EditPositions {
+  Position start;
+  Position old_end;
+  Position new_end;
+};
+
+// The positions of non-overlapping edits, ordered by their start, in the
+// source text. Each edit's new end is relative to its start, so that the
+// edits can be applied to a tree from the last one to the first.
+std::vector<EditPositions> GetEditPositions(const uint16_t *source, uint32_t length,
+                                            const std::vector<Edit> &, PositionEncoding);
+
+}  // namespace rewrite
+}  // namespace node_tree_sitter
+
+#endif  // NODE_TREE_SITTER_REWRITE_H_
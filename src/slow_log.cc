@@ -0,0 +1,155 @@
+#include "./slow_log.h"
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <v8.h>
+#include <nan.h>
+
+namespace node_tree_sitter {
+namespace slow_log {
+
+using std::deque;
+using namespace v8;
+
+std::atomic<uint64_t> parse_threshold(Disabled);
+std::atomic<uint64_t> query_threshold(Disabled);
+
+struct RecordedEntry {
+  Entry entry;
+  double time;
+};
+
+static std::mutex log_mutex;
+static deque<RecordedEntry> entries;
+static size_t capacity = 0;
+static uint32_t dropped_entry_count = 0;
+
+static const char *operation_name(Operation operation) {
+  switch (operation) {
+    case OperationParse: return "parse";
+    case OperationReparse: return "reparse";
+    case OperationQueryMatches: return "matches";
+    case OperationQueryCaptures: return "captures";
+  }
+  return "";
+}
+
+// When the log is full, the oldest entries are discarded.
+void Record(Entry &&entry) {
+  double time = std::chrono::duration<double, std::milli>(
+    std::chrono::system_clock::now().time_since_epoch()
+  ).count();
+
+  std::lock_guard<std::mutex> lock(log_mutex);
+  if (capacity == 0) return;
+  if (entries.size() == capacity) {
+    entries.pop_front();
+    dropped_entry_count++;
+  }
+  entries.push_back({std::move(entry), time});
+}
+
+static uint64_t threshold_from_ms(double ms) {
+  if (!(ms >= 0) || ms * 1e6 >= static_cast<double>(Disabled)) return Disabled;
+  return static_cast<uint64_t>(ms * 1e6);
+}
+
+// Thresholds are given in milliseconds. A negative threshold disables the
+// log for that kind of operation.
+static void SetSlowLog(const Nan::FunctionCallbackInfo<Value> &info) {
+  auto maybe_parse_threshold = Nan::To<double>(info[0]);
+  auto maybe_query_threshold = Nan::To<double>(info[1]);
+  auto maybe_capacity = Nan::To<uint32_t>(info[2]);
+  if (maybe_parse_threshold.IsNothing() || maybe_query_threshold.IsNothing() || maybe_capacity.IsNothing()) {
+    Nan::ThrowTypeError("Slow log thresholds and capacity must be numbers");
+    return;
+  }
+
+  double parse_ms = maybe_parse_threshold.FromJust();
+  double query_ms = maybe_query_threshold.FromJust();
+
+  std::lock_guard<std::mutex> lock(log_mutex);
+  capacity = maybe_capacity.FromJust();
+  while (entries.size() > capacity) entries.pop_front();
+  parse_threshold.store(threshold_from_ms(parse_ms), std::memory_order_relaxed);
+  query_threshold.store(threshold_from_ms(query_ms), std::memory_order_relaxed);
+}
+
+// Returns the logged entries, oldest first, along with the number of entries
+// that were discarded, and empties the log.
+static void DrainSlowLog(const Nan::FunctionCallbackInfo<Value> &info) {
+  deque<RecordedEntry> drained_entries;
+  uint32_t dropped_count;
+  {
+    std::lock_guard<std::mutex> lock(log_mutex);
+    drained_entries.swap(entries);
+    dropped_count = dropped_entry_count;
+    dropped_entry_count = 0;
+  }
+
+  Local<String> operation_key = Nan::New("operation").ToLocalChecked();
+  Local<String> method_key = Nan::New("method").ToLocalChecked();
+  Local<String> language_key = Nan::New("language").ToLocalChecked();
+  Local<String> time_key = Nan::New("time").ToLocalChecked();
+  Local<String> duration_key = Nan::New("duration").ToLocalChecked();
+  Local<String> bytes_key = Nan::New("inputBytes").ToLocalChecked();
+  Local<String> changed_bytes_key = Nan::New("changedBytes").ToLocalChecked();
+  Local<String> result_count_key = Nan::New("resultCount").ToLocalChecked();
+  Local<String> node_count_key = Nan::New("nodeCount").ToLocalChecked();
+  Local<String> patterns_key = Nan::New("patterns").ToLocalChecked();
+  Local<String> index_key = Nan::New("index").ToLocalChecked();
+
+  Local<Array> js_entries = Nan::New<Array>(drained_entries.size());
+  for (unsigned i = 0; i < drained_entries.size(); i++) {
+    const Entry &entry = drained_entries[i].entry;
+    bool is_query = entry.operation == OperationQueryMatches || entry.operation == OperationQueryCaptures;
+
+    Local<Object> js_entry = Nan::New<Object>();
+    Nan::Set(js_entry, operation_key, Nan::New(operation_name(entry.operation)).ToLocalChecked());
+    Nan::Set(js_entry, method_key, Nan::New(entry.method_name).ToLocalChecked());
+    Nan::Set(js_entry, language_key, Nan::New(entry.language).ToLocalChecked());
+    Nan::Set(js_entry, time_key, Nan::New<Number>(drained_entries[i].time));
+    Nan::Set(js_entry, duration_key, Nan::New<Number>(entry.duration / 1e6));
+    Nan::Set(js_entry, bytes_key, Nan::New(entry.byte_count));
+    if (entry.operation == OperationReparse) {
+      Nan::Set(js_entry, changed_bytes_key, Nan::New(entry.changed_byte_count));
+    }
+
+    if (is_query) {
+      Nan::Set(js_entry, result_count_key, Nan::New(entry.result_count));
+      Nan::Set(js_entry, node_count_key, Nan::New(entry.node_count));
+      Local<Array> js_patterns = Nan::New<Array>(entry.pattern_result_counts.size());
+      for (unsigned j = 0; j < entry.pattern_result_counts.size(); j++) {
+        Local<Object> js_pattern = Nan::New<Object>();
+        Nan::Set(js_pattern, index_key, Nan::New(entry.pattern_result_counts[j].first));
+        Nan::Set(js_pattern, result_count_key, Nan::New(entry.pattern_result_counts[j].second));
+        Nan::Set(js_patterns, j, js_pattern);
+      }
+      Nan::Set(js_entry, patterns_key, js_patterns);
+    }
+
+    Nan::Set(js_entries, i, js_entry);
+  }
+
+  Local<Array> result = Nan::New<Array>(2);
+  Nan::Set(result, 0, js_entries);
+  Nan::Set(result, 1, Nan::New(dropped_count));
+  info.GetReturnValue().Set(result);
+}
+
+void Init(Local<Object> exports) {
+  Nan::Set(
+    exports,
+    Nan::New("setSlowLog").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(SetSlowLog)).ToLocalChecked()
+  );
+
+  Nan::Set(
+    exports,
+    Nan::New("drainSlowLog").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(DrainSlowLog)).ToLocalChecked()
+  );
+}
+
+}  // namespace slow_log
+}  // namespace node_tree_sitter
@@ -0,0 +1,65 @@
+#ifndef NODE_TREE_SITTER_SLOW_LOG_H_
+#define NODE_TREE_SITTER_SLOW_LOG_H_
+
+#include <v8.h>
+#include <nan.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace node_tree_sitter {
+namespace slow_log {
+
+// A bounded log of the parses and queries that took longer than a
+// threshold. Operations are always timed while the log is enabled, but
+// their details are only gathered once they turn out to be slow.
+enum Operation {
+  OperationParse,
+  OperationReparse,
+  OperationQueryMatches,
+  OperationQueryCaptures,
+};
+
+extern std::atomic<uint64_t> parse_threshold;
+extern std::atomic<uint64_t> query_threshold;
+
+const uint64_t Disabled = UINT64_MAX;
+
+inline bool IsEnabled() {
+  return
+    parse_threshold.load(std::memory_order_relaxed) != Disabled ||
+    query_threshold.load(std::memory_order_relaxed) != Disabled;
+}
+
+inline bool IsSlowParse(uint64_t duration) {
+  return duration >= parse_threshold.load(std::memory_order_relaxed);
+}
+
+inline bool IsSlowQuery(uint64_t duration) {
+  return duration >= query_threshold.load(std::memory_order_relaxed);
+}
+
+struct Entry {
+  Operation operation;
+  const char *method_name;
+  std::string language;
+  uint64_t duration;
+  uint32_t byte_count;
+  uint32_t changed_byte_count;
+  uint32_t result_count;
+  uint32_t node_count;
+
+  // Pairs of pattern indices and match or capture counts, for queries.
+  std::vector<std::pair<uint32_t, uint32_t>> pattern_result_counts;
+};
+
+// Entries can be recorded from any thread.
+void Record(Entry &&);
+
+void Init(v8::Local<v8::Object> exports);
+
+}  // namespace slow_log
+}  // namespace node_tree_sitter
+
+#endif  // NODE_TREE_SITTER_SLOW_LOG_H_
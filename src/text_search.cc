@@ -0,0 +1,50 @@
+#include "./text_search.h"
+
+namespace node_tree_sitter {
+
+using std::vector;
+
+TextSearcher::TextSearcher(const uint16_t *pattern, uint32_t length, bool case_insensitive) :
+  pattern_(pattern, pattern + length),
+  case_insensitive_(case_insensitive) {
+  for (uint16_t &unit : pattern_) unit = Fold(unit);
+  for (uint32_t &shift : shifts_) shift = length;
+  for (uint32_t i = 0; i + 1 < length; i++) {
+    shifts_[pattern_[i] & 0xff] = length - 1 - i;
+  }
+}
+
+inline uint16_t TextSearcher::Fold(uint16_t unit) const {
+  if (!case_insensitive_) return unit;
+  if (unit < 0x80) return (unit >= 'A' && unit <= 'Z') ? unit + 0x20 : unit;
+  if (
+    (unit >= 0xc0 && unit <= 0xde && unit != 0xd7) ||
+    (unit >= 0x391 && unit <= 0x3ab && unit != 0x3a2) ||
+    (unit >= 0x410 && unit <= 0x42f)
+  ) return unit + 0x20;
+  if (unit >= 0x400 && unit <= 0x40f) return unit + 0x50;
+  return unit;
+}
+
+void TextSearcher::FindAll(const uint16_t *text, uint32_t start, uint32_t end, vector<uint32_t> *result) const {
+  uint32_t length = pattern_.size();
+  if (length == 0) return;
+  uint16_t last = pattern_[length - 1];
+
+  uint32_t position = start;
+  while (end >= length && position <= end - length) {
+    uint16_t unit = Fold(text[position + length - 1]);
+    if (unit == last) {
+      uint32_t i = length - 1;
+      while (i > 0 && Fold(text[position + i - 1]) == pattern_[i - 1]) i--;
+      if (i == 0) {
+        result->push_back(position);
+        position += length;
+        continue;
+      }
+    }
+    position += shifts_[unit & 0xff];
+  }
+}
+
+}  // namespace node_tree_sitter
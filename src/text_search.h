@@ -0,0 +1,35 @@
+#ifndef NODE_TREE_SITTER_TEXT_SEARCH_H_
+#define NODE_TREE_SITTER_TEXT_SEARCH_H_
+
+#include <stdint.h>
+#include <vector>
+
+namespace node_tree_sitter {
+
+// Finds a literal pattern in UTF-16 text using the Boyer-Moore-Horspool
+// algorithm, which skips ahead by up to the pattern's length after each
+// mismatch. Case-insensitive searches fold the cases of ASCII, Latin-1,
+// Greek and Cyrillic letters.
+class TextSearcher {
+ public:
+  TextSearcher(const uint16_t *pattern, uint32_t length, bool case_insensitive);
+
+  uint32_t pattern_length() const { return pattern_.size(); }
+
+  // Add the starts of the non-overlapping matches within `[start, end)`.
+  void FindAll(const uint16_t *text, uint32_t start, uint32_t end, std::vector<uint32_t> *) const;
+
+ private:
+  uint16_t Fold(uint16_t) const;
+
+  std::vector<uint16_t> pattern_;
+  bool case_insensitive_;
+
+  // Shifts are indexed by the low byte of a code unit, so units that share
+  // one get the smallest of their shifts.
+  uint32_t shifts_[256];
+};
+
+}  // namespace node_tree_sitter
+
+#endif  // NODE_TREE_SITTER_TEXT_SEARCH_H_
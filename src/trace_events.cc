@@ -0,0 +1,195 @@
+#include "./trace_events.h"
+#include <mutex>
+#include <uv.h>
+#include <v8.h>
+#include <nan.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#endif
+
+namespace node_tree_sitter {
+namespace trace_events {
+
+using std::string;
+using std::vector;
+using namespace v8;
+
+std::atomic<uint32_t> enabled_categories(0);
+
+struct Event {
+  Category category;
+  const char *name;
+  uint64_t start_time;
+  uint64_t duration;
+  uint32_t thread_id;
+  vector<std::pair<const char *, double>> number_args;
+  vector<std::pair<const char *, string>> string_args;
+};
+
+static std::mutex events_mutex;
+static vector<Event> events;
+static size_t event_capacity = 0;
+static uint32_t dropped_event_count = 0;
+
+// Spans use the operating system's thread ids, like V8's own trace events,
+// so that they appear on the same threads as the events in a trace written
+// by Node. Elsewhere, threads are numbered in the order in which they first
+// record a span.
+static uint32_t current_thread_id() {
+  static thread_local uint32_t thread_id = 0;
+  if (!thread_id) {
+#ifdef _WIN32
+    thread_id = GetCurrentThreadId();
+#elif defined(__linux__)
+    thread_id = static_cast<uint32_t>(syscall(SYS_gettid));
+#elif defined(__APPLE__)
+    thread_id = pthread_mach_thread_np(pthread_self());
+#else
+    static std::atomic<uint32_t> next_thread_id(1);
+    thread_id = next_thread_id.fetch_add(1);
+#endif
+  }
+  return thread_id;
+}
+
+static const char *category_name(Category category) {
+  switch (category) {
+    case CategoryParse: return "tree-sitter.parse";
+    case CategoryIncrementalParse: return "tree-sitter.incremental_parse";
+    case CategoryQuery: return "tree-sitter.query";
+    case CategoryMarshal: return "tree-sitter.marshal";
+  }
+  return "tree-sitter";
+}
+
+Span::Span(Category category, const char *name) :
+  enabled_(IsEnabled(category)),
+  category_(category),
+  name_(name),
+  start_time_(enabled_ ? uv_hrtime() : 0) {}
+
+Span::Span(Category category, const char *name, uint64_t start_time) :
+  enabled_(IsEnabled(category)),
+  category_(category),
+  name_(name),
+  start_time_(start_time) {}
+
+void Span::AddArg(const char *name, double value) {
+  if (enabled_) number_args_.push_back({name, value});
+}
+
+void Span::AddArg(const char *name, const string &value) {
+  if (enabled_) string_args_.push_back({name, value});
+}
+
+Span::~Span() {
+  if (!enabled_) return;
+  uint64_t end_time = uv_hrtime();
+
+  std::lock_guard<std::mutex> lock(events_mutex);
+  if (!(enabled_categories.load(std::memory_order_relaxed) & category_)) return;
+  if (events.size() >= event_capacity) {
+    dropped_event_count++;
+    return;
+  }
+
+  Event event;
+  event.category = category_;
+  event.name = name_;
+  event.start_time = start_time_;
+  event.duration = end_time - start_time_;
+  event.thread_id = current_thread_id();
+  event.number_args = std::move(number_args_);
+  event.string_args = std::move(string_args_);
+  events.push_back(std::move(event));
+}
+
+static void StartTracing(const Nan::FunctionCallbackInfo<Value> &info) {
+  auto maybe_categories = Nan::To<uint32_t>(info[0]);
+  auto maybe_capacity = Nan::To<uint32_t>(info[1]);
+  if (maybe_categories.IsNothing() || maybe_capacity.IsNothing()) {
+    Nan::ThrowTypeError("Tracing categories and capacity must be integers");
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(events_mutex);
+  events.clear();
+  event_capacity = maybe_capacity.FromJust();
+  dropped_event_count = 0;
+  enabled_categories.store(maybe_categories.FromJust(), std::memory_order_relaxed);
+}
+
+// Returns the recorded spans as complete ('X') events, with times in
+// microseconds, along with the number of spans that didn't fit.
+static void StopTracing(const Nan::FunctionCallbackInfo<Value> &info) {
+  vector<Event> recorded_events;
+  uint32_t dropped_count;
+  {
+    std::lock_guard<std::mutex> lock(events_mutex);
+    enabled_categories.store(0, std::memory_order_relaxed);
+    recorded_events.swap(events);
+    dropped_count = dropped_event_count;
+  }
+
+  Local<String> name_key = Nan::New("name").ToLocalChecked();
+  Local<String> category_key = Nan::New("cat").ToLocalChecked();
+  Local<String> phase_key = Nan::New("ph").ToLocalChecked();
+  Local<String> timestamp_key = Nan::New("ts").ToLocalChecked();
+  Local<String> duration_key = Nan::New("dur").ToLocalChecked();
+  Local<String> process_id_key = Nan::New("pid").ToLocalChecked();
+  Local<String> thread_id_key = Nan::New("tid").ToLocalChecked();
+  Local<String> args_key = Nan::New("args").ToLocalChecked();
+  Local<String> complete_phase = Nan::New("X").ToLocalChecked();
+  Local<Number> process_id = Nan::New<Number>(uv_os_getpid());
+
+  Local<Array> js_events = Nan::New<Array>(recorded_events.size());
+  for (unsigned i = 0; i < recorded_events.size(); i++) {
+    const Event &event = recorded_events[i];
+    Local<Object> js_event = Nan::New<Object>();
+    Nan::Set(js_event, name_key, Nan::New(event.name).ToLocalChecked());
+    Nan::Set(js_event, category_key, Nan::New(category_name(event.category)).ToLocalChecked());
+    Nan::Set(js_event, phase_key, complete_phase);
+    Nan::Set(js_event, timestamp_key, Nan::New<Number>(event.start_time / 1000.0));
+    Nan::Set(js_event, duration_key, Nan::New<Number>(event.duration / 1000.0));
+    Nan::Set(js_event, process_id_key, process_id);
+    Nan::Set(js_event, thread_id_key, Nan::New(event.thread_id));
+
+    Local<Object> args = Nan::New<Object>();
+    for (const auto &arg : event.number_args) {
+      Nan::Set(args, Nan::New(arg.first).ToLocalChecked(), Nan::New<Number>(arg.second));
+    }
+    for (const auto &arg : event.string_args) {
+      Nan::Set(args, Nan::New(arg.first).ToLocalChecked(), Nan::New(arg.second).ToLocalChecked());
+    }
+    Nan::Set(js_event, args_key, args);
+    Nan::Set(js_events, i, js_event);
+  }
+
+  Local<Array> result = Nan::New<Array>(2);
+  Nan::Set(result, 0, js_events);
+  Nan::Set(result, 1, Nan::New(dropped_count));
+  info.GetReturnValue().Set(result);
+}
+
+void Init(Local<Object> exports) {
+  Nan::Set(
+    exports,
+    Nan::New("startTracing").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(StartTracing)).ToLocalChecked()
+  );
+
+  Nan::Set(
+    exports,
+    Nan::New("stopTracing").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(StopTracing)).ToLocalChecked()
+  );
+}
+
+}  // namespace trace_events
+}  // namespace node_tree_sitter
@@ -0,0 +1,58 @@
+#ifndef NODE_TREE_SITTER_TRACE_EVENTS_H_
+#define NODE_TREE_SITTER_TRACE_EVENTS_H_
+
+#include <v8.h>
+#include <nan.h>
+#include <atomic>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+namespace node_tree_sitter {
+namespace trace_events {
+
+// Spans of the binding's work, recorded in memory while tracing is enabled
+// and returned in the Chrome trace event format, which Perfetto can load.
+// Timestamps come from `uv_hrtime`, which is the clock that Node's own trace
+// events use, so the two can be shown on one timeline.
+enum Category : uint32_t {
+  CategoryParse = 1 << 0,
+  CategoryIncrementalParse = 1 << 1,
+  CategoryQuery = 1 << 2,
+  CategoryMarshal = 1 << 3,
+};
+
+extern std::atomic<uint32_t> enabled_categories;
+
+inline bool IsEnabled(Category category) {
+  return enabled_categories.load(std::memory_order_relaxed) & category;
+}
+
+// A span that starts when it's created and ends when it's destroyed. Spans
+// of disabled categories do nothing.
+class Span {
+ public:
+  Span(Category, const char *name);
+  Span(Category, const char *name, uint64_t start_time);
+  ~Span();
+
+  bool enabled() const { return enabled_; }
+  void AddArg(const char *name, double value);
+  void AddArg(const char *name, const std::string &value);
+
+ private:
+  bool enabled_;
+  Category category_;
+  const char *name_;
+  uint64_t start_time_;
+  std::vector<std::pair<const char *, double>> number_args_;
+  std::vector<std::pair<const char *, std::string>> string_args_;
+};
+
+void Init(v8::Local<v8::Object> exports);
+
+}  // namespace trace_events
+}  // namespace node_tree_sitter
+
+#endif  // NODE_TREE_SITTER_TRACE_EVENTS_H_
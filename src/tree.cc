@@ -1,15 +1,22 @@
 #include "./tree.h"
+#include <algorithm>
 #include <string>
+#include <vector>
 #include <v8.h>
 #include <nan.h>
 #include "./node.h"
 #include "./logger.h"
 #include "./util.h"
 #include "./conversions.h"
+#include "./metrics.h"
+#include "./probes.h"
+#include "./text_search.h"
 
 namespace node_tree_sitter {
 
+using std::vector;
 using namespace v8;
+using node_methods::SymbolSet;
 using node_methods::UnmarshalNodeId;
 
 Nan::Persistent<Function> Tree::constructor;
@@ -27,13 +34,14 @@ void Tree::Init(Local<Object> exports) {
     {"printDotGraph", PrintDotGraph},
     {"getChangedRanges", GetChangedRanges},
     {"getEditedRange", GetEditedRange},
+    {"_chunk", Chunk},
+    {"_tokens", Tokens},
+    {"_search", Search},
     {"_cacheNode", CacheNode},
     {"_cacheNodes", CacheNodes},
   };
 
-  for (size_t i = 0; i < length_of_array(methods); i++) {
-    Nan::SetPrototypeMethod(tpl, methods[i].name, methods[i].callback);
-  }
+  metrics::SetPrototypeMethods(tpl, "Tree", methods, length_of_array(methods));
 
   Local<Function> ctor = Nan::GetFunction(tpl).ToLocalChecked();
 
@@ -42,21 +50,80 @@ void Tree::Init(Local<Object> exports) {
   Nan::Set(exports, class_name, ctor);
 }
 
-Tree::Tree(TSTree *tree) : tree_(tree) {}
+Tree::Tree(TSTree *tree, std::shared_ptr<PositionIndex> position_index) :
+  tree_(tree),
+  position_index_(position_index) {
+  metrics::Add(metrics::TreesCreated);
+}
 
 Tree::~Tree() {
+  PROBE_TREE_DELETE(tree_, cached_nodes_.size());
+  metrics::Add(metrics::TreesDeleted);
   ts_tree_delete(tree_);
   for (auto &entry : cached_nodes_) {
     entry.second->tree = nullptr;
   }
+  for (TreeEditObserver *observer : edit_observers_) {
+    observer->TreeDeleted();
+  }
+}
+
+void Tree::AddEditObserver(TreeEditObserver *observer) const {
+  edit_observers_.push_back(observer);
+}
+
+void Tree::RemoveEditObserver(TreeEditObserver *observer) const {
+  auto iter = std::find(edit_observers_.begin(), edit_observers_.end(), observer);
+  if (iter != edit_observers_.end()) edit_observers_.erase(iter);
+}
+
+static const size_t MAX_CACHED_CHILD_INDICES = 16;
+
+const Tree::ChildIndex &Tree::GetChildIndex(TSNode node) const {
+  // The same subtree can appear at more than one position, so the node's
+  // start is checked in addition to its id.
+  auto iter = child_indices_by_id_.find(node.id);
+  if (iter != child_indices_by_id_.end()) {
+    child_indices_.splice(child_indices_.begin(), child_indices_, iter->second);
+    if (iter->second->start_byte == ts_node_start_byte(node)) return *iter->second;
+  } else {
+    if (child_indices_.size() >= MAX_CACHED_CHILD_INDICES) {
+      child_indices_by_id_.erase(child_indices_.back().id);
+      child_indices_.pop_back();
+    }
+    child_indices_.emplace_front();
+    child_indices_by_id_[node.id] = child_indices_.begin();
+  }
+
+  ChildIndex &child_index = child_indices_.front();
+  child_index.id = node.id;
+  child_index.start_byte = ts_node_start_byte(node);
+  child_index.children.clear();
+  child_index.named_child_indices.clear();
+  child_index.children.reserve(ts_node_child_count(node));
+  child_index.named_child_indices.reserve(ts_node_named_child_count(node));
+
+  TSTreeCursor cursor = ts_tree_cursor_new(node);
+  if (ts_tree_cursor_goto_first_child(&cursor)) {
+    do {
+      TSNode child = ts_tree_cursor_current_node(&cursor);
+      if (ts_node_is_named(child)) {
+        child_index.named_child_indices.push_back(child_index.children.size());
+      }
+      child_index.children.push_back(child);
+    } while (ts_tree_cursor_goto_next_sibling(&cursor));
+  }
+  ts_tree_cursor_delete(&cursor);
+
+  return child_index;
 }
 
-Local<Value> Tree::NewInstance(TSTree *tree) {
+Local<Value> Tree::NewInstance(TSTree *tree, std::shared_ptr<PositionIndex> position_index) {
   if (tree) {
     Local<Object> self;
     MaybeLocal<Object> maybe_self = Nan::NewInstance(Nan::New(constructor));
     if (maybe_self.ToLocal(&self)) {
-      (new Tree(tree))->Wrap(self);
+      (new Tree(tree, position_index))->Wrap(self);
       return self;
     }
   }
@@ -89,17 +156,70 @@ void Tree::Edit(const Nan::FunctionCallbackInfo<Value> &info) {
 
   TSInputEdit edit;
   Nan::Maybe<uint32_t> maybe_number = Nan::Nothing<uint32_t>();
-  read_number_from_js(&edit.start_point.row, info[0], "startPosition.row");
-  read_byte_count_from_js(&edit.start_point.column, info[1], "startPosition.column");
-  read_number_from_js(&edit.old_end_point.row, info[2], "oldEndPosition.row");
-  read_byte_count_from_js(&edit.old_end_point.column, info[3], "oldEndPosition.column");
-  read_number_from_js(&edit.new_end_point.row, info[4], "newEndPosition.row");
-  read_byte_count_from_js(&edit.new_end_point.column, info[5], "newEndPosition.column");
-  read_byte_count_from_js(&edit.start_byte, info[6], "startIndex");
-  read_byte_count_from_js(&edit.old_end_byte, info[7], "oldEndIndex");
-  read_byte_count_from_js(&edit.new_end_byte, info[8], "newEndIndex");
+  if (!tree->position_index_) {
+    read_number_from_js(&edit.start_point.row, info[0], "startPosition.row");
+    read_byte_count_from_js(&edit.start_point.column, info[1], "startPosition.column");
+    read_number_from_js(&edit.old_end_point.row, info[2], "oldEndPosition.row");
+    read_byte_count_from_js(&edit.old_end_point.column, info[3], "oldEndPosition.column");
+    read_number_from_js(&edit.new_end_point.row, info[4], "newEndPosition.row");
+    read_byte_count_from_js(&edit.new_end_point.column, info[5], "newEndPosition.column");
+    read_byte_count_from_js(&edit.start_byte, info[6], "startIndex");
+    read_byte_count_from_js(&edit.old_end_byte, info[7], "oldEndIndex");
+    read_byte_count_from_js(&edit.new_end_byte, info[8], "newEndIndex");
+  } else {
+    // In other encodings, the extent of the inserted text can't be derived
+    // from the edit's coordinates, so the text itself is needed to update
+    // the position index.
+    if (!info[9]->IsString()) {
+      Nan::ThrowTypeError("Edits to trees with a UTF-8 or UTF-32 position encoding must include `newText`");
+      return;
+    }
+
+    uint32_t start_index, old_end_index;
+    read_number_from_js(&edit.start_point.row, info[0], "startPosition.row");
+    read_number_from_js(&edit.old_end_point.row, info[2], "oldEndPosition.row");
+    read_number_from_js(&edit.new_end_point.row, info[4], "newEndPosition.row");
+    read_number_from_js(&start_index, info[6], "startIndex");
+    read_number_from_js(&old_end_index, info[7], "oldEndIndex");
+
+    Local<String> js_new_text = Local<String>::Cast(info[9]);
+    std::vector<uint16_t> new_text(js_new_text->Length());
+    js_new_text->Write(
+
+      // Nan doesn't wrap this functionality
+      #if NODE_MAJOR_VERSION >= 12
+        Isolate::GetCurrent(),
+      #endif
+
+      new_text.data(),
+      0,
+      new_text.size(),
+      String::NO_NULL_TERMINATION
+    );
+
+    if (tree->position_index_.use_count() > 1) {
+      tree->position_index_ = std::make_shared<PositionIndex>(*tree->position_index_);
+    }
+    PositionIndex *index = tree->position_index_.get();
+
+    uint32_t start = index->ToUTF16(start_index);
+    uint32_t old_end = index->ToUTF16(old_end_index);
+    edit.start_point.column = (start - index->LineStart(edit.start_point.row)) * 2;
+    edit.old_end_point.column = (old_end - index->LineStart(edit.old_end_point.row)) * 2;
+
+    index->Edit(start, old_end, new_text.data(), new_text.size());
+
+    uint32_t new_end = start + new_text.size();
+    edit.new_end_point.column = (new_end - index->LineStart(edit.new_end_point.row)) * 2;
+    edit.start_byte = start * 2;
+    edit.old_end_byte = old_end * 2;
+    edit.new_end_byte = new_end * 2;
+  }
 
   ts_tree_edit(tree->tree_, &edit);
+  tree->child_indices_.clear();
+  tree->child_indices_by_id_.clear();
+  metrics::Add(metrics::CachedNodeUpdates, tree->cached_nodes_.size());
 
   for (auto &entry : tree->cached_nodes_) {
     Local<Object> js_node = Nan::New(entry.second->node);
@@ -119,6 +239,10 @@ void Tree::Edit(const Nan::FunctionCallbackInfo<Value> &info) {
     }
   }
 
+  for (TreeEditObserver *observer : tree->edit_observers_) {
+    observer->TreeEdited(edit);
+  }
+
   info.GetReturnValue().Set(info.This());
 }
 
@@ -140,7 +264,7 @@ void Tree::GetChangedRanges(const Nan::FunctionCallbackInfo<Value> &info) {
 
   Local<Array> result = Nan::New<Array>();
   for (size_t i = 0; i < range_count; i++) {
-    Nan::Set(result, i, RangeToJS(ranges[i]));
+    Nan::Set(result, i, RangeToJS(ranges[i], other_tree->position_index()));
   }
 
   info.GetReturnValue().Set(result);
@@ -191,7 +315,290 @@ void Tree::GetEditedRange(const Nan::FunctionCallbackInfo<Value> &info) {
   }
 
   ts_tree_cursor_delete(&cursor);
-  info.GetReturnValue().Set(RangeToJS(result));
+  info.GetReturnValue().Set(RangeToJS(result, tree->position_index()));
+}
+
+// Split the text into contiguous chunks of at most `max_length`, cutting only
+// at the starts of nodes. Sibling subtrees are packed greedily; a subtree
+// that doesn't fit in the current chunk starts a new one, and a subtree that
+// doesn't fit in any chunk is descended into. When a chunk has to be cut, it
+// is cut at the start of the last node of a preferred type within it, if
+// there is one. A single token that is longer than `max_length` gets a chunk
+// of its own. Lengths are measured in the tree's position encoding.
+static vector<uint32_t> chunk_tree(TSNode root, uint32_t max_length, const SymbolSet &preferred_types,
+                                   const PositionIndex *position_index) {
+  vector<uint32_t> boundaries;
+  uint32_t chunk_start = 0;
+  uint32_t preferred_start = 0;
+
+  TSTreeCursor cursor = ts_tree_cursor_new(root);
+  bool has_node = ts_tree_cursor_goto_first_child(&cursor);
+  while (has_node) {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    uint32_t start = ByteCountToIndex(ts_node_start_byte(node), position_index);
+    uint32_t end = ByteCountToIndex(ts_node_end_byte(node), position_index);
+
+    if (end - chunk_start > max_length && start > chunk_start) {
+      uint32_t boundary = preferred_start > chunk_start ? preferred_start : start;
+      boundaries.push_back(boundary);
+      chunk_start = boundary;
+      if (end - chunk_start > max_length && start > chunk_start) {
+        boundaries.push_back(start);
+        chunk_start = start;
+      }
+    }
+
+    if (end - chunk_start > max_length) {
+      if (ts_tree_cursor_goto_first_child(&cursor)) continue;
+      boundaries.push_back(end);
+      chunk_start = end;
+    } else if (start > chunk_start && preferred_types.contains(ts_node_symbol(node))) {
+      preferred_start = start;
+    }
+
+    while (!(has_node = ts_tree_cursor_goto_next_sibling(&cursor))) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) break;
+    }
+  }
+  ts_tree_cursor_delete(&cursor);
+
+  uint32_t end = ByteCountToIndex(ts_node_end_byte(root), position_index);
+  if (end > chunk_start) boundaries.push_back(end);
+  return boundaries;
+}
+
+// Chunks are returned as a flat array of (startIndex, endIndex) pairs.
+void Tree::Chunk(const Nan::FunctionCallbackInfo<Value> &info) {
+  const Tree *tree = ObjectWrap::Unwrap<Tree>(info.This());
+
+  auto maybe_max_length = Nan::To<uint32_t>(info[0]);
+  if (!info[0]->IsNumber() || maybe_max_length.IsNothing() || maybe_max_length.FromJust() == 0) {
+    Nan::ThrowTypeError("maxBytes must be a positive integer");
+    return;
+  }
+
+  SymbolSet preferred_types;
+  if (!node_methods::symbol_set_from_js(&preferred_types, info[1], ts_tree_language(tree->tree_))) return;
+
+  vector<uint32_t> boundaries = chunk_tree(
+    ts_tree_root_node(tree->tree_),
+    maybe_max_length.FromJust(),
+    preferred_types,
+    tree->position_index()
+  );
+
+  Local<ArrayBuffer> buffer = ArrayBuffer::New(Isolate::GetCurrent(), 2 * boundaries.size() * sizeof(uint32_t));
+  Local<Uint32Array> result = Uint32Array::New(buffer, 0, 2 * boundaries.size());
+  Nan::TypedArrayContents<uint32_t> contents(result);
+  uint32_t *p = *contents;
+  uint32_t start = 0;
+  for (uint32_t end : boundaries) {
+    *(p++) = start;
+    *(p++) = end;
+    start = end;
+  }
+
+  info.GetReturnValue().Set(result);
+}
+
+// Collect the leaves that overlap the given range, in order. Missing nodes,
+// which have no text, are skipped, and so are extras and everything within
+// them unless `include_extras` is set.
+static vector<TSNode> collect_tokens(TSNode root, uint32_t start_byte, uint32_t end_byte,
+                                     bool include_anonymous, bool include_extras) {
+  vector<TSNode> result;
+  TSTreeCursor cursor = ts_tree_cursor_new(root);
+  bool has_node = true;
+  while (has_node) {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    uint32_t node_start = ts_node_start_byte(node);
+    uint32_t node_end = ts_node_end_byte(node);
+    if (node_start >= end_byte) break;
+
+    if (node_end > start_byte && (include_extras || !ts_node_is_extra(node))) {
+      if (ts_tree_cursor_goto_first_child(&cursor)) continue;
+      if (node_end > node_start && (include_anonymous || ts_node_is_named(node))) {
+        result.push_back(node);
+      }
+    }
+
+    while (!(has_node = ts_tree_cursor_goto_next_sibling(&cursor))) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) break;
+    }
+  }
+  ts_tree_cursor_delete(&cursor);
+  return result;
+}
+
+// Tokens are returned as parallel arrays of their type ids, start and end
+// indices, and whether they are named or extras. When the tree's source is
+// passed, the tokens' text is also returned, as an array of strings.
+void Tree::Tokens(const Nan::FunctionCallbackInfo<Value> &info) {
+  const Tree *tree = ObjectWrap::Unwrap<Tree>(info.This());
+  const PositionIndex *position_index = tree->position_index();
+
+  uint32_t start_byte = 0, end_byte = UINT32_MAX;
+  if (!info[0]->IsUndefined()) {
+    auto maybe_start = ByteCountFromJS(info[0], position_index);
+    if (maybe_start.IsNothing()) return;
+    start_byte = maybe_start.FromJust();
+  }
+  if (!info[1]->IsUndefined()) {
+    auto maybe_end = ByteCountFromJS(info[1], position_index);
+    if (maybe_end.IsNothing()) return;
+    end_byte = maybe_end.FromJust();
+  }
+
+  bool include_anonymous = Nan::To<bool>(info[2]).FromMaybe(false);
+  bool include_extras = Nan::To<bool>(info[3]).FromMaybe(false);
+  vector<TSNode> tokens = collect_tokens(
+    ts_tree_root_node(tree->tree_),
+    start_byte,
+    end_byte,
+    include_anonymous,
+    include_extras
+  );
+
+  vector<TSSymbol> type_ids(tokens.size());
+  vector<uint32_t> start_indices(tokens.size()), end_indices(tokens.size());
+  vector<uint8_t> is_named(tokens.size()), is_extra(tokens.size());
+  for (size_t i = 0; i < tokens.size(); i++) {
+    TSNode token = tokens[i];
+    type_ids[i] = ts_node_symbol(token);
+    start_indices[i] = ByteCountToIndex(ts_node_start_byte(token), position_index);
+    end_indices[i] = ByteCountToIndex(ts_node_end_byte(token), position_index);
+    is_named[i] = ts_node_is_named(token);
+    is_extra[i] = ts_node_is_extra(token);
+  }
+
+  Local<Object> result = Nan::New<Object>();
+  Nan::Set(result, Nan::New("typeIds").ToLocalChecked(), typed_array_from_vector<TSSymbol, Uint16Array>(type_ids));
+  Nan::Set(result, Nan::New("startIndices").ToLocalChecked(), typed_array_from_vector<uint32_t, Uint32Array>(start_indices));
+  Nan::Set(result, Nan::New("endIndices").ToLocalChecked(), typed_array_from_vector<uint32_t, Uint32Array>(end_indices));
+  Nan::Set(result, Nan::New("isNamed").ToLocalChecked(), typed_array_from_vector<uint8_t, Uint8Array>(is_named));
+  Nan::Set(result, Nan::New("isExtra").ToLocalChecked(), typed_array_from_vector<uint8_t, Uint8Array>(is_extra));
+
+  if (info[4]->IsString()) {
+    vector<uint16_t> source = UTF16FromJS(Local<String>::Cast(info[4]));
+    Local<Array> text = Nan::New<Array>(tokens.size());
+    for (size_t i = 0; i < tokens.size(); i++) {
+      uint32_t start = std::min<uint32_t>(ts_node_start_byte(tokens[i]) / 2, source.size());
+      uint32_t end = std::min<uint32_t>(ts_node_end_byte(tokens[i]) / 2, source.size());
+      Nan::Set(text, i, Nan::New<String>(source.data() + start, end - start).ToLocalChecked());
+    }
+    Nan::Set(result, Nan::New("text").ToLocalChecked(), text);
+  }
+
+  info.GetReturnValue().Set(result);
+}
+
+struct ByteRange {
+  uint32_t start;
+  uint32_t end;
+};
+
+// Find the ranges of the outermost nodes of the included types, or of the
+// whole text when there are no included types, minus the ranges of the nodes
+// of the excluded types.
+static vector<ByteRange> collect_search_ranges(TSNode root, uint32_t text_end, const SymbolSet *included_types,
+                                               const SymbolSet &excluded_types) {
+  vector<ByteRange> included, excluded;
+  bool has_excluded_types = !excluded_types.words.empty() || excluded_types.includes_error;
+  if (!included_types) included.push_back({0, text_end});
+
+  if (included_types || has_excluded_types) {
+    uint32_t included_end = 0;
+    TSTreeCursor cursor = ts_tree_cursor_new(root);
+    bool has_node = true;
+    while (has_node) {
+      TSNode node = ts_tree_cursor_current_node(&cursor);
+      uint32_t start = ts_node_start_byte(node);
+      uint32_t end = ts_node_end_byte(node);
+      TSSymbol symbol = ts_node_symbol(node);
+
+      bool visit_children = false;
+      if (excluded_types.contains(symbol)) {
+        excluded.push_back({start, end});
+      } else {
+        bool is_within_included = !included_types || start < included_end;
+        if (!is_within_included && included_types->contains(symbol)) {
+          included.push_back({start, end});
+          included_end = end;
+          is_within_included = true;
+        }
+        visit_children = !is_within_included || has_excluded_types;
+      }
+
+      if (visit_children && ts_tree_cursor_goto_first_child(&cursor)) continue;
+      while (!(has_node = ts_tree_cursor_goto_next_sibling(&cursor))) {
+        if (!ts_tree_cursor_goto_parent(&cursor)) break;
+      }
+    }
+    ts_tree_cursor_delete(&cursor);
+  }
+
+  vector<ByteRange> result;
+  size_t i = 0;
+  for (const ByteRange &range : included) {
+    uint32_t start = range.start;
+    while (i < excluded.size() && excluded[i].end <= start) i++;
+    for (size_t j = i; j < excluded.size() && excluded[j].start < range.end; j++) {
+      if (excluded[j].start > start) result.push_back({start, excluded[j].start});
+      start = std::max(start, excluded[j].end);
+    }
+    if (start < range.end) result.push_back({start, range.end});
+  }
+  return result;
+}
+
+// Matches are returned as a flat array of (startIndex, endIndex) pairs. A
+// match has to lie within a single one of the searched nodes.
+void Tree::Search(const Nan::FunctionCallbackInfo<Value> &info) {
+  const Tree *tree = ObjectWrap::Unwrap<Tree>(info.This());
+  const TSLanguage *language = ts_tree_language(tree->tree_);
+
+  if (!info[0]->IsString() || Local<String>::Cast(info[0])->Length() == 0) {
+    Nan::ThrowTypeError("Pattern must be a non-empty string");
+    return;
+  }
+
+  SymbolSet included_types, excluded_types;
+  bool has_included_types = !info[1]->IsNullOrUndefined();
+  if (has_included_types && !node_methods::symbol_set_from_js(&included_types, info[1], language)) return;
+  if (!node_methods::symbol_set_from_js(&excluded_types, info[2], language)) return;
+  bool case_insensitive = Nan::To<bool>(info[3]).FromMaybe(false);
+
+  if (!info[4]->IsString()) {
+    Nan::ThrowTypeError("Source must be a string");
+    return;
+  }
+
+  vector<uint16_t> pattern = UTF16FromJS(Local<String>::Cast(info[0]));
+  vector<uint16_t> source = UTF16FromJS(Local<String>::Cast(info[4]));
+  vector<ByteRange> ranges = collect_search_ranges(
+    ts_tree_root_node(tree->tree_),
+    source.size() * 2,
+    has_included_types ? &included_types : nullptr,
+    excluded_types
+  );
+
+  TextSearcher searcher(pattern.data(), pattern.size(), case_insensitive);
+  vector<uint32_t> match_starts;
+  for (const ByteRange &range : ranges) {
+    uint32_t start = std::min<uint32_t>(range.start / 2, source.size());
+    uint32_t end = std::min<uint32_t>(range.end / 2, source.size());
+    searcher.FindAll(source.data(), start, end, &match_starts);
+  }
+
+  const PositionIndex *position_index = tree->position_index();
+  vector<uint32_t> matches;
+  matches.reserve(2 * match_starts.size());
+  for (uint32_t start : match_starts) {
+    matches.push_back(ByteCountToIndex(start * 2, position_index));
+    matches.push_back(ByteCountToIndex((start + searcher.pattern_length()) * 2, position_index));
+  }
+
+  info.GetReturnValue().Set(typed_array_from_vector<uint32_t, Uint32Array>(matches));
 }
 
 void Tree::PrintDotGraph(const Nan::FunctionCallbackInfo<Value> &info) {
@@ -204,6 +611,7 @@ static void FinalizeNode(const v8::WeakCallbackInfo<Tree::NodeCacheEntry> &info)
   Tree::NodeCacheEntry *cache_entry = info.GetParameter();
   assert(!cache_entry->node.IsEmpty());
   cache_entry->node.Reset();
+  metrics::Add(metrics::NodesFinalized);
   if (cache_entry->tree) {
     assert(cache_entry->tree->cached_nodes_.count(cache_entry->key));
     cache_entry->tree->cached_nodes_.erase(cache_entry->key);
@@ -228,6 +636,7 @@ static void CacheNodeForTree(Tree *tree, Isolate *isolate, Local<Object> js_node
   assert(!tree->cached_nodes_.count(key));
 
   tree->cached_nodes_[key] = cache_entry;
+  metrics::Add(metrics::NodesCached);
 }
 
 void Tree::CacheNode(const Nan::FunctionCallbackInfo<Value> &info) {
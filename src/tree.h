@@ -4,15 +4,28 @@
 #include <v8.h>
 #include <nan.h>
 #include <node_object_wrap.h>
+#include <list>
+#include <memory>
 #include <unordered_map>
+#include <vector>
 #include <tree_sitter/api.h>
+#include "./position_index.h"
 
 namespace node_tree_sitter {
 
+// Native structures that store positions within a tree can register
+// themselves to be kept up to date when the tree is edited.
+class TreeEditObserver {
+ public:
+  virtual ~TreeEditObserver() {}
+  virtual void TreeEdited(const TSInputEdit &) = 0;
+  virtual void TreeDeleted() = 0;
+};
+
 class Tree : public Nan::ObjectWrap {
  public:
   static void Init(v8::Local<v8::Object> exports);
-  static v8::Local<v8::Value> NewInstance(TSTree *);
+  static v8::Local<v8::Value> NewInstance(TSTree *, std::shared_ptr<PositionIndex> = nullptr);
   static const Tree *UnwrapTree(const v8::Local<v8::Value> &);
 
   struct NodeCacheEntry {
@@ -21,11 +34,34 @@ class Tree : public Nan::ObjectWrap {
     v8::Persistent<v8::Object> node;
   };
 
+  // The children of very wide nodes, so that they can be accessed by index
+  // without walking all of their preceding siblings.
+  struct ChildIndex {
+    const void *id;
+    uint32_t start_byte;
+    std::vector<TSNode> children;
+    std::vector<uint32_t> named_child_indices;
+  };
+
+  const PositionIndex *position_index() const { return position_index_.get(); }
+  const ChildIndex &GetChildIndex(TSNode) const;
+  void AddEditObserver(TreeEditObserver *) const;
+  void RemoveEditObserver(TreeEditObserver *) const;
+
   TSTree *tree_;
   std::unordered_map<const void *, NodeCacheEntry *> cached_nodes_;
 
+  // Only present when the tree uses a position encoding other than UTF-16.
+  // Trees produced by incremental parsing share their old tree's index.
+  std::shared_ptr<PositionIndex> position_index_;
+
  private:
-  explicit Tree(TSTree *);
+  mutable std::vector<TreeEditObserver *> edit_observers_;
+  // The most recently used child indices come first.
+  mutable std::list<ChildIndex> child_indices_;
+  mutable std::unordered_map<const void *, std::list<ChildIndex>::iterator> child_indices_by_id_;
+
+  explicit Tree(TSTree *, std::shared_ptr<PositionIndex>);
   ~Tree();
 
   static void New(const Nan::FunctionCallbackInfo<v8::Value> &);
@@ -34,6 +70,9 @@ class Tree : public Nan::ObjectWrap {
   static void PrintDotGraph(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void GetEditedRange(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void GetChangedRanges(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void Chunk(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void Tokens(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void Search(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void CacheNode(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void CacheNodes(const Nan::FunctionCallbackInfo<v8::Value> &);
 
@@ -6,6 +6,7 @@
 #include "./conversions.h"
 #include "./node.h"
 #include "./tree.h"
+#include "./metrics.h"
 
 namespace node_tree_sitter {
 
@@ -45,27 +46,25 @@ void TreeCursor::Init(v8::Local<v8::Object> exports) {
       getters[i].callback);
   }
 
-  for (size_t i = 0; i < length_of_array(methods); i++) {
-    Nan::SetPrototypeMethod(tpl, methods[i].name, methods[i].callback);
-  }
+  metrics::SetPrototypeMethods(tpl, "TreeCursor", methods, length_of_array(methods));
 
   Local<Function> constructor_local = Nan::GetFunction(tpl).ToLocalChecked();
   Nan::Set(exports, class_name, constructor_local);
   constructor.Reset(Nan::Persistent<Function>(constructor_local));
 }
 
-Local<Value> TreeCursor::NewInstance(TSTreeCursor cursor) {
+Local<Value> TreeCursor::NewInstance(TSTreeCursor cursor, const Tree *tree) {
   Local<Object> self;
   MaybeLocal<Object> maybe_self = Nan::New(constructor)->NewInstance(Nan::GetCurrentContext());
   if (maybe_self.ToLocal(&self)) {
-    (new TreeCursor(cursor))->Wrap(self);
+    (new TreeCursor(cursor, tree))->Wrap(self);
     return self;
   } else {
     return Nan::Null();
   }
 }
 
-TreeCursor::TreeCursor(TSTreeCursor cursor) : cursor_(cursor) {}
+TreeCursor::TreeCursor(TSTreeCursor cursor, const Tree *tree) : cursor_(cursor), tree_(tree) {}
 
 TreeCursor::~TreeCursor() { ts_tree_cursor_delete(&cursor_); }
 
@@ -92,7 +91,8 @@ void TreeCursor::GotoFirstChildForIndex(const Nan::FunctionCallbackInfo<Value> &
     Nan::ThrowTypeError("Argument must be an integer");
     return;
   }
-  uint32_t goal_byte = maybe_index.FromJust() * 2;
+  const PositionIndex *index = cursor->tree_->position_index();
+  uint32_t goal_byte = (index ? index->ToUTF16(maybe_index.FromJust()) : maybe_index.FromJust()) * 2;
   int64_t child_index = ts_tree_cursor_goto_first_child_for_byte(&cursor->cursor_, goal_byte);
   if (child_index < 0) {
     info.GetReturnValue().Set(Nan::Null());
@@ -110,13 +110,13 @@ void TreeCursor::GotoNextSibling(const Nan::FunctionCallbackInfo<Value> &info) {
 void TreeCursor::StartPosition(const Nan::FunctionCallbackInfo<Value> &info) {
   TreeCursor *cursor = Nan::ObjectWrap::Unwrap<TreeCursor>(info.This());
   TSNode node = ts_tree_cursor_current_node(&cursor->cursor_);
-  TransferPoint(ts_node_start_point(node));
+  TransferPoint(ts_node_start_point(node), ts_node_start_byte(node), cursor->tree_->position_index());
 }
 
 void TreeCursor::EndPosition(const Nan::FunctionCallbackInfo<Value> &info) {
   TreeCursor *cursor = Nan::ObjectWrap::Unwrap<TreeCursor>(info.This());
   TSNode node = ts_tree_cursor_current_node(&cursor->cursor_);
-  TransferPoint(ts_node_end_point(node));
+  TransferPoint(ts_node_end_point(node), ts_node_end_byte(node), cursor->tree_->position_index());
 }
 
 void TreeCursor::CurrentNode(const Nan::FunctionCallbackInfo<Value> &info) {
@@ -159,13 +159,13 @@ void TreeCursor::CurrentFieldName(v8::Local<v8::String> prop, const Nan::Propert
 void TreeCursor::StartIndex(v8::Local<v8::String> prop, const Nan::PropertyCallbackInfo<v8::Value> &info) {
   TreeCursor *cursor = Nan::ObjectWrap::Unwrap<TreeCursor>(info.This());
   TSNode node = ts_tree_cursor_current_node(&cursor->cursor_);
-  info.GetReturnValue().Set(ByteCountToJS(ts_node_start_byte(node)));
+  info.GetReturnValue().Set(ByteCountToJS(ts_node_start_byte(node), cursor->tree_->position_index()));
 }
 
 void TreeCursor::EndIndex(v8::Local<v8::String> prop, const Nan::PropertyCallbackInfo<v8::Value> &info) {
   TreeCursor *cursor = Nan::ObjectWrap::Unwrap<TreeCursor>(info.This());
   TSNode node = ts_tree_cursor_current_node(&cursor->cursor_);
-  info.GetReturnValue().Set(ByteCountToJS(ts_node_end_byte(node)));
+  info.GetReturnValue().Set(ByteCountToJS(ts_node_end_byte(node), cursor->tree_->position_index()));
 }
 
 }
@@ -5,16 +5,17 @@
 #include <nan.h>
 #include <node_object_wrap.h>
 #include <tree_sitter/api.h>
+#include "./tree.h"
 
 namespace node_tree_sitter {
 
 class TreeCursor : public Nan::ObjectWrap {
  public:
   static void Init(v8::Local<v8::Object> exports);
-  static v8::Local<v8::Value> NewInstance(TSTreeCursor);
+  static v8::Local<v8::Value> NewInstance(TSTreeCursor, const Tree *);
 
  private:
-  explicit TreeCursor(TSTreeCursor);
+  explicit TreeCursor(TSTreeCursor, const Tree *);
   ~TreeCursor();
 
   static void New(const Nan::FunctionCallbackInfo<v8::Value> &);
@@ -34,6 +35,7 @@ class TreeCursor : public Nan::ObjectWrap {
   static void EndIndex(v8::Local<v8::String>, const Nan::PropertyCallbackInfo<v8::Value> &);
 
   TSTreeCursor cursor_;
+  const Tree *tree_;
   static Nan::Persistent<v8::Function> constructor;
   static Nan::Persistent<v8::FunctionTemplate> constructor_template;
 };
@@ -1,6 +1,8 @@
 #ifndef NODE_TREE_SITTER_UTIL_H_
 #define NODE_TREE_SITTER_UTIL_H_
 
+#include <algorithm>
+#include <vector>
 #include <v8.h>
 #include <nan.h>
 
@@ -20,6 +22,15 @@ struct FunctionPair {
 
 bool instance_of(v8::Local<v8::Value> value, v8::Local<v8::Object> object);
 
+template <typename T, typename ArrayType>
+v8::Local<ArrayType> typed_array_from_vector(const std::vector<T> &values) {
+  v8::Local<v8::ArrayBuffer> buffer = v8::ArrayBuffer::New(v8::Isolate::GetCurrent(), values.size() * sizeof(T));
+  v8::Local<ArrayType> result = ArrayType::New(buffer, 0, values.size());
+  Nan::TypedArrayContents<T> contents(result);
+  std::copy(values.begin(), values.end(), *contents);
+  return result;
+}
+
 }  // namespace node_tree_sitter
 
 #endif  // NODE_TREE_SITTER_UTIL_H_
@@ -52,6 +52,36 @@ describe("Node", () => {
     })
   });
 
+  describe(".fieldsAll()", () => {
+    it("returns the children of every field of the node", () => {
+      const tree = parser.parse(`
+        class A {
+          @autobind
+          @something
+          b(c, d) {
+            return c + d;
+          }
+        }
+      `);
+
+      const methodNode = tree.rootNode.firstChild.bodyNode.firstNamedChild;
+      const fields = methodNode.fieldsAll();
+      assert.deepEqual(Object.keys(fields).sort(), ['body', 'decorator', 'name', 'parameters']);
+      assert.deepEqual(fields.decorator.map(_ => _.text), ['@autobind', '@something']);
+      assert.equal(fields.name[0], methodNode.nameNode);
+      assert.equal(fields.body[0], methodNode.bodyNode);
+
+      const binaryNode = methodNode.bodyNode.firstNamedChild.firstNamedChild;
+      const binaryFields = binaryNode.fieldsAll();
+      assert.deepEqual(
+        Object.keys(binaryFields).map(name => [name, binaryFields[name].map(_ => _.text)]),
+        [['left', ['c']], ['operator', ['+']], ['right', ['d']]]
+      );
+
+      assert.deepEqual(binaryNode.leftNode.fieldsAll(), {});
+    })
+  });
+
   describe(".children", () => {
     it("returns an array of child nodes", () => {
       const tree = parser.parse("x10 + 1000");
@@ -76,6 +106,36 @@ describe("Node", () => {
     });
   });
 
+  describe(".childrenSlice(), .namedChildrenSlice()", () => {
+    it("returns a range of the node's children", () => {
+      const tree = parser.parse("x10 + 1000");
+      const sumNode = tree.rootNode.firstChild.firstChild;
+      assert.deepEqual(sumNode.childrenSlice(1, 2).map(child => child.type), ["+", "number"]);
+      assert.deepEqual(sumNode.childrenSlice(2).map(child => child.type), ["number"]);
+      assert.deepEqual(sumNode.childrenSlice(5, 2), []);
+      assert.deepEqual(sumNode.namedChildrenSlice(1, 1).map(child => child.type), ["number"]);
+    });
+
+    it("returns the same children as .child() for very wide nodes", () => {
+      const elements = Array.from({length: 1000}, (_, i) => String(i));
+      const tree = parser.parse(`[${elements.join(', ')}]`);
+      const arrayNode = tree.rootNode.firstChild.firstChild;
+      assert.equal(arrayNode.namedChildCount, 1000);
+
+      const slice = arrayNode.namedChildrenSlice(500, 3);
+      assert.deepEqual(slice.map(child => child.text), ["500", "501", "502"]);
+      assert.equal(slice[0], arrayNode.namedChild(500));
+      assert.equal(arrayNode.namedChild(999).text, "999");
+      assert.equal(arrayNode.namedChild(1000), null);
+      assert.equal(arrayNode.child(1).text, "0");
+      assert.equal(arrayNode.child(2).type, ",");
+      assert.deepEqual(
+        arrayNode.childrenSlice(arrayNode.childCount - 2).map(child => child.type),
+        ["number", "]"]
+      );
+    });
+  });
+
   describe(".startIndex and .endIndex", () => {
     it("returns the character index where the node starts/ends in the text", () => {
       const tree = parser.parse("a👍👎1 / b👎c👎");
@@ -305,6 +365,21 @@ describe("Node", () => {
         [4, 12]
       );
     })
+
+    it('finds the subtypes of supertypes', () => {
+      const tree = parser.parse("a(b + c)");
+      assert.deepEqual(
+        tree.rootNode.descendantsOfType('expression').map(node => node.text),
+        ['a(b + c)', 'a', 'b + c', 'b', 'c']
+      );
+
+      const metadata = Parser.Language.getMetadata(JavaScript);
+      const expressionId = metadata.nodeTypeNamesById.indexOf('expression');
+      const identifierId = tree.rootNode.descendantForIndex(0).typeId;
+      assert.isTrue(metadata.isSubtype(expressionId, identifierId));
+      assert.isFalse(metadata.isSubtype(expressionId, tree.rootNode.typeId));
+      assert.equal(metadata.symbolFlags[identifierId], Parser.Language.SYMBOL_VISIBLE | Parser.Language.SYMBOL_NAMED);
+    })
   });
 
   describe('.closest(type)', () => {
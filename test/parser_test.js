@@ -2,6 +2,7 @@ const Parser = require("..");
 const JavaScript = require('tree-sitter-javascript');
 const { assert } = require("chai");
 const {TextBuffer} = require('superstring');
+const {ParseTrace, Query} = Parser;
 
 describe("Parser", () => {
   let parser;
@@ -17,6 +18,346 @@ describe("Parser", () => {
     });
   });
 
+  describe("Language.load", () => {
+    const libraryPath = require.resolve('tree-sitter-javascript/build/Release/tree_sitter_javascript_binding.node');
+
+    it("registers the supertypes of node types that are given after the language was used", () => {
+      const language = Parser.Language.load(libraryPath, 'tree_sitter_javascript');
+      parser.setLanguage(language);
+      parser.parse('a');
+
+      Parser.Language.load(libraryPath, 'tree_sitter_javascript', {nodeTypeInfo: JavaScript.nodeTypeInfo});
+      const tree = parser.parse('a(b)');
+      assert.deepEqual(tree.rootNode.descendantsOfType('expression').map(node => node.text), ['a(b)', 'a', 'b']);
+      const metadata = Parser.Language.getMetadata(language);
+      assert.include(Array.from(metadata.supertypeSymbols), metadata.nodeTypeNamesById.indexOf('expression'));
+    });
+
+    it("loads a language from a shared library", () => {
+      const language = Parser.Language.load(libraryPath, 'tree_sitter_javascript', {
+        nodeTypeInfo: JavaScript.nodeTypeInfo
+      });
+      assert.equal(Parser.Language.load(libraryPath, 'tree_sitter_javascript'), language);
+
+      parser.setLanguage(language);
+      const tree = parser.parse('a(b)');
+      assert.equal(tree.rootNode.firstChild.firstChild.constructor.name, 'CallExpressionNode');
+      assert.equal(tree.rootNode.firstChild.firstChild.functionNode.text, 'a');
+    });
+
+    it("throws an exception when the library or symbol can't be found", () => {
+      assert.throws(() => Parser.Language.load(libraryPath, 'tree_sitter_nothing'), /Could not find symbol tree_sitter_nothing/);
+      assert.throws(() => Parser.Language.load(libraryPath + '.missing', 'tree_sitter_javascript'));
+    });
+  });
+
+  describe("Parser.detectLanguage", () => {
+    it("parses the input with each candidate language and returns the best one", async () => {
+      const result = await Parser.detectLanguage('a + b;', [JavaScript]);
+      assert.equal(result.language, JavaScript);
+      assert.equal(result.errorCount, 0);
+      assert.equal(result.tree.rootNode.toString(), '(program (expression_statement (binary_expression left: (identifier) right: (identifier))))');
+    });
+
+    it("scores trees by their errors", async () => {
+      const result = await Parser.detectLanguage('a + ) b;', [JavaScript]);
+      assert.equal(result.errorCount, 1);
+      assert.equal(result.errorCost, 1);
+    });
+
+    it("only parses a prefix of the input", async () => {
+      const result = await Parser.detectLanguage('a + b;\n'.repeat(100), [JavaScript], {prefixBytes: 10});
+      assert.equal(result.tree.rootNode.text, 'a + b;\n');
+    });
+
+    it("resolves to null when there are no candidates", async () => {
+      assert.equal(await Parser.detectLanguage('a', []), null);
+    });
+  });
+
+  describe(".setLogBuffer", () => {
+    beforeEach(() => {
+      parser.setLanguage(JavaScript);
+    });
+
+    afterEach(() => {
+      parser.setLogBuffer(false);
+    });
+
+    it("stores parse and lex events until they are drained", () => {
+      parser.setLogBuffer({capacity: 64 * 1024});
+      parser.parse("a + b + c");
+
+      const {entries} = parser.drainLog();
+      assert.includeMembers(entries.map(entry => entry.message), ["reduce", "accept", "shift"]);
+      assert.includeMembers(entries.map(entry => entry.type), ["parse", "lex"]);
+      assert.equal(null, parser.getLogger());
+    });
+
+    it("drops the oldest records when the buffer is full", () => {
+      parser.setLogBuffer({capacity: 256});
+      parser.parse("a + b + c + d + e + f");
+
+      const {entries, droppedCount} = parser.drainLog();
+      assert.isAbove(droppedCount, 0);
+      assert.equal(entries[entries.length - 1].message, "done");
+    });
+  });
+
+  describe(".startTrace", () => {
+    beforeEach(() => {
+      parser.setLanguage(JavaScript);
+    });
+
+    it("records timed parse actions that can be saved and analyzed", () => {
+      const source = "a + b;\nc + ) d;\n";
+      parser.startTrace();
+      parser.parse(source);
+      const trace = ParseTrace.fromBuffer(parser.stopTrace().toBuffer());
+      assert.equal(null, parser.drainLog());
+
+      assert.isAbove(trace.entries.length, 0);
+      assert(trace.entries.every(entry => typeof entry.elapsed === 'number'));
+
+      const summary = trace.analyze({source});
+      assert.includeMembers(summary.messages.map(m => m.message), ["reduce", "accept", "shift"]);
+      assert.isAbove(summary.states.length, 0);
+      assert.isAbove(summary.errorRecoveryRegions.length, 0);
+      assert.equal(summary.errorRecoveryRegions[0].startPosition.row, 1);
+      assert.isAtLeast(summary.errorRecoveryRegions[0].startIndex, source.indexOf('\n'));
+    });
+
+    it("reports positions in the given encoding", () => {
+      const source = "'αβγ';\n'αβγ' + ) d;\n";
+      parser.startTrace();
+      parser.parse(source, null, {positionEncoding: 'utf8'});
+      const trace = parser.stopTrace();
+
+      const utf16Region = trace.analyze({source}).errorRecoveryRegions[0];
+      const utf8Region = trace.analyze({source, positionEncoding: 'utf8'}).errorRecoveryRegions[0];
+      const utf16Prefix = source.slice(0, utf16Region.startIndex);
+      assert.equal(utf8Region.startIndex, Buffer.byteLength(utf16Prefix, 'utf8'));
+      assert.equal(utf8Region.startPosition.column, Buffer.byteLength(utf16Prefix.slice(source.indexOf('\n') + 1), 'utf8'));
+      assert.throws(() => trace.analyze({positionEncoding: 'utf8'}), /requires the source/);
+    });
+  });
+
+  describe(".enableParseStats", () => {
+    beforeEach(() => {
+      parser.setLanguage(JavaScript);
+    });
+
+    it("reports the time spent in each phase of the parse", () => {
+      parser.enableParseStats();
+      const tree = parser.parse("a + b;\nc + ) d;\n");
+      const stats = tree.parseStats;
+      assert.isAbove(stats.totalTime, 0);
+      assert.isAbove(stats.lexTime, 0);
+      assert.isAbove(stats.lexCount, 0);
+      assert.isAbove(stats.shiftCount, 0);
+      assert.isAbove(stats.reduceCount, 0);
+      assert.isAbove(stats.errorCount, 0);
+      assert.isAtMost(stats.lexTime + stats.parseTime + stats.errorRecoveryTime + stats.reuseTime, stats.totalTime);
+      assert.isAbove(stats.loggingTime, 0);
+      assert.deepEqual(parser.getParseStats(), stats);
+    });
+
+    it("can't be read during an asynchronous parse", async () => {
+      parser.enableParseStats();
+      const promise = parser.parseTextBuffer(new TextBuffer('a + b;\n'.repeat(1000)), null, {syncTimeoutMicros: 0});
+      assert.throws(() => parser.getParseStats(), /Parser is in use/);
+      await promise;
+      assert.isAbove(parser.getParseStats().shiftCount, 0);
+    });
+
+    it("reports the subtrees that were reused from the old tree", () => {
+      parser.enableParseStats();
+      const sourceCode = "function a() { return 1; }\nfunction b() { return 2; }\n";
+      const tree = parser.parse(sourceCode);
+      assert.equal(tree.parseStats.reusedSubtreeCount, 0);
+
+      const index = sourceCode.indexOf('2');
+      tree.edit({
+        startIndex: index,
+        oldEndIndex: index + 1,
+        newEndIndex: index + 1,
+        startPosition: {row: 1, column: index - sourceCode.indexOf('\n') - 1},
+        oldEndPosition: {row: 1, column: index - sourceCode.indexOf('\n')},
+        newEndPosition: {row: 1, column: index - sourceCode.indexOf('\n')},
+      });
+      const newTree = parser.parse(sourceCode.replace('2', '3'), tree);
+      assert.isAbove(newTree.parseStats.reusedSubtreeCount, 0);
+      assert.isAtLeast(newTree.parseStats.reusedBytes, 2 * "function a() { return 1; }".length);
+      assert.isBelow(newTree.parseStats.reusedBytes, 2 * sourceCode.length);
+    });
+
+    it("does not call logging callbacks from background threads", async () => {
+      const messages = [];
+      parser.setLogger(message => messages.push(message));
+      parser.enableParseStats();
+
+      const tree = await parser.parseTextBuffer(new TextBuffer('first-word second-word'));
+      assert.equal(messages.length, 0);
+      assert.isAbove(tree.parseStats.shiftCount, 0);
+
+      parser.parse('first-word second-word');
+      assert.isAbove(messages.length, 0);
+    });
+
+    it("can be disabled", () => {
+      parser.enableParseStats();
+      parser.enableParseStats(false);
+      assert.equal(parser.parse("a").parseStats, undefined);
+      assert.equal(parser.getParseStats(), null);
+    });
+  });
+
+  describe("Parser.metrics", () => {
+    it("counts the work done by the binding", () => {
+      parser.setLanguage(JavaScript);
+      const before = Parser.metrics();
+      const tree = parser.parse("a + b;");
+      tree.rootNode.firstChild.firstChild.children;
+      const after = Parser.metrics();
+
+      assert.equal(after.parses, before.parses + 1);
+      assert.equal(after.parseBytes, before.parseBytes + 2 * "a + b;".length);
+      assert.isAbove(after.parseTimeNanoseconds, before.parseTimeNanoseconds);
+      assert.isAbove(after.nodesMarshalled, before.nodesMarshalled);
+      assert.equal(
+        after.nodesMarshalled - before.nodesMarshalled,
+        (after.nodeCacheHits - before.nodeCacheHits) + (after.nodeCacheMisses - before.nodeCacheMisses)
+      );
+      assert.equal(after.treesCreated, before.treesCreated + 1);
+      assert.isAbove(after.nodesCached, before.nodesCached);
+      assert.equal(after.nativeCalls['Parser.parse'], (before.nativeCalls['Parser.parse'] || 0) + 1);
+      assert.isAbove(after.nativeCalls['SyntaxNode.children'], 0);
+    });
+
+    it("can be formatted as Prometheus text", () => {
+      parser.setLanguage(JavaScript);
+      parser.parse("a + b;");
+      const text = Parser.metrics({format: 'prometheus'});
+      assert.match(text, /^# TYPE tree_sitter_parses_total counter$/m);
+      assert.match(text, /^tree_sitter_parses_total [1-9]\d*$/m);
+      assert.match(text, /^tree_sitter_transfer_buffer_bytes \d+$/m);
+      assert.match(text, /^tree_sitter_native_calls_total\{method="Parser\.parse"\} [1-9]\d*$/m);
+    });
+  });
+
+  describe("Parser.startTracing", () => {
+    afterEach(() => {
+      Parser.stopTracing();
+    });
+
+    it("records spans for parses and queries", () => {
+      parser.setLanguage(JavaScript);
+      Parser.startTracing();
+      const tree = parser.parse("a + b;");
+      tree.edit({
+        startIndex: 0,
+        oldEndIndex: 1,
+        newEndIndex: 2,
+        startPosition: {row: 0, column: 0},
+        oldEndPosition: {row: 0, column: 1},
+        newEndPosition: {row: 0, column: 2},
+      });
+      parser.parse("ab + b;", tree);
+      new Query(JavaScript, "(identifier) @id").captures(tree.rootNode);
+      const {traceEvents, droppedCount} = Parser.stopTracing();
+
+      assert.equal(droppedCount, 0);
+      assert.deepEqual(traceEvents.map(event => [event.cat, event.name]), [
+        ['tree-sitter.parse', 'Parser.parse'],
+        ['tree-sitter.incremental_parse', 'Parser.parse'],
+        ['tree-sitter.query', 'Query.captures'],
+      ]);
+      assert.equal(traceEvents[0].ph, 'X');
+      assert.equal(traceEvents[0].pid, process.pid);
+      assert.equal(traceEvents[0].args.bytes, 2 * "a + b;".length);
+      assert.isAtLeast(traceEvents[1].ts, traceEvents[0].ts + traceEvents[0].dur);
+      assert.equal(traceEvents[2].args.captureCount, 2);
+    });
+
+    it("only records the given categories", () => {
+      parser.setLanguage(JavaScript);
+      Parser.startTracing({categories: ['query']});
+      const tree = parser.parse("a + b;");
+      new Query(JavaScript, "(identifier) @id").matches(tree.rootNode);
+      const {traceEvents} = Parser.stopTracing();
+      assert.deepEqual(traceEvents.map(event => event.name), ['Query.matches']);
+    });
+
+    it("throws on unknown categories", () => {
+      assert.throws(() => Parser.startTracing({categories: ['lex']}), /Unknown tracing category/);
+    });
+  });
+
+  describe("Parser.setSlowLog", () => {
+    afterEach(() => {
+      Parser.setSlowLog(false);
+    });
+
+    it("records parses and queries that exceed the thresholds", () => {
+      parser.setLanguage(JavaScript);
+      Parser.setSlowLog({parseThreshold: 0, queryThreshold: 0});
+      const tree = parser.parse("a + b;");
+      tree.edit({
+        startIndex: 0,
+        oldEndIndex: 1,
+        newEndIndex: 2,
+        startPosition: {row: 0, column: 0},
+        oldEndPosition: {row: 0, column: 1},
+        newEndPosition: {row: 0, column: 2},
+      });
+      parser.parse("ab + b;", tree);
+      new Query(JavaScript, "(identifier) @id (number) @number").captures(tree.rootNode);
+      const {entries, droppedCount} = Parser.drainSlowLog();
+
+      assert.equal(droppedCount, 0);
+      assert.deepEqual(entries.map(entry => [entry.operation, entry.method]), [
+        ['parse', 'Parser.parse'],
+        ['reparse', 'Parser.parse'],
+        ['captures', 'Query.captures'],
+      ]);
+      assert.equal(entries[0].inputBytes, 2 * "a + b;".length);
+      assert.isAtLeast(entries[0].duration, 0);
+      assert.isAbove(entries[1].changedBytes, 0);
+      assert.equal(entries[2].resultCount, 2);
+      assert.deepEqual(entries[2].patterns, [{index: 0, resultCount: 2}]);
+      assert.deepEqual(Parser.drainSlowLog().entries, []);
+    });
+
+    it("records one entry for a parse that continues in the background", async () => {
+      parser.setLanguage(JavaScript);
+      Parser.setSlowLog({parseThreshold: 0});
+      const sourceCode = 'a + b;\n'.repeat(10000);
+      await parser.parseTextBuffer(new TextBuffer(sourceCode), null, {syncTimeoutMicros: 1});
+      const {entries} = Parser.drainSlowLog();
+      assert.deepEqual(entries.map(entry => [entry.operation, entry.method]), [['parse', 'Parser.parseTextBuffer']]);
+      assert.equal(entries[0].inputBytes, 2 * sourceCode.length);
+    });
+
+    it("ignores operations below the thresholds", () => {
+      parser.setLanguage(JavaScript);
+      Parser.setSlowLog({parseThreshold: 60000, queryThreshold: null});
+      const tree = parser.parse("a + b;");
+      new Query(JavaScript, "(identifier) @id").matches(tree.rootNode);
+      assert.deepEqual(Parser.drainSlowLog().entries, []);
+    });
+
+    it("discards the oldest entries when it is full", () => {
+      parser.setLanguage(JavaScript);
+      Parser.setSlowLog({parseThreshold: 0, capacity: 2});
+      parser.parse("a;");
+      parser.parse("ab;");
+      parser.parse("abc;");
+      const {entries, droppedCount} = Parser.drainSlowLog();
+      assert.equal(droppedCount, 1);
+      assert.deepEqual(entries.map(entry => entry.inputBytes), [6, 8]);
+    });
+  });
+
   describe(".setLogger", () => {
     let debugMessages;
 
@@ -166,6 +507,89 @@ describe("Parser", () => {
         );
       })
     })
+
+    describe('when the `positionEncoding` option is given', () => {
+      const sourceCode = 'αβ + "👍";\nδ';
+
+      it('reports indices and columns in UTF-8 code units', () => {
+        const tree = parser.parse(sourceCode, null, {positionEncoding: 'utf8'});
+        assert.equal(tree.positionEncoding, 'utf8');
+
+        const stringNode = tree.rootNode.descendantsOfType('string')[0];
+        assert.equal(stringNode.startIndex, 7);
+        assert.equal(stringNode.endIndex, 13);
+        assert.deepEqual(stringNode.endPosition, {row: 0, column: 13});
+        assert.equal(stringNode.text, '"👍"');
+
+        const lastNode = tree.rootNode.lastChild;
+        assert.equal(lastNode.startIndex, 15);
+        assert.deepEqual(lastNode.startPosition, {row: 1, column: 0});
+        assert.equal(tree.rootNode.descendantForIndex(15).text, 'δ');
+        assert.equal(tree.rootNode.descendantForPosition({row: 1, column: 0}).text, 'δ');
+      });
+
+      it('reports indices and columns in UTF-32 code units', () => {
+        const tree = parser.parse(sourceCode, null, {positionEncoding: 'utf32'});
+        const stringNode = tree.rootNode.descendantsOfType('string')[0];
+        assert.equal(stringNode.startIndex, 5);
+        assert.equal(stringNode.endIndex, 8);
+        assert.deepEqual(stringNode.endPosition, {row: 0, column: 8});
+      });
+
+      it('reads callback inputs only once', () => {
+        const offsetsRead = positionEncoding => {
+          const offsets = [];
+          const tree = parser.parse(offset => {
+            offsets.push(offset);
+            return sourceCode.slice(offset);
+          }, null, {positionEncoding});
+          return {tree, offsets};
+        };
+
+        const {tree, offsets} = offsetsRead('utf8');
+        assert.deepEqual(offsets, offsetsRead('utf16').offsets);
+        assert.equal(tree.rootNode.lastChild.startIndex, 15);
+      });
+
+      it('applies edits expressed in the same encoding', () => {
+        let input = sourceCode;
+        const tree = parser.parse(input, null, {positionEncoding: 'utf8'});
+        const lastNode = tree.rootNode.lastChild;
+
+        input = 'ü' + input;
+        tree.edit({
+          startIndex: 0,
+          oldEndIndex: 0,
+          newEndIndex: 2,
+          startPosition: {row: 0, column: 0},
+          oldEndPosition: {row: 0, column: 0},
+          newEndPosition: {row: 0, column: 2},
+          newText: 'ü'
+        });
+        assert.equal(lastNode.startIndex, 17);
+
+        const newTree = parser.parse(input, tree);
+        assert.equal(newTree.positionEncoding, 'utf8');
+        assert.equal(newTree.rootNode.lastChild.startIndex, 17);
+        assert.equal(newTree.rootNode.firstChild.firstChild.firstChild.text, 'üαβ');
+      });
+
+      it('requires the inserted text when editing', () => {
+        const tree = parser.parse(sourceCode, null, {positionEncoding: 'utf8'});
+        assert.throws(() => tree.edit({
+          startIndex: 0,
+          oldEndIndex: 0,
+          newEndIndex: 1,
+          startPosition: {row: 0, column: 0},
+          oldEndPosition: {row: 0, column: 0},
+          newEndPosition: {row: 0, column: 1},
+        }), /newText/);
+      });
+
+      it('rejects unknown encodings', () => {
+        assert.throws(() => parser.parse(sourceCode, null, {positionEncoding: 'latin1'}), /Unknown position encoding/);
+      });
+    });
   });
 
   describe('.parseTextBuffer', () => {
@@ -252,6 +676,25 @@ describe("Parser", () => {
       assert.equal(tree3.rootNode.toString(), tree1.rootNode.toString())
     })
 
+    it('writes log records to a log buffer when parsing asynchronously', async () => {
+      parser.setLogBuffer({capacity: 64 * 1024});
+
+      const buffer = new TextBuffer('first-word second-word');
+      await parser.parseTextBuffer(buffer);
+      const {entries, droppedCount} = parser.drainLog();
+      assert.equal(droppedCount, 0);
+      assert.includeMembers(entries.map(entry => entry.message), ['shift', 'reduce', 'accept']);
+
+      const reduce = entries.find(entry => entry.message === 'reduce');
+      assert.equal(reduce.type, 'parse');
+      assert.equal(typeof reduce.params.sym, 'string');
+      assert.equal(typeof reduce.params.child_count, 'number');
+
+      assert.deepEqual(parser.drainLog().entries, []);
+      parser.setLogBuffer(false);
+      assert.equal(parser.drainLog(), null);
+    })
+
     describe('when the `includedRanges` option is given', () => {
       it('parses the text within those ranges of the string', async () => {
         const sourceCode = "<% foo() %> <% bar %>";
@@ -55,6 +55,19 @@ describe("Query", () => {
         { pattern: 0, captures: [{ name: "element", text: "g" }] },
       ]);
     });
+
+    it("counts the matches that are produced and dropped by predicates", () => {
+      const tree = parser.parse("a(); b(); a();");
+      const query = new Query(JavaScript, `
+        ((identifier) @name (#eq? @name "a"))
+      `);
+      const before = Parser.metrics();
+      const matches = query.matches(tree.rootNode);
+      const after = Parser.metrics();
+      assert.equal(matches.length, 2);
+      assert.equal(after.queryMatches - before.queryMatches, 3);
+      assert.equal(after.queryMatchesDropped - before.queryMatchesDropped, 1);
+    });
   });
 
   describe(".captures", () => {
@@ -175,6 +188,55 @@ describe("Query", () => {
       ]);
     });
   });
+
+  describe(".rewrite", () => {
+    it("replaces captures with templates that refer to other captures", () => {
+      const tree = parser.parse("foo(a, b);\nbar(c);\n");
+      const query = new Query(JavaScript, `
+        (call_expression function: (identifier) @fn arguments: (arguments) @args) @call
+      `);
+
+      const {text, edits} = query.rewrite(tree, {call: "@fn.call(this, @args@@)"});
+      assert.equal(text, "foo.call(this, (a, b)@);\nbar.call(this, (c)@);\n");
+      assert.deepEqual(edits.map(({startIndex, oldEndIndex, newText}) => [startIndex, oldEndIndex, newText]), [
+        [11, 17, "bar.call(this, (c)@)"],
+        [0, 9, "foo.call(this, (a, b)@)"],
+      ]);
+      assert.deepEqual(edits[0].startPosition, {row: 1, column: 0});
+      assert.deepEqual(edits[0].newEndPosition, {row: 1, column: 20});
+
+      assert.throws(() => query.rewrite(tree, {nope: ""}), "The query has no capture named @nope");
+      assert.throws(() => query.rewrite(tree, {call: "@nope"}), "Template refers to an unknown capture");
+    });
+
+    it("drops edits that overlap earlier ones", () => {
+      const tree = parser.parse("a(b(c));");
+      const query = new Query(JavaScript, `(call_expression function: (identifier) @fn) @call`);
+      const {text, edits} = query.rewrite(tree, {call: "wrapped(@fn)"});
+      assert.equal(text, "wrapped(a);");
+      assert.equal(edits.length, 1);
+    });
+
+    it("only rewrites matches that satisfy the query's predicates", () => {
+      const tree = parser.parse("foo(); bar(); baz(); qux();");
+      const query = new Query(JavaScript, `
+        ((call_expression function: (identifier) @fn) (#eq? @fn "foo"))
+        ((call_expression function: (identifier) @fn) (#match? @fn "^ba"))
+      `);
+      const {text} = query.rewrite(tree, {fn: "x.@fn"});
+      assert.equal(text, "x.foo(); x.bar(); x.baz(); qux();");
+    });
+
+    it("can edit and reparse the tree", () => {
+      const tree = parser.parse("let a = 1;\nlet b = 2;\n");
+      const query = new Query(JavaScript, `(lexical_declaration "let" @kind)`);
+      const result = query.rewrite(tree, {kind: "const"}, {parser});
+      assert.equal(result.text, "const a = 1;\nconst b = 2;\n");
+      assert.equal(result.tree.rootNode.toString(), parser.parse(result.text).rootNode.toString());
+      assert.equal(result.tree.rootNode.child(1).startPosition.row, 1);
+      assert.equal(tree.rootNode.endIndex, result.text.length);
+    });
+  });
 });
 
 function formatMatches(tree, matches) {
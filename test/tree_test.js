@@ -305,6 +305,272 @@ describe("Tree", () => {
       assert(!cursor.gotoParent());
     })
   });
+
+  describe(".buildRangeIndex()", () => {
+    const source = 'function a() { b(); }\nfunction c() { d(e()); }\n';
+
+    it('finds the indexed nodes that overlap, contain, or lie within a range', () => {
+      const tree = parser.parse(source);
+      const index = tree.buildRangeIndex(['function_declaration', 'call_expression']);
+      assert.equal(index.size, 5);
+
+      assert.deepEqual(
+        index.overlapping(source.indexOf('d('), source.indexOf('d(') + 1).map(node => node.text),
+        ['function c() { d(e()); }', 'd(e())']
+      );
+      assert.deepEqual(
+        index.containing(source.indexOf('e(')).map(node => node.text),
+        ['function c() { d(e()); }', 'd(e())', 'e()']
+      );
+      assert.deepEqual(
+        index.within(0, source.indexOf('\n')).map(node => node.text),
+        ['function a() { b(); }', 'b()']
+      );
+
+      const node = index.overlapping(source.indexOf('b('))[1];
+      assert.equal(node, tree.rootNode.namedDescendantForIndex(15, 18));
+    });
+
+    it('follows edits to the tree, and can be updated to a new tree', () => {
+      let input, edit;
+      const tree = parser.parse(source);
+      const index = tree.buildRangeIndex('call_expression');
+
+      ([input, edit] = spliceInput(source, source.indexOf('b();'), 0, 'f(); '));
+      tree.edit(edit);
+      assert.deepEqual(
+        index.overlapping(0, input.length).map(node => [node.startIndex, node.endIndex]),
+        [[20, 23], [42, 48], [44, 47]]
+      );
+
+      const newTree = parser.parse(input, tree);
+      index.update(newTree);
+      assert.equal(index.tree, newTree);
+      assert.deepEqual(
+        index.overlapping(0, input.length).map(node => node.text),
+        ['f()', 'b()', 'd(e())', 'e()']
+      );
+    });
+
+    it('returns the nodes of the new tree outside of the changed ranges', () => {
+      const functions = [];
+      for (let i = 0; i < 200; i++) functions.push(`function f${i}() { g${i}(); }`);
+      let input = functions.join('\n'), edit;
+      const tree = parser.parse(input);
+      const index = tree.buildRangeIndex('call_expression');
+
+      ([input, edit] = spliceInput(input, input.indexOf('g0('), 2, 'h0'));
+      tree.edit(edit);
+      const newTree = parser.parse(input, tree);
+      index.update(newTree);
+
+      const start = input.indexOf('function f100'), end = input.indexOf('function f103');
+      const nodes = index.overlapping(start, end);
+      assert.deepEqual(nodes.map(node => node.text), ['g100()', 'g101()', 'g102()']);
+      assert.equal(nodes[1], newTree.rootNode.namedDescendantForIndex(nodes[1].startIndex, nodes[1].endIndex));
+      assert.equal(nodes[1].tree, newTree);
+
+      ([input, edit] = spliceInput(input, 0, 0, '\n'));
+      newTree.edit(edit);
+      assert.deepEqual(
+        index.overlapping(start + 1, end + 1).map(node => [node.startIndex, node.startPosition.row]),
+        [[start + 19, 101], [start + 47, 102], [start + 75, 103]]
+      );
+    });
+
+    it('applies edits to the nodes that a query returns', () => {
+      const functions = [];
+      for (let i = 0; i < 200; i++) functions.push(`function f${i}() { g${i}(); }`);
+      let input = functions.join('\n'), edit;
+      const tree = parser.parse(input);
+      const index = tree.buildRangeIndex(['function_declaration', 'call_expression']);
+      assert.equal(index.size, 400);
+
+      const before = index.overlapping(input.indexOf('g150('));
+      for (let i = 0; i < 3; i++) {
+        ([input, edit] = spliceInput(input, input.indexOf(`g${50 * i}(`), 0, '\n'));
+        tree.edit(edit);
+      }
+
+      const start = input.indexOf('g150(');
+      const after = index.overlapping(start);
+      assert.equal(after[1], before[1]);
+      assert.deepEqual(after.map(node => [node.startIndex, node.startPosition]), [
+        [input.indexOf('function f150'), {row: 153, column: 0}],
+        [start, {row: 153, column: 18}],
+      ]);
+      assert.deepEqual(index.overlapping(input.indexOf('g50(')).map(node => [node.startPosition, node.endPosition]), [
+        [{row: 51, column: 0}, {row: 52, column: 8}],
+        [{row: 52, column: 0}, {row: 52, column: 5}],
+      ]);
+    });
+
+    it('throws an exception if the types are invalid', () => {
+      const tree = parser.parse(source);
+      assert.throws(() => tree.buildRangeIndex({}), /Argument must be a string or array of strings/);
+    });
+  });
+
+  describe(".chunk()", () => {
+    it('packs sibling subtrees into chunks, descending into those that are too large', () => {
+      const source = 'function a() { b(); }\nfunction c() { d(e()); }\nconst x = 1;';
+      const tree = parser.parse(source);
+
+      assert.deepEqual(chunkTexts(source, tree.chunk({maxBytes: 1000})), [source]);
+      assert.deepEqual(chunkTexts(source, tree.chunk({maxBytes: 30})), [
+        'function a() { b(); }\n',
+        'function c() { d(e()); }\n',
+        'const x = 1;'
+      ]);
+      assert.deepEqual(chunkTexts(source, tree.chunk({maxBytes: 16})), [
+        'function a() ',
+        '{ b(); }\n',
+        'function c() ',
+        '{ d(e()); }\n',
+        'const x = 1;'
+      ]);
+    });
+
+    it('cuts chunks at nodes of the preferred types when possible', () => {
+      const source = 'let a = 1;\nfunction f() {}\nlet b = 2;\nlet c = 3;';
+      const tree = parser.parse(source);
+
+      assert.deepEqual(chunkTexts(source, tree.chunk({maxBytes: 30})), [
+        'let a = 1;\nfunction f() {}\n',
+        'let b = 2;\nlet c = 3;'
+      ]);
+      assert.deepEqual(chunkTexts(source, tree.chunk({maxBytes: 30, preferTypes: 'function_declaration'})), [
+        'let a = 1;\n',
+        'function f() {}\nlet b = 2;\n',
+        'let c = 3;'
+      ]);
+    });
+
+    it('puts tokens that are larger than the maximum in chunks of their own', () => {
+      const source = 'a;\n/* a long comment */\nb;';
+      const tree = parser.parse(source);
+      assert.deepEqual(chunkTexts(source, tree.chunk({maxBytes: 8})), [
+        'a;\n',
+        '/* a long comment */',
+        '\nb;'
+      ]);
+    });
+
+    it('throws an exception if the maximum is invalid', () => {
+      const tree = parser.parse('a;');
+      assert.throws(() => tree.chunk({maxBytes: 0}), /maxBytes must be a positive integer/);
+      assert.throws(() => tree.chunk(), /maxBytes must be a positive integer/);
+    });
+  });
+
+  describe(".tokens()", () => {
+    const source = 'a = b /* c */ + 1;';
+
+    it('returns the leaves of the tree as parallel arrays', () => {
+      const tree = parser.parse(source);
+      const tokens = tree.tokens({includeText: true});
+      assert.deepEqual(tokenTypes(tree, tokens), ['identifier', '=', 'identifier', 'comment', '+', 'number', ';']);
+      assert.deepEqual(Array.from(tokens.startIndices), [0, 2, 4, 6, 14, 16, 17]);
+      assert.deepEqual(Array.from(tokens.endIndices), [1, 3, 5, 13, 15, 17, 18]);
+      assert.deepEqual(Array.from(tokens.isNamed), [1, 0, 1, 1, 0, 1, 0]);
+      assert.deepEqual(Array.from(tokens.isExtra), [0, 0, 0, 1, 0, 0, 0]);
+      assert.deepEqual(tokens.text, ['a', '=', 'b', '/* c */', '+', '1', ';']);
+    });
+
+    it('can leave out anonymous tokens and extras, and tokens outside of a range', () => {
+      const tree = parser.parse(source);
+      assert.deepEqual(
+        tokenTypes(tree, tree.tokens({includeAnonymous: false})),
+        ['identifier', 'identifier', 'comment', 'number']
+      );
+      assert.deepEqual(
+        tokenTypes(tree, tree.tokens({includeExtras: false})),
+        ['identifier', '=', 'identifier', '+', 'number', ';']
+      );
+      assert.deepEqual(
+        tree.tokens({range: {startIndex: 4, endIndex: 13}, includeText: true}).text,
+        ['b', '/* c */']
+      );
+      assert.equal(tree.tokens().text, undefined);
+    });
+
+    it('throws an exception if text is requested and the source is not retained', () => {
+      const tree = parser.parse(index => source.slice(index));
+      assert.throws(() => tree.tokens({includeText: true}), /Token text is only available/);
+    });
+  });
+
+  describe(".search()", () => {
+    const source = '// TODO: fix foo\nconst foo = "foo bar";\nfoo();';
+
+    it('finds the occurrences of a string within nodes of the given types', () => {
+      const tree = parser.parse(source);
+      assert.deepEqual(Array.from(tree.search('foo')), [13, 16, 23, 26, 30, 33, 40, 43]);
+      assert.deepEqual(Array.from(tree.search('foo', {inTypes: 'comment'})), [13, 16]);
+      assert.deepEqual(Array.from(tree.search('foo', {inTypes: ['string', 'comment']})), [13, 16, 30, 33]);
+      assert.deepEqual(Array.from(tree.search('foo', {notInTypes: ['comment', 'string']})), [23, 26, 40, 43]);
+      assert.deepEqual(
+        Array.from(tree.search('foo', {inTypes: 'lexical_declaration', notInTypes: 'string'})),
+        [23, 26]
+      );
+    });
+
+    it('can ignore case', () => {
+      const tree = parser.parse(source);
+      assert.deepEqual(Array.from(tree.search('todo')), []);
+      assert.deepEqual(Array.from(tree.search('todo', {caseInsensitive: true})), [3, 7]);
+    });
+
+    it('returns indices in the tree\'s position encoding', () => {
+      const tree = parser.parse('/* é */ a', null, {positionEncoding: 'utf8'});
+      assert.deepEqual(Array.from(tree.search('a')), [9, 10]);
+    });
+
+    it('throws an exception if the pattern is empty', () => {
+      const tree = parser.parse(source);
+      assert.throws(() => tree.search(''), /Pattern must be a non-empty string/);
+    });
+  });
+
+  describe(".addMarkerLayer()", () => {
+    it('moves the markers along with edits to the tree', () => {
+      let input = 'abc + cde + fgh', edit;
+      const tree = parser.parse(input);
+      const layer = tree.addMarkerLayer();
+
+      const first = layer.markRange(0, 3);
+      const [second, third] = layer.markRanges(new Uint32Array([6, 9, 4, 11]));
+      assert.equal(layer.size, 3);
+      assert.throws(() => layer.markRanges(new Uint32Array([0, 1, 2])), /an end index for each start index/);
+      assert.equal(layer.size, 3);
+
+      ([input, edit] = spliceInput(input, input.indexOf('de'), 1, 'xyz'));
+      assert.equal(input, 'abc + cxyze + fgh');
+      tree.edit(edit);
+
+      assert.deepEqual(layer.getRange(first), {startIndex: 0, endIndex: 3});
+      assert.deepEqual(layer.getRange(second), {startIndex: 6, endIndex: 11});
+      assert.deepEqual(
+        Array.from(layer.getRanges()),
+        [first, 0, 3, third, 4, 13, second, 6, 11]
+      );
+      assert.deepEqual(Array.from(layer.findOverlapping(11, 12)), [third, 4, 13]);
+      assert.deepEqual(Array.from(layer.findContaining(7)), [third, 4, 13, second, 6, 11]);
+
+      assert.isTrue(layer.remove(third));
+      assert.isFalse(layer.remove(third));
+      assert.equal(layer.getRange(third), undefined);
+
+      const newTree = parser.parse(input, tree);
+      layer.setTree(newTree);
+      ([input, edit] = spliceInput(input, 0, 0, '  '));
+      newTree.edit(edit);
+      assert.deepEqual(layer.getRange(second), {startIndex: 8, endIndex: 13});
+
+      layer.clear();
+      assert.equal(layer.size, 0);
+    });
+  });
 });
 
 function assertCursorState(cursor, params) {
@@ -324,6 +590,16 @@ function assertCursorState(cursor, params) {
   assert.deepEqual(node.endIndex, params.endIndex);
 }
 
+function tokenTypes(tree, {typeIds}) {
+  return Array.from(typeIds, id => tree.language.nodeTypeNamesById[id]);
+}
+
+function chunkTexts(source, chunks) {
+  const result = [];
+  for (let i = 0; i < chunks.length; i += 2) result.push(source.slice(chunks[i], chunks[i + 1]));
+  return result;
+}
+
 function spliceInput(input, startIndex, lengthRemoved, newText) {
   const oldEndIndex = startIndex + lengthRemoved;
   const newEndIndex = startIndex + newText.length;
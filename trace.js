@@ -0,0 +1,278 @@
+const LOG_TYPES = ['parse', 'lex'];
+const LOG_STRING_VALUE_FLAG = 1 << 16;
+const LOG_TYPE_FLAG = 1 << 24;
+const LOG_TIMESTAMP_FLAG = 1 << 25;
+
+const POSITION_ENCODINGS = ['utf8', 'utf16', 'utf32'];
+
+const TRACE_MAGIC = 'TSTRACE\0';
+const TRACE_FORMAT_VERSION = 1;
+
+/*
+ * Log records
+ */
+
+// Log buffers store each message as a header word, an optional timestamp
+// word, and a key word and value word per parameter. See `LogBuffer` in
+// src/logger.h.
+function decodeLogRecords(records, strings) {
+  const entries = [];
+  for (let i = 0; i < records.length;) {
+    const header = records[i++];
+    const entry = {
+      type: LOG_TYPES[header & LOG_TYPE_FLAG ? 1 : 0],
+      message: strings[header & 0xffff],
+      params: {}
+    };
+    if (header & LOG_TIMESTAMP_FLAG) entry.elapsed = records[i++];
+
+    const paramCount = (header >>> 16) & 0xff;
+    for (let j = 0; j < paramCount; j++) {
+      const key = records[i++];
+      const value = records[i++];
+      entry.params[strings[key & 0xffff]] = key & LOG_STRING_VALUE_FLAG ? strings[value] : value | 0;
+    }
+    entries.push(entry);
+  }
+  return entries;
+}
+
+/*
+ * ParseTrace
+ */
+
+class ParseTrace {
+  constructor(records, strings, droppedCount) {
+    this.records = records;
+    this.strings = strings;
+    this.droppedCount = droppedCount;
+    this._entries = null;
+  }
+
+  get entries() {
+    if (!this._entries) this._entries = decodeLogRecords(this.records, this.strings);
+    return this._entries;
+  }
+
+  // The file format is a magic number and version, followed by the number
+  // of dropped records, the string table, and the records. All integers are
+  // little-endian 32-bit values.
+  toBuffer() {
+    const encodedStrings = this.strings.map(string => Buffer.from(string, 'utf8'));
+    let size = TRACE_MAGIC.length + 4 * 4 + 4 * this.records.length;
+    for (const string of encodedStrings) size += 4 + string.length;
+
+    const buffer = Buffer.alloc(size);
+    let offset = buffer.write(TRACE_MAGIC, 0, 'latin1');
+    offset = buffer.writeUInt32LE(TRACE_FORMAT_VERSION, offset);
+    offset = buffer.writeUInt32LE(this.droppedCount, offset);
+    offset = buffer.writeUInt32LE(encodedStrings.length, offset);
+    for (const string of encodedStrings) {
+      offset = buffer.writeUInt32LE(string.length, offset);
+      offset += string.copy(buffer, offset);
+    }
+    offset = buffer.writeUInt32LE(this.records.length, offset);
+    for (let i = 0; i < this.records.length; i++) {
+      offset = buffer.writeUInt32LE(this.records[i], offset);
+    }
+    return buffer;
+  }
+
+  static fromBuffer(buffer) {
+    if (buffer.toString('latin1', 0, TRACE_MAGIC.length) !== TRACE_MAGIC) {
+      throw new Error('Not a parse trace');
+    }
+    let offset = TRACE_MAGIC.length;
+    const version = buffer.readUInt32LE(offset);
+    if (version !== TRACE_FORMAT_VERSION) {
+      throw new Error(`Unsupported parse trace version ${version}`);
+    }
+    const droppedCount = buffer.readUInt32LE(offset + 4);
+    const stringCount = buffer.readUInt32LE(offset + 8);
+    offset += 12;
+
+    const strings = new Array(stringCount);
+    for (let i = 0; i < stringCount; i++) {
+      const length = buffer.readUInt32LE(offset);
+      strings[i] = buffer.toString('utf8', offset + 4, offset + 4 + length);
+      offset += 4 + length;
+    }
+
+    const records = new Uint32Array(buffer.readUInt32LE(offset));
+    offset += 4;
+    for (let i = 0; i < records.length; i++, offset += 4) {
+      records[i] = buffer.readUInt32LE(offset);
+    }
+    return new ParseTrace(records, strings, droppedCount);
+  }
+
+  // Summarize where the parse spent its time and created stack versions.
+  // Times are in nanoseconds, and are attributed to the action that was
+  // logged before them. If the parsed source is given, positions are also
+  // mapped to indices in it.
+  //
+  // The runtime logs columns in UTF-16 bytes, whatever the position encoding
+  // of the parse was. Converting them to UTF-8 or UTF-32 requires the source.
+  analyze({source, positionEncoding = 'utf16', limit = 20} = {}) {
+    if (!POSITION_ENCODINGS.includes(positionEncoding)) {
+      throw new TypeError(`Unknown position encoding '${positionEncoding}'`);
+    }
+    if (positionEncoding !== 'utf16' && source == null) {
+      throw new TypeError(`Converting positions to ${positionEncoding} requires the source`);
+    }
+
+    const lineStarts = source == null ? null : lineStartIndices(source);
+    const encodedLineStarts = lineStarts && encodedLineStartIndices(source, lineStarts, positionEncoding);
+    const position = (row, byteColumn) => {
+      let column = byteColumn / 2;
+      if (!lineStarts) return {startPosition: {row, column}};
+      const lineStart = lineStarts[row] || 0;
+      if (positionEncoding !== 'utf16') {
+        column = encodedLength(source.slice(lineStart, lineStart + column), positionEncoding);
+      }
+      return {startPosition: {row, column}, startIndex: (encodedLineStarts[row] || 0) + column};
+    };
+
+    const messages = new Map();
+    const states = new Map();
+    const lexPositions = new Map();
+    const errorRecoveryRegions = [];
+    let totalTime = 0;
+    let maxVersionCount = 0;
+    let previous = null;
+    let current = null;
+    let region = null;
+
+    const statsForState = state => {
+      let stats = states.get(state);
+      if (!stats) states.set(state, stats = {state, processCount: 0, splitCount: 0, time: 0});
+      return stats;
+    };
+
+    const closeRegion = () => {
+      if (!region) return;
+      const end = position(region.endRow, region.endColumn);
+      errorRecoveryRegions.push({
+        startPosition: region.start.startPosition,
+        endPosition: end.startPosition,
+        startIndex: region.start.startIndex,
+        endIndex: end.startIndex,
+        actionCount: region.actionCount,
+        time: region.time
+      });
+      region = null;
+    };
+
+    for (const entry of this.entries) {
+      if (previous && entry.elapsed !== undefined) {
+        totalTime += entry.elapsed;
+        messages.get(previous.message).time += entry.elapsed;
+        if (current) statsForState(current.params.state).time += entry.elapsed;
+        if (region) region.time += entry.elapsed;
+      }
+
+      let stats = messages.get(entry.message);
+      if (!stats) messages.set(entry.message, stats = {message: entry.message, count: 0, time: 0});
+      stats.count++;
+      if (region) region.actionCount++;
+
+      const {params} = entry;
+      switch (entry.message) {
+        // The stack is split while the previous version was processed.
+        case 'process':
+          if (current && params.version_count > current.params.version_count) {
+            statsForState(current.params.state).splitCount += params.version_count - current.params.version_count;
+          }
+          current = entry;
+          statsForState(params.state).processCount++;
+          maxVersionCount = Math.max(maxVersionCount, params.version_count);
+          if (region) {
+            const isAfterStart = params.row > region.startRow ||
+              (params.row === region.startRow && params.col > region.startColumn);
+            if (isAfterStart) {
+              region.endRow = params.row;
+              region.endColumn = params.col;
+              if (params.version_count === 1) closeRegion();
+            }
+          }
+          break;
+
+        case 'lex_internal':
+        case 'lex_external': {
+          const key = `${params.row}:${params.column}`;
+          let lexStats = lexPositions.get(key);
+          if (!lexStats) lexPositions.set(key, lexStats = Object.assign(position(params.row, params.column), {count: 0}));
+          lexStats.count++;
+          break;
+        }
+
+        case 'detect_error':
+          if (!region && current) {
+            region = {
+              start: position(current.params.row, current.params.col),
+              startRow: current.params.row,
+              startColumn: current.params.col,
+              endRow: current.params.row,
+              endColumn: current.params.col,
+              actionCount: 1,
+              time: 0
+            };
+          }
+          break;
+
+        case 'accept':
+        case 'done':
+          closeRegion();
+          break;
+      }
+
+      previous = entry;
+    }
+    closeRegion();
+
+    const allStates = Array.from(states.values());
+    return {
+      recordCount: this.entries.length,
+      droppedCount: this.droppedCount,
+      totalTime,
+      maxVersionCount,
+      messages: Array.from(messages.values()).sort((a, b) => b.time - a.time || b.count - a.count),
+      states: allStates.slice().sort((a, b) => b.time - a.time).slice(0, limit),
+      splitStates: allStates.filter(s => s.splitCount > 0).sort((a, b) => b.splitCount - a.splitCount).slice(0, limit),
+      relexedPositions: Array.from(lexPositions.values())
+        .filter(p => p.count > 1)
+        .sort((a, b) => b.count - a.count)
+        .slice(0, limit),
+      errorRecoveryRegions
+    };
+  }
+}
+
+function lineStartIndices(source) {
+  const result = [0];
+  for (let i = source.indexOf('\n'); i !== -1; i = source.indexOf('\n', i + 1)) {
+    result.push(i + 1);
+  }
+  return result;
+}
+
+function encodedLineStartIndices(source, lineStarts, positionEncoding) {
+  if (positionEncoding === 'utf16') return lineStarts;
+  const result = [0];
+  for (let i = 1; i < lineStarts.length; i++) {
+    result.push(result[i - 1] + encodedLength(source.slice(lineStarts[i - 1], lineStarts[i]), positionEncoding));
+  }
+  return result;
+}
+
+function encodedLength(text, positionEncoding) {
+  if (positionEncoding === 'utf8') return Buffer.byteLength(text, 'utf8');
+  let result = 0;
+  for (let i = 0; i < text.length; i++) {
+    const unit = text.charCodeAt(i);
+    if (unit < 0xdc00 || unit > 0xdfff) result++;
+  }
+  return result;
+}
+
+module.exports = {ParseTrace, decodeLogRecords};
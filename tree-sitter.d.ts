@@ -1,13 +1,32 @@
 declare module "tree-sitter" {
   class Parser {
-    parse(input: string | Parser.Input | Parser.InputReader, oldTree?: Parser.Tree, options?: { bufferSize?: number, includedRanges?: Parser.Range[] }): Parser.Tree;
-    parseTextBuffer(buffer: Parser.TextBuffer, oldTree?: Parser.Tree, options?: { syncTimeoutMicros?: number, includedRanges?: Parser.Range[] }): Parser.Tree | Promise<Parser.Tree>;
-    parseTextBufferSync(buffer: Parser.TextBuffer, oldTree?: Parser.Tree, options?: { includedRanges?: Parser.Range[] }): Parser.Tree;
+    parse(input: string | Parser.Input | Parser.InputReader, oldTree?: Parser.Tree, options?: { bufferSize?: number, includedRanges?: Parser.Range[], positionEncoding?: Parser.PositionEncoding }): Parser.Tree;
+    parseTextBuffer(buffer: Parser.TextBuffer, oldTree?: Parser.Tree, options?: { syncTimeoutMicros?: number, includedRanges?: Parser.Range[], positionEncoding?: Parser.PositionEncoding }): Parser.Tree | Promise<Parser.Tree>;
+    parseTextBufferSync(buffer: Parser.TextBuffer, oldTree?: Parser.Tree, options?: { includedRanges?: Parser.Range[], positionEncoding?: Parser.PositionEncoding }): Parser.Tree;
     getLanguage(): any;
     setLanguage(language: any): void;
     getLogger(): Parser.Logger;
     setLogger(logFunc: Parser.Logger): void;
+    setLogBuffer(options: { capacity?: number } | false): Parser;
+    drainLog(): { entries: Parser.LogEntry[], droppedCount: number } | null;
+    startTrace(options?: { capacity?: number }): Parser;
+    stopTrace(): Parser.ParseTrace | null;
     printDotGraphs(enabled: boolean): void;
+    enableParseStats(enabled?: boolean): Parser;
+    getParseStats(): Parser.ParseStats | null;
+
+    static metrics(): Parser.Metrics;
+    static metrics(options: { format: "prometheus" }): string;
+    static startTracing(options?: { categories?: Parser.TracingCategory[], capacity?: number }): void;
+    static stopTracing(): { traceEvents: Parser.TraceEvent[], droppedCount: number };
+    static setSlowLog(options: { parseThreshold?: number | null, queryThreshold?: number | null, capacity?: number } | false): void;
+    static drainSlowLog(): { entries: Parser.SlowLogEntry[], droppedCount: number };
+    static detectLanguage(input: string, candidates: any[], options?: { prefixBytes?: number }): Promise<{
+      language: any,
+      tree: Parser.Tree,
+      errorCount: number,
+      errorCost: number
+    } | null>;
   }
 
   namespace Parser {
@@ -30,6 +49,26 @@ declare module "tree-sitter" {
       startPosition: Point;
       oldEndPosition: Point;
       newEndPosition: Point;
+      newText?: string;
+    };
+
+    export type PositionEncoding = "utf8" | "utf16" | "utf32";
+
+    export interface LanguageMetadata {
+      readonly nodeTypeNamesById: Array<string | null>;
+      readonly nodeFieldNamesById: Array<string | null>;
+      readonly symbolFlags: Uint8Array;
+      readonly supertypeSymbols: Uint16Array;
+      readonly subtypeSets: Uint32Array;
+      readonly wordsPerSymbolSet: number;
+      isSubtype(supertypeId: number, typeId: number): boolean;
+    }
+
+    export const Language: {
+      readonly SYMBOL_VISIBLE: number;
+      readonly SYMBOL_NAMED: number;
+      getMetadata(language: any): LanguageMetadata;
+      load(libraryPath: string, symbolName?: string, options?: { nodeTypeInfo?: any[] }): any;
     };
 
     export type Logger = (
@@ -38,6 +77,104 @@ declare module "tree-sitter" {
       type: "parse" | "lex"
     ) => void;
 
+    export interface Metrics {
+      nodesMarshalled: number;
+      nodeCacheHits: number;
+      nodeCacheMisses: number;
+      transferBufferGrowths: number;
+      transferBufferBytes: number;
+      cachedNodeUpdates: number;
+      nodesCached: number;
+      nodesFinalized: number;
+      treesCreated: number;
+      treesDeleted: number;
+      queryMatches: number;
+      queryCaptures: number;
+      queryMatchesDropped: number;
+      parses: number;
+      parseBytes: number;
+      parseTimeNanoseconds: number;
+      nativeCalls: {[method: string]: number};
+    }
+
+    export type TracingCategory = "parse" | "incremental_parse" | "query" | "marshal";
+
+    export interface TraceEvent {
+      name: string;
+      cat: string;
+      ph: "X";
+      ts: number;
+      dur: number;
+      pid: number;
+      tid: number;
+      args: {[arg: string]: string | number};
+    }
+
+    export interface SlowLogEntry {
+      operation: "parse" | "reparse" | "matches" | "captures";
+      method: string;
+      language: string;
+      time: number;
+      duration: number;
+      inputBytes: number;
+      changedBytes?: number;
+      resultCount?: number;
+      nodeCount?: number;
+      patterns?: { index: number, resultCount: number }[];
+    }
+
+    export interface ParseStats {
+      totalTime: number;
+      lexTime: number;
+      parseTime: number;
+      errorRecoveryTime: number;
+      reuseTime: number;
+      loggingTime: number;
+      lexCount: number;
+      shiftCount: number;
+      reduceCount: number;
+      errorCount: number;
+      reusedNodeCount: number;
+      reusedSubtreeCount: number;
+      reusedBytes: number;
+    }
+
+    export interface LogEntry {
+      type: "parse" | "lex";
+      message: string;
+      params: {[param: string]: string | number};
+      elapsed?: number;
+    }
+
+    export class ParseTrace {
+      readonly records: Uint32Array;
+      readonly strings: string[];
+      readonly droppedCount: number;
+      readonly entries: LogEntry[];
+      toBuffer(): Buffer;
+      analyze(options?: { source?: string, positionEncoding?: PositionEncoding, limit?: number }): ParseTraceSummary;
+      static fromBuffer(buffer: Buffer): ParseTrace;
+    }
+
+    export interface ParseTraceSummary {
+      recordCount: number;
+      droppedCount: number;
+      totalTime: number;
+      maxVersionCount: number;
+      messages: { message: string, count: number, time: number }[];
+      states: { state: number, processCount: number, splitCount: number, time: number }[];
+      splitStates: { state: number, processCount: number, splitCount: number, time: number }[];
+      relexedPositions: { startPosition: Point, startIndex?: number, count: number }[];
+      errorRecoveryRegions: {
+        startPosition: Point,
+        endPosition: Point,
+        startIndex?: number,
+        endIndex?: number,
+        actionCount: number,
+        time: number
+      }[];
+    }
+
     export type TextBuffer = Buffer;
 
     export interface InputReader {
@@ -79,6 +216,9 @@ declare module "tree-sitter" {
       toString(): string;
       child(index: number): SyntaxNode | null;
       namedChild(index: number): SyntaxNode | null;
+      childrenSlice(start: number, count?: number): Array<SyntaxNode>;
+      fieldsAll(): {[fieldName: string]: Array<SyntaxNode>};
+      namedChildrenSlice(start: number, count?: number): Array<SyntaxNode>;
       firstChildForIndex(index: number): SyntaxNode | null;
       firstNamedChildForIndex(index: number): SyntaxNode | null;
 
@@ -116,12 +256,71 @@ declare module "tree-sitter" {
 
     export interface Tree {
       readonly rootNode: SyntaxNode;
+      readonly positionEncoding: PositionEncoding;
+      readonly parseStats?: ParseStats;
 
       edit(delta: Edit): Tree;
       walk(): TreeCursor;
       getChangedRanges(other: Tree): Range[];
       getEditedRange(other: Tree): Range;
       printDotGraph(): void;
+      buildRangeIndex(types: String | Array<String>): RangeIndex;
+      chunk(options: ChunkOptions): Uint32Array;
+      tokens(options?: TokenOptions): Tokens;
+      search(pattern: string, options?: SearchOptions): Uint32Array;
+      addMarkerLayer(): MarkerLayer;
+    }
+
+    export interface ChunkOptions {
+      maxBytes: number;
+      preferTypes?: String | Array<String>;
+    }
+
+    export interface TokenOptions {
+      range?: { startIndex?: number, endIndex?: number };
+      includeAnonymous?: boolean;
+      includeExtras?: boolean;
+      includeText?: boolean;
+    }
+
+    export interface Tokens {
+      typeIds: Uint16Array;
+      startIndices: Uint32Array;
+      endIndices: Uint32Array;
+      isNamed: Uint8Array;
+      isExtra: Uint8Array;
+      text?: string[];
+    }
+
+    export interface SearchOptions {
+      inTypes?: String | Array<String>;
+      notInTypes?: String | Array<String>;
+      caseInsensitive?: boolean;
+    }
+
+    export interface MarkerLayer {
+      readonly tree: Tree;
+      readonly size: number;
+
+      markRange(startIndex: number, endIndex: number): number;
+      markRanges(ranges: Uint32Array): Uint32Array;
+      getRange(id: number): { startIndex: number, endIndex: number } | undefined;
+      getRanges(): Uint32Array;
+      findOverlapping(startIndex: number, endIndex?: number): Uint32Array;
+      findContaining(startIndex: number, endIndex?: number): Uint32Array;
+      remove(id: number): boolean;
+      clear(): void;
+      setTree(newTree: Tree): MarkerLayer;
+    }
+
+    export interface RangeIndex {
+      readonly tree: Tree;
+      readonly size: number;
+
+      overlapping(startIndex: number, endIndex?: number): Array<SyntaxNode>;
+      containing(startIndex: number, endIndex?: number): Array<SyntaxNode>;
+      within(startIndex: number, endIndex: number): Array<SyntaxNode>;
+      update(newTree: Tree): RangeIndex;
     }
 
     export interface QueryMatch {
@@ -148,6 +347,17 @@ declare module "tree-sitter" {
 
       matches(rootNode: SyntaxNode, startPosition?: Point, endPosition?: Point): QueryMatch[];
       captures(rootNode: SyntaxNode, startPosition?: Point, endPosition?: Point): QueryCapture[];
+      rewrite(tree: Tree, templates: {[captureName: string]: string}, options?: RewriteOptions): RewriteResult;
+    }
+
+    export interface RewriteOptions {
+      parser?: Parser;
+    }
+
+    export interface RewriteResult {
+      text: string;
+      edits: Edit[];
+      tree?: Tree;
     }
   }
 